@@ -0,0 +1,209 @@
+#include "batch.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <sys/resource.h>
+#include <vector>
+#include "instance.h"
+#include "thread_pool.h"
+
+namespace
+{
+    struct BatchInstance
+    {
+        std::string map_path, scen_path;
+        int agents = -1;
+        long long seed = 0;
+        int line = 0;
+        std::size_t map = 0; // index into the shared maps
+    };
+
+    struct BatchResult
+    {
+        bool success = false;
+        int timesteps = 0;
+        std::size_t sum_of_costs = 0;
+        double solve_seconds = 0.0;
+        double planner_mb = 0.0;
+        std::string error;
+    };
+
+    // Read-only state shared by every instance on one map
+    struct SharedMap
+    {
+        std::string path;
+        std::shared_ptr<Graph> graph;
+        std::shared_ptr<DistanceCache> distances;
+        std::shared_ptr<ClusterHierarchy> hierarchy; // with DistanceHeuristic::Clusters
+        std::string error;
+    };
+
+    std::string Resolve(const std::string &base_dir, const std::string &path)
+    {
+        if (path.empty() || path[0] == '/' || base_dir.empty())
+            return path;
+        return base_dir + "/" + path;
+    }
+
+    bool ReadManifest(const std::string &path, std::vector<BatchInstance> &instances)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            std::cerr << "Cannot read " << path << std::endl;
+            return false;
+        }
+
+        const std::size_t slash = path.find_last_of('/');
+        const std::string base_dir = slash == std::string::npos ? "" : path.substr(0, slash);
+
+        std::string line;
+        for (int number = 1; std::getline(in, line); ++number)
+        {
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            BatchInstance instance;
+            if (!(fields >> instance.map_path))
+                continue;
+            if (!(fields >> instance.scen_path))
+            {
+                std::cerr << path << ":" << number << ": expected MAP SCEN [AGENTS] [SEED]" << std::endl;
+                return false;
+            }
+            if (!(fields >> instance.agents))
+                instance.agents = -1;
+            else if (!(fields >> instance.seed))
+                instance.seed = 0;
+
+            instance.map_path = Resolve(base_dir, instance.map_path);
+            instance.scen_path = Resolve(base_dir, instance.scen_path);
+            instance.line = number;
+            instances.push_back(instance);
+        }
+        return true;
+    }
+
+    BatchResult Solve(const BatchInstance &instance, const SharedMap &map, PibtOptions options)
+    {
+        BatchResult result;
+        if (!map.graph)
+        {
+            result.error = map.error;
+            return result;
+        }
+
+        try
+        {
+            Scenario scenario = LoadScenario(instance.scen_path, instance.agents);
+            if (map.graph->grid && (scenario.width != map.graph->width || scenario.height != map.graph->height))
+            {
+                result.error = "scenario does not match the map size";
+                return result;
+            }
+
+            options.seed = instance.seed;
+            options.num_threads = 1; // instances already run in parallel
+            PIBT pibt(map.graph, scenario.starts, scenario.goals, options, map.distances, map.hierarchy);
+
+            auto start_time = std::chrono::steady_clock::now();
+            pibt.RunPibt();
+            auto end_time = std::chrono::steady_clock::now();
+
+            result.success = !pibt.failed && pibt.AllReached();
+            result.timesteps = (int)pibt.paths.NumTimesteps() - 1;
+            result.sum_of_costs = pibt.SumOfCosts();
+            result.solve_seconds = std::chrono::duration<double>(end_time - start_time).count();
+            result.planner_mb = pibt.MemoryUsage() / (1024.0 * 1024.0);
+        }
+        catch (const std::exception &e)
+        {
+            result.error = e.what();
+        }
+        return result;
+    }
+}
+
+int RunBatch(const std::string &manifest_path, const std::string &results_path, std::size_t jobs,
+             const PibtOptions &options)
+{
+    std::vector<BatchInstance> instances;
+    if (!ReadManifest(manifest_path, instances))
+        return 1;
+
+    std::ofstream out(results_path);
+    if (!out)
+    {
+        std::cerr << "Cannot write " << results_path << std::endl;
+        return 1;
+    }
+
+    // Recorded paths are needed for the timestep count and the sum of costs
+    PibtOptions instance_options = options;
+    instance_options.record_paths = true;
+
+    std::vector<SharedMap> maps;
+    std::map<std::string, std::size_t> map_index;
+    for (BatchInstance &instance : instances)
+    {
+        auto inserted = map_index.emplace(instance.map_path, maps.size());
+        if (inserted.second)
+        {
+            maps.emplace_back();
+            maps.back().path = instance.map_path;
+        }
+        instance.map = inserted.first->second;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    ThreadPool pool(jobs);
+
+    pool.ParallelFor(maps.size(), [&](std::size_t i, std::size_t)
+                     {
+        SharedMap &map = maps[i];
+        try
+        {
+            map.graph = std::make_shared<Graph>(LoadMap(map.path));
+            map.distances = std::make_shared<DistanceCache>(*map.graph, options.distance_cache_bytes);
+            if (options.heuristic == DistanceHeuristic::Clusters)
+                map.hierarchy = std::make_shared<ClusterHierarchy>(*map.graph, options.cluster_size, options.distance_cache_bytes);
+        }
+        catch (const std::exception &e)
+        {
+            map.error = e.what();
+        } });
+
+    std::vector<BatchResult> results(instances.size());
+    pool.ParallelFor(instances.size(), [&](std::size_t i, std::size_t)
+                     { results[i] = Solve(instances[i], maps[instances[i].map], instance_options); });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    std::size_t solved = 0;
+    out << "map,scen,agents,seed,success,timesteps,sum_of_costs,solve_seconds,planner_mb\n";
+    for (std::size_t i = 0; i < instances.size(); ++i)
+    {
+        const BatchInstance &instance = instances[i];
+        const BatchResult &result = results[i];
+        if (!result.error.empty())
+        {
+            std::cerr << manifest_path << ":" << instance.line << ": " << result.error << std::endl;
+        }
+        solved += result.success;
+        out << instance.map_path << ',' << instance.scen_path << ',' << instance.agents << ','
+            << instance.seed << ',' << result.success << ',' << result.timesteps << ','
+            << result.sum_of_costs << ',' << result.solve_seconds << ',' << result.planner_mb << '\n';
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::cout << "Solved " << solved << " of " << instances.size() << " instances on "
+              << maps.size() << " maps with " << pool.Size() << " jobs in "
+              << std::fixed << std::setprecision(3) << seconds << " seconds, peak RSS "
+              << std::setprecision(1) << usage.ru_maxrss / 1024.0 << " MB." << std::endl;
+    return 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "pibt.h"
+
+// Batch mode of pibt_algo. Each manifest line names one instance:
+//
+//   MAP SCEN [AGENTS] [SEED]      # AGENTS defaults to the whole scenario, SEED to 0
+//
+// Relative paths are resolved against the manifest's directory; '#' starts a comment.
+// Instances run concurrently on `jobs` threads (0 for one per core). Every map is loaded once
+// and its graph and distance cache are shared by all instances on it. The results file gets
+// one CSV row per instance, in manifest order. Returns the process exit status.
+int RunBatch(const std::string &manifest_path, const std::string &results_path, std::size_t jobs,
+             const PibtOptions &options);
@@ -0,0 +1,154 @@
+#include <iostream>
+#include <chrono>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "generator.h"
+#include "pibt.h"
+
+static void PrintUsage(const char *program)
+{
+    std::cout << "Usage: " << program << " [--family F] [--width W] [--height H] [--agents N|max] [--goals P] [--seed S] [--out-map FILE --out-scen FILE] [--solve [--heuristic KIND]]\n"
+              << "  --family F           open, random, warehouse, rooms or maze (default: random)\n"
+              << "  --width W            map width (default: 256)\n"
+              << "  --height H           map height (default: 256)\n"
+              << "  --density D          obstacle probability of --family random (default: 0.2)\n"
+              << "  --shelf-length L     shelf length of --family warehouse (default: 10)\n"
+              << "  --room-size R        room side of --family rooms (default: 16)\n"
+              << "  --corridor-width C   corridor width of --family maze (default: 2)\n"
+              << "  --agents N|max       agents, up to the size of the map's largest region (default: 1000)\n"
+              << "  --goals P            uniform, hotspot or swap (default: uniform)\n"
+              << "  --hotspots K         hotspots of --goals hotspot (default: 4)\n"
+              << "  --hotspot-fraction F share of goals around the hotspots (default: 0.5)\n"
+              << "  --seed S             seed; the same options and seed give the same instance (default: 0)\n"
+              << "  --out-map FILE       write the map in MovingAI format\n"
+              << "  --out-scen FILE      write the agents as a MovingAI scenario referencing --out-map\n"
+              << "  --solve              solve the instance in memory with PIBT and report\n"
+              << "  --heuristic KIND     distances of --solve: 'tables' for an exact table per goal, 'clusters' for a cluster\n"
+              << "                       hierarchy on very large maps (default: tables, falling back to clusters past 1 GiB)\n"
+              << "  --cluster-size N     cluster side of --heuristic clusters, a power of two (default: 32)\n"
+              << "  --threads N          planning threads of --solve, 0 for one per core (default: 1)\n"
+              << "  --max-steps T        give up --solve after T timesteps (default: agents * map side * 10)\n";
+}
+
+int main(int argc, char **argv)
+{
+    GeneratorOptions options;
+    PibtOptions pibt_options;
+    std::string map_path, scen_path;
+    bool solve = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        bool has_value = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--family") && has_value && ParseMapFamily(argv[i + 1], options.family))
+            ++i;
+        else if (!std::strcmp(argv[i], "--width") && has_value)
+            options.width = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--height") && has_value)
+            options.height = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--density") && has_value)
+            options.density = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--shelf-length") && has_value)
+            options.shelf_length = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--room-size") && has_value)
+            options.room_size = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--corridor-width") && has_value)
+            options.corridor_width = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--agents") && has_value)
+        {
+            ++i;
+            options.num_agents = !std::strcmp(argv[i], "max") ? -1 : std::atoi(argv[i]);
+        }
+        else if (!std::strcmp(argv[i], "--goals") && has_value && ParseGoalPattern(argv[i + 1], options.goals))
+            ++i;
+        else if (!std::strcmp(argv[i], "--hotspots") && has_value)
+            options.num_hotspots = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--hotspot-fraction") && has_value)
+            options.hotspot_fraction = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--seed") && has_value)
+            options.seed = std::atoll(argv[++i]);
+        else if (!std::strcmp(argv[i], "--out-map") && has_value)
+            map_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--out-scen") && has_value)
+            scen_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--solve"))
+            solve = true;
+        else if (!std::strcmp(argv[i], "--heuristic") && has_value && !std::strcmp(argv[i + 1], "tables"))
+        {
+            pibt_options.heuristic = DistanceHeuristic::Tables;
+            ++i;
+        }
+        else if (!std::strcmp(argv[i], "--heuristic") && has_value && !std::strcmp(argv[i + 1], "clusters"))
+        {
+            pibt_options.heuristic = DistanceHeuristic::Clusters;
+            ++i;
+        }
+        else if (!std::strcmp(argv[i], "--cluster-size") && has_value)
+            pibt_options.cluster_size = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--threads") && has_value)
+            pibt_options.num_threads = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--max-steps") && has_value)
+            pibt_options.max_timesteps = std::atoi(argv[++i]);
+        else
+        {
+            PrintUsage(argv[0]);
+            return !std::strcmp(argv[i], "--help") ? 0 : 1;
+        }
+    }
+
+    if (!scen_path.empty() && map_path.empty())
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        GeneratedInstance instance = Generate(options);
+        auto end_time = std::chrono::high_resolution_clock::now();
+        std::cout << "Generated a " << options.width << "x" << options.height << " map with "
+                  << instance.starts.size() << " agents (region of " << instance.capacity << " cells) in "
+                  << std::fixed << std::setprecision(7)
+                  << std::chrono::duration<double>(end_time - start_time).count() << " seconds." << std::endl;
+
+        if (!map_path.empty())
+            WriteMap(map_path, *instance.graph);
+        if (!scen_path.empty())
+        {
+            const std::size_t slash = map_path.find_last_of('/');
+            WriteScenario(scen_path, slash == std::string::npos ? map_path : map_path.substr(slash + 1), instance);
+        }
+
+        if (solve)
+        {
+            const std::size_t num_agents = instance.starts.size();
+            pibt_options.seed = options.seed;
+            pibt_options.record_paths = false;
+            PIBT pibt(instance.graph,
+                      Span<const int32_t>(instance.starts.data(), num_agents),
+                      Span<const int32_t>(instance.goals.data(), num_agents),
+                      Span<const int32_t>(instance.headings.data(), num_agents),
+                      pibt_options);
+
+            start_time = std::chrono::high_resolution_clock::now();
+            pibt.RunPibt();
+            end_time = std::chrono::high_resolution_clock::now();
+            if (pibt.failed)
+                std::cout << "Simulation failed after too many timesteps!" << std::endl;
+            else
+                std::cout << "Solved in " << pibt.timesteps << " timesteps." << std::endl;
+            std::cout << "Time taken to run PIBT: " << std::chrono::duration<double>(end_time - start_time).count()
+                      << " seconds." << std::endl;
+            return pibt.failed ? 1 : 0;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,33 +1,404 @@
 #include <iostream>
 #include <vector>
 #include <chrono>
-#include <iomanip> 
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
 #include "pibt.h"
+#include "instance.h"
+#include "batch.h"
+#include "lacam.h"
+#include "sharded_planner.h"
+#include "trajectory.h"
 
-int main()
+static void PrintUsage(const char *program)
 {
-    // Define the grid dimensions
-    int width = 5;
-    int height = 5;
+    std::cout << "Usage: " << program << " [--map FILE --scen FILE] [--agents N] [--offset K] [--distances FILE] [--heuristic KIND [--cluster-size N]] [--lifelong T] [--threads N] [--motion MODEL] [--step-budget MS] [--complete [--time-limit S]] [--shards N [--halo D]] [--max-steps T] [--trajectory FILE] [--history T] [--stats FILE] [--print]\n"
+              << "       " << program << " --batch MANIFEST --out FILE [--jobs N] [--max-steps T]\n"
+              << "  --map FILE        MovingAI .map file or roadmap to plan on\n"
+              << "  --scen FILE       MovingAI .scen file with the agents' starts and goals\n"
+              << "  --agents N        number of scenario entries to use (default: all)\n"
+              << "  --offset K        index of the first scenario entry to use (default: 0)\n"
+              << "  --distances FILE  distance store written by pibt_precompute for this map\n"
+              << "  --heuristic KIND  'tables' for an exact distance table per goal, 'clusters' for a cluster hierarchy on very large maps (default: tables)\n"
+              << "  --cluster-size N  cluster side of --heuristic clusters, a power of two (default: 32)\n"
+              << "  --lifelong T      run T timesteps, giving agents a random new goal on arrival\n"
+              << "  --threads N       planning threads, 0 for one per core (default: 1)\n"
+              << "  --motion MODEL    'rotate' to move along the heading and turn in place, 'holonomic' to move freely (default: rotate)\n"
+              << "  --rotation-steps N timesteps a quarter turn takes with --motion rotate (default: 1)\n"
+              << "  --step-budget MS  plan each timestep within MS milliseconds, agents left unplanned wait (default: none)\n"
+              << "  --complete        search with LaCAM, which keeps going where PIBT alone livelocks\n"
+              << "  --time-limit S    give up the --complete search after S seconds (default: none)\n"
+              << "  --shards N        split the map into N column strips planned by one worker process each\n"
+              << "  --halo D          moves from a strip's border within which --shards also plans the neighbour's agents (default: 8)\n"
+              << "  --max-steps T     give up after T timesteps (default: agents * map side * 10)\n"
+              << "  --trajectory FILE stream the run to a binary trajectory, see pibt_trajectory\n"
+              << "  --history T       keep only the last T timesteps in memory (default: all)\n"
+              << "  --batch MANIFEST  solve every 'MAP SCEN [AGENTS] [SEED]' line of MANIFEST concurrently\n"
+              << "  --out FILE        batch results, one CSV row per manifest line\n"
+              << "  --jobs N          instances solved at once in batch mode, 0 for one per core (default: 0)\n"
+              << "  --stats FILE      write per-timestep planner counters (.json or .csv), needs PIBT_ENABLE_STATS\n"
+              << "  --print           print every agent's path after the run\n"
+              << "Without --map and --scen a built-in two-agent 5x5 example is solved.\n";
+}
+
+// Writes the per-timestep counters as JSON when the path ends in .json, CSV otherwise
+static int WriteStats(const PIBT &pibt, const std::string &path)
+{
+    if (path.empty())
+        return 0;
+
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "Cannot write " << path << std::endl;
+        return 1;
+    }
+
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if (json)
+        WriteStatsJson(out, pibt.stats_history);
+    else
+        WriteStatsCsv(out, pibt.stats_history);
+    return 0;
+}
+
+// Reports how often the per-timestep budget ran out, when one was set
+static void PrintBudget(const PIBT &pibt)
+{
+    if (pibt.options.step_budget_seconds <= 0.0)
+        return;
+    std::cout << pibt.degraded_steps << " of " << pibt.timesteps << " timesteps ran out of the " << std::setprecision(3)
+              << pibt.options.step_budget_seconds * 1000.0 << " ms step budget." << std::endl;
+}
+
+static void FinishTrajectory(TrajectoryWriter *trajectory)
+{
+    if (!trajectory)
+        return;
+    trajectory->Close();
+    std::cout << "Wrote " << trajectory->NumTimesteps() << " timesteps of trajectory in "
+              << trajectory->BytesWritten() << " bytes." << std::endl;
+}
+
+// Complete search: PIBT generates the successors of a search over joint configurations
+static int RunComplete(std::shared_ptr<Graph> graph, const std::vector<std::vector<int>> &starts,
+                       const std::vector<std::vector<int>> &goals, const PibtOptions &options,
+                       const LacamOptions &lacam_options, const std::string &trajectory_path)
+{
+    LaCAM lacam(std::move(graph), starts, goals, options, lacam_options);
+    auto start_time = std::chrono::high_resolution_clock::now();
+    bool solved = lacam.Solve();
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    if (solved)
+        std::cout << "Solved in " << lacam.timesteps << " timesteps, sum of costs " << lacam.SumOfCosts() << "." << std::endl;
+    else
+        std::cout << "No solution found." << std::endl;
+    std::cout << "Time taken to run LaCAM: "
+              << std::fixed << std::setprecision(7)
+              << std::chrono::duration<double>(end_time - start_time).count() << " seconds, "
+              << lacam.NumNodes() << " configurations, "
+              << std::setprecision(1) << lacam.MemoryUsage() / (1024.0 * 1024.0) << " MB." << std::endl;
+
+    if (solved && !trajectory_path.empty())
+    {
+        TrajectoryWriter trajectory(trajectory_path, lacam.pibt.graph.width, lacam.pibt.graph.height, starts.size());
+        for (std::size_t t = 0; t < lacam.paths.NumTimesteps(); ++t)
+            trajectory.Append(lacam.paths.Vertices(t), lacam.paths.Headings(t));
+        FinishTrajectory(&trajectory);
+    }
+    return solved ? 0 : 2;
+}
+
+// Sharded mode: PIBT split over worker processes, one per column strip of the map
+static int RunSharded(std::shared_ptr<Graph> graph, const std::vector<std::vector<int>> &starts,
+                      const std::vector<std::vector<int>> &goals, const PibtOptions &options,
+                      const ShardOptions &shard_options, const std::string &trajectory_path)
+{
+    std::vector<int32_t> start_ids, goal_ids, headings;
+    for (std::size_t i = 0; i < starts.size(); ++i)
+    {
+        start_ids.push_back(graph->GetId(starts[i][0], starts[i][1]));
+        goal_ids.push_back(graph->GetId(goals[i][0], goals[i][1]));
+        headings.push_back(starts[i][2]);
+    }
+    std::unique_ptr<ShardedPlanner> planner;
+    std::unique_ptr<TrajectoryWriter> trajectory;
+    bool solved = false;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    try
+    {
+        planner = std::make_unique<ShardedPlanner>(graph, Span<const int32_t>(start_ids.data(), start_ids.size()),
+                                                   Span<const int32_t>(goal_ids.data(), goal_ids.size()),
+                                                   Span<const int32_t>(headings.data(), headings.size()), options, shard_options);
+        if (!trajectory_path.empty())
+            trajectory = std::make_unique<TrajectoryWriter>(trajectory_path, graph->width, graph->height, starts.size());
+        start_time = std::chrono::high_resolution_clock::now();
+        solved = planner->Run(trajectory.get());
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
 
-    // Define start and goal positions for the agents
-    std::vector<std::vector<int>> starts = {
-        {0, 0, 0}, // Agent 0 starts at (0, 0) facing Up
-        {4, 0, 1}  // Agent 1 starts at (4, 0) facing Down
-    };
-    std::vector<std::vector<int>> goals = {
-        {4, 4, 0}, // Agent 0's goal is (4, 4), heading Up
-        {0, 4, 1}  // Agent 1's goal is (0, 4), heading Down
-    };
+    if (solved)
+        std::cout << "Solved in " << planner->timesteps << " timesteps, sum of costs " << planner->SumOfCosts() << "." << std::endl;
+    else
+        std::cout << "Not every agent reached its goal within " << planner->timesteps << " timesteps." << std::endl;
+    std::cout << "Time taken to run " << shard_options.num_shards << " shards: "
+              << std::fixed << std::setprecision(7)
+              << std::chrono::duration<double>(end_time - start_time).count() << " seconds, "
+              << planner->handoffs << " handoffs, " << planner->denied_moves << " moves denied at the borders." << std::endl;
+    FinishTrajectory(trajectory.get());
+    return solved ? 0 : 2;
+}
+
+// Endless-task mode: every arrival is immediately given a new random goal
+static int RunLifelong(PIBT &pibt, int steps)
+{
+    std::vector<const Vertex *> free_cells;
+    for (const Vertex &v : pibt.graph.vertices)
+    {
+        if (!pibt.graph.IsBlocked(v.id))
+            free_cells.push_back(&v);
+    }
 
-    // Initialize the PIBT class with the grid dimensions and agent start/goal positions
-    PIBT pibt_simulation(width, height, starts, goals);
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<std::size_t> pick(0, free_cells.size() - 1);
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int t = 0; t < steps; ++t)
+    {
+        pibt.Step();
+        for (Agent *agent : pibt.arrived)
+        {
+            const Vertex *goal = free_cells[pick(rng)];
+            pibt.SetGoal(agent->id, goal->x, goal->y);
+        }
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end_time - start_time).count();
+
+    std::cout << "Completed " << pibt.tasks_completed << " tasks in " << steps << " timesteps ("
+              << std::fixed << std::setprecision(3)
+              << (double)pibt.tasks_completed / steps << " tasks per timestep)." << std::endl;
+    std::cout << "Time taken to run PIBT: "
+              << std::fixed << std::setprecision(7)
+              << seconds << " seconds, "
+              << std::setprecision(1) << pibt.tasks_completed / seconds << " tasks per second."
+              << std::endl;
+    PrintBudget(pibt);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string map_path, scen_path;
+    int num_agents = -1;
+    int offset = 0;
+    bool print_agents = false;
+    int lifelong_steps = 0;
+    std::string stats_path;
+    std::string batch_path, out_path;
+    std::string trajectory_path;
+    std::size_t jobs = 0;
+    bool complete = false;
+    ShardOptions shard_options;
+    int num_shards = 0;
+    PibtOptions options;
+    LacamOptions lacam_options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        bool has_value = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--map") && has_value)
+            map_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--scen") && has_value)
+            scen_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--agents") && has_value)
+            num_agents = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--offset") && has_value)
+            offset = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--distances") && has_value)
+            options.distance_store_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--heuristic") && has_value && !std::strcmp(argv[i + 1], "tables"))
+        {
+            options.heuristic = DistanceHeuristic::Tables;
+            ++i;
+        }
+        else if (!std::strcmp(argv[i], "--heuristic") && has_value && !std::strcmp(argv[i + 1], "clusters"))
+        {
+            options.heuristic = DistanceHeuristic::Clusters;
+            ++i;
+        }
+        else if (!std::strcmp(argv[i], "--cluster-size") && has_value)
+            options.cluster_size = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--lifelong") && has_value)
+            lifelong_steps = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--threads") && has_value)
+            options.num_threads = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--motion") && has_value && !std::strcmp(argv[i + 1], "rotate"))
+        {
+            options.motion_model = MotionModel::RotateThenMove;
+            ++i;
+        }
+        else if (!std::strcmp(argv[i], "--motion") && has_value && !std::strcmp(argv[i + 1], "holonomic"))
+        {
+            options.motion_model = MotionModel::Holonomic;
+            ++i;
+        }
+        else if (!std::strcmp(argv[i], "--rotation-steps") && has_value && std::atoi(argv[i + 1]) > 0)
+            options.rotation_steps = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--step-budget") && has_value && std::atof(argv[i + 1]) > 0.0)
+            options.step_budget_seconds = std::atof(argv[++i]) / 1000.0;
+        else if (!std::strcmp(argv[i], "--complete"))
+            complete = true;
+        else if (!std::strcmp(argv[i], "--time-limit") && has_value)
+            lacam_options.time_limit_seconds = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--shards") && has_value && std::atoi(argv[i + 1]) > 0)
+            num_shards = shard_options.num_shards = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--halo") && has_value && std::atoi(argv[i + 1]) > 0)
+            shard_options.halo_depth = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--max-steps") && has_value)
+            options.max_timesteps = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--trajectory") && has_value)
+            trajectory_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--history") && has_value)
+            options.path_history_timesteps = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--batch") && has_value)
+            batch_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--out") && has_value)
+            out_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--jobs") && has_value)
+            jobs = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--stats") && has_value)
+            stats_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--print"))
+            print_agents = true;
+        else
+        {
+            PrintUsage(argv[0]);
+            return !std::strcmp(argv[i], "--help") ? 0 : 1;
+        }
+    }
+
+    if (!batch_path.empty())
+    {
+        if (out_path.empty())
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        return RunBatch(batch_path, out_path, jobs, options);
+    }
+
+    if (map_path.empty() != scen_path.empty())
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    std::unique_ptr<PIBT> pibt_simulation;
+    if (map_path.empty())
+    {
+        // Define the grid dimensions
+        int width = 5;
+        int height = 5;
+
+        // Define start and goal positions for the agents
+        std::vector<std::vector<int>> starts = {
+            {0, 0, 0}, // Agent 0 starts at (0, 0) facing Up
+            {4, 0, 1}  // Agent 1 starts at (4, 0) facing Down
+        };
+        std::vector<std::vector<int>> goals = {
+            {4, 4, 0}, // Agent 0's goal is (4, 4), heading Up
+            {0, 4, 1}  // Agent 1's goal is (0, 4), heading Down
+        };
+
+        if (complete)
+            return RunComplete(std::make_shared<Graph>(width, height), starts, goals, options, lacam_options, trajectory_path);
+        if (num_shards > 0)
+            return RunSharded(std::make_shared<Graph>(width, height), starts, goals, options, shard_options, trajectory_path);
+
+        // Initialize the PIBT class with the grid dimensions and agent start/goal positions
+        pibt_simulation = std::make_unique<PIBT>(width, height, starts, goals, options);
+        print_agents = true;
+    }
+    else
+    {
+        try
+        {
+            auto load_start = std::chrono::high_resolution_clock::now();
+            Graph graph = LoadMap(map_path);
+            Scenario scenario = LoadScenario(scen_path, num_agents, offset);
+            if (graph.grid && (scenario.width != graph.width || scenario.height != graph.height))
+            {
+                std::cerr << "Scenario was made for a " << scenario.width << "x" << scenario.height
+                          << " map, but the map is " << graph.width << "x" << graph.height << "." << std::endl;
+                return 1;
+            }
+            auto load_end = std::chrono::high_resolution_clock::now();
+
+            std::cout << "Loaded " << graph.width << "x" << graph.height << " map and "
+                      << scenario.starts.size() << " agents in "
+                      << std::fixed << std::setprecision(7)
+                      << std::chrono::duration<double>(load_end - load_start).count() << " seconds." << std::endl;
+
+            if (complete)
+                return RunComplete(std::make_shared<Graph>(std::move(graph)), scenario.starts, scenario.goals,
+                                   options, lacam_options, trajectory_path);
+            if (num_shards > 0)
+                return RunSharded(std::make_shared<Graph>(std::move(graph)), scenario.starts, scenario.goals,
+                                  options, shard_options, trajectory_path);
+            pibt_simulation = std::make_unique<PIBT>(std::move(graph), scenario.starts, scenario.goals, options);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (!stats_path.empty() && !kPibtStatsEnabled)
+    {
+        std::cerr << "Warning: built without PIBT_ENABLE_STATS, " << stats_path << " will be empty." << std::endl;
+    }
+
+    std::unique_ptr<TrajectoryWriter> trajectory;
+    if (!trajectory_path.empty())
+    {
+        try
+        {
+            trajectory = std::make_unique<TrajectoryWriter>(trajectory_path, pibt_simulation->graph.width,
+                                                            pibt_simulation->graph.height, pibt_simulation->agents.size());
+            pibt_simulation->StreamTo(trajectory.get());
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (lifelong_steps > 0)
+    {
+        int status = RunLifelong(*pibt_simulation, lifelong_steps);
+        FinishTrajectory(trajectory.get());
+        return status ? status : WriteStats(*pibt_simulation, stats_path);
+    }
 
     // Record the start time
     auto start_time = std::chrono::high_resolution_clock::now();
 
     // Run the simulation
-    pibt_simulation.RunPibt(); // Assuming the method is named `run`
+    pibt_simulation->RunPibt();
 
     // Record the end time
     auto end_time = std::chrono::high_resolution_clock::now();
@@ -36,7 +407,7 @@ int main()
     std::chrono::duration<double> duration = end_time - start_time;
 
     // Print the status of the agents after running the simulation
-    if (pibt_simulation.failed)
+    if (pibt_simulation->failed)
     {
         std::cout << "Simulation failed after too many timesteps!" << std::endl;
     }
@@ -46,13 +417,16 @@ int main()
     }
 
     // Optionally, print details about each agent
-    pibt_simulation.PrintAgents();
+    if (print_agents)
+        pibt_simulation->PrintAgents();
 
     // Print the time taken to run the PIBT algorithm
     std::cout << "Time taken to run PIBT: "
               << std::fixed << std::setprecision(7)
               << duration.count() << " seconds."
               << std::endl;
+    PrintBudget(*pibt_simulation);
+    FinishTrajectory(trajectory.get());
 
-    return 0;
+    return WriteStats(*pibt_simulation, stats_path);
 }
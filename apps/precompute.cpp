@@ -0,0 +1,86 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "distance_store.h"
+#include "instance.h"
+
+static void PrintUsage(const char *program)
+{
+    std::cout << "Usage: " << program << " --map FILE --out FILE [--scen FILE] [--threads N]\n"
+              << "  --map FILE     MovingAI .map file or roadmap to precompute distances for\n"
+              << "  --out FILE     distance store to write, load it with pibt_algo --distances\n"
+              << "  --scen FILE    only store the goals of this scenario (default: every free cell)\n"
+              << "  --threads N    worker threads (default: all cores)\n";
+}
+
+int main(int argc, char **argv)
+{
+    std::string map_path, scen_path, out_path;
+    int num_threads = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        bool has_value = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--map") && has_value)
+            map_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--scen") && has_value)
+            scen_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--out") && has_value)
+            out_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--threads") && has_value)
+            num_threads = std::atoi(argv[++i]);
+        else
+        {
+            PrintUsage(argv[0]);
+            return !std::strcmp(argv[i], "--help") ? 0 : 1;
+        }
+    }
+
+    if (map_path.empty() || out_path.empty())
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        Graph graph = LoadMap(map_path);
+
+        std::vector<int> goals;
+        if (!scen_path.empty())
+        {
+            Scenario scenario = LoadScenario(scen_path);
+            for (const auto &goal : scenario.goals)
+            {
+                int id = graph.GetId(goal[0], goal[1]);
+                if (id < 0 || graph.IsBlocked(id))
+                {
+                    std::cerr << "Scenario goal (" << goal[0] << ", " << goal[1] << ") is not a free cell." << std::endl;
+                    return 1;
+                }
+                goals.push_back(id);
+            }
+        }
+
+        BuildDistanceStore(graph, goals, out_path, num_threads);
+        auto end_time = std::chrono::high_resolution_clock::now();
+
+        DistanceStore store(out_path, graph);
+        std::cout << "Stored " << store.NumGoals() << " distance tables for a "
+                  << graph.width << "x" << graph.height << " map in "
+                  << std::fixed << std::setprecision(7)
+                  << std::chrono::duration<double>(end_time - start_time).count() << " seconds." << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
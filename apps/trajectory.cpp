@@ -0,0 +1,98 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <string>
+#include "trajectory.h"
+
+static void PrintUsage(const char *program)
+{
+    std::cout << "Usage: " << program << " --in FILE [--out FILE] [--headings]\n"
+              << "  --in FILE      binary trajectory written by pibt_algo --trajectory\n"
+              << "  --out FILE     text plan to write (default: standard output)\n"
+              << "  --headings     write (x,y,heading) states instead of (x,y)\n"
+              << "Writes the plan in the text format read by common MAPF visualizers:\n"
+              << "agents=, makespan=, starts= and one 't:(x,y),(x,y),...' line per timestep after solution=.\n";
+}
+
+static void WriteState(std::ostream &out, const TrajectoryReader &reader, bool with_headings)
+{
+    static const char *kHeadings[] = {"Up", "Down", "Left", "Right", "None"};
+    const int width = reader.Width();
+    Span<const int32_t> vertices = reader.Vertices();
+    Span<const Direction> headings = reader.Headings();
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        out << '(' << vertices[i] % width << ',' << vertices[i] / width;
+        if (with_headings)
+            out << ',' << kHeadings[headings[i] <= Direction::None ? headings[i] : Direction::None];
+        out << "),";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string in_path, out_path;
+    bool with_headings = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        bool has_value = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--in") && has_value)
+            in_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--out") && has_value)
+            out_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--headings"))
+            with_headings = true;
+        else
+        {
+            PrintUsage(argv[0]);
+            return !std::strcmp(argv[i], "--help") ? 0 : 1;
+        }
+    }
+
+    if (in_path.empty())
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        TrajectoryReader reader(in_path);
+        std::ofstream file;
+        if (!out_path.empty())
+        {
+            file.open(out_path);
+            if (!file)
+            {
+                std::cerr << "Cannot write " << out_path << std::endl;
+                return 1;
+            }
+        }
+        std::ostream &out = out_path.empty() ? std::cout : file;
+
+        out << "agents=" << reader.NumAgents() << '\n';
+        out << "width=" << reader.Width() << '\n';
+        out << "height=" << reader.Height() << '\n';
+        if (reader.NumTimesteps() != TrajectoryWriter::kUnknownTimesteps && reader.NumTimesteps() > 0)
+            out << "makespan=" << reader.NumTimesteps() - 1 << '\n';
+
+        if (!reader.Next())
+            return 0;
+        out << "starts=";
+        WriteState(out, reader, false);
+        out << "\nsolution=\n";
+        do
+        {
+            out << reader.Timestep() << ':';
+            WriteState(out, reader, with_headings);
+            out << '\n';
+        } while (reader.Next());
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
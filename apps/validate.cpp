@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "instance.h"
+#include "trajectory.h"
+#include "validator.h"
+
+static void PrintUsage(const char *program)
+{
+    std::cout << "Usage: " << program << " --map FILE --trajectory FILE [--motion MODEL] [--no-headings] [--threads N] [--window T] [--max-report K]\n"
+              << "  --map FILE        MovingAI .map file or roadmap the run was planned on\n"
+              << "  --trajectory FILE binary trajectory written by pibt_algo --trajectory\n"
+              << "  --motion MODEL    heading rules of 'rotate' or 'holonomic' runs, as given to pibt_algo (default: rotate)\n"
+              << "  --no-headings     check collisions and moves only, ignoring the heading rules\n"
+              << "  --threads N       checking threads, 0 for one per core (default: 0)\n"
+              << "  --window T        timesteps decoded per check (default: 1024)\n"
+              << "  --max-report K    violations to print (default: 20)\n"
+              << "Exits with 0 if the run is free of vertex and swap conflicts, illegal moves and, unless --no-headings\n"
+              << "is given, heading violations; 2 otherwise.\n";
+}
+
+int main(int argc, char **argv)
+{
+    std::string map_path, trajectory_path;
+    std::size_t window = 1024;
+    ValidatorOptions options;
+    options.max_violations = 20;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        bool has_value = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--map") && has_value)
+            map_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--trajectory") && has_value)
+            trajectory_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--motion") && has_value && !std::strcmp(argv[i + 1], "rotate"))
+        {
+            options.motion_model = MotionModel::RotateThenMove;
+            ++i;
+        }
+        else if (!std::strcmp(argv[i], "--motion") && has_value && !std::strcmp(argv[i + 1], "holonomic"))
+        {
+            options.motion_model = MotionModel::Holonomic;
+            ++i;
+        }
+        else if (!std::strcmp(argv[i], "--no-headings"))
+            options.check_headings = false;
+        else if (!std::strcmp(argv[i], "--threads") && has_value)
+            options.num_threads = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--window") && has_value)
+            window = std::max<std::size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--max-report") && has_value)
+            options.max_violations = std::strtoul(argv[++i], nullptr, 10);
+        else
+        {
+            PrintUsage(argv[0]);
+            return !std::strcmp(argv[i], "--help") ? 0 : 1;
+        }
+    }
+
+    if (map_path.empty() || trajectory_path.empty())
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        Graph graph = LoadMap(map_path);
+        TrajectoryReader reader(trajectory_path);
+        if (reader.Width() != graph.width || reader.Height() != graph.height)
+        {
+            std::cerr << "Trajectory was recorded on a " << reader.Width() << "x" << reader.Height()
+                      << " map, but the map is " << graph.width << "x" << graph.height << "." << std::endl;
+            return 1;
+        }
+
+        // Decode a window of timesteps at a time, then check it on the validator's threads
+        auto start_time = std::chrono::high_resolution_clock::now();
+        Validator validator(graph, reader.NumAgents(), options);
+        PathStore rows(reader.NumAgents(), window);
+        bool more = reader.Next();
+        while (more)
+        {
+            rows.Reset(reader.NumAgents(), window);
+            do
+            {
+                std::size_t t = rows.AppendRow();
+                Span<const int32_t> vertices = reader.Vertices();
+                Span<const Direction> headings = reader.Headings();
+                std::copy(vertices.begin(), vertices.end(), rows.Vertices(t).begin());
+                std::copy(headings.begin(), headings.end(), rows.Headings(t).begin());
+                more = reader.Next();
+            } while (more && rows.NumTimesteps() < window);
+            validator.Check(rows);
+        }
+        auto end_time = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(end_time - start_time).count();
+
+        std::cout << "Checked " << validator.NumTimesteps() << " timesteps of " << reader.NumAgents() << " agents in "
+                  << std::fixed << std::setprecision(7) << seconds << " seconds." << std::endl;
+        if (validator.Valid())
+        {
+            std::cout << "No violations found." << std::endl;
+            return 0;
+        }
+
+        std::cout << validator.NumViolations() << " violations:";
+        for (std::size_t type = 0; type <= (std::size_t)ViolationType::IllegalHeading; ++type)
+        {
+            if (validator.NumViolations((ViolationType)type))
+                std::cout << ' ' << ViolationTypeToString((ViolationType)type) << '=' << validator.NumViolations((ViolationType)type);
+        }
+        std::cout << std::endl;
+        for (const Violation &v : validator.Violations())
+        {
+            std::cout << "  t=" << v.timestep << " agent " << v.agent << ": " << ViolationTypeToString(v.type);
+            if (v.other >= 0)
+                std::cout << " with agent " << v.other;
+            if (v.vertex >= 0 && v.vertex < (int)graph.Size())
+                std::cout << " at (" << graph.vertices[v.vertex].x << ", " << graph.vertices[v.vertex].y << ")";
+            std::cout << std::endl;
+        }
+        return 2;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
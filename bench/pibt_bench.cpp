@@ -0,0 +1,268 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+#include "pibt.h"
+
+// Sweeps grid size, agent count and obstacle density over PIBT solves.
+//
+//   pibt_bench [--sizes=32,128,512] [--agents=10,100,1000,10000,100000] [--densities=0,0.1,0.2]
+//              [--threads=1] [--seed=1] [--iterations=1] [--max-steps=5000] [benchmark flags]
+//
+// Each benchmark reports, besides the solve time:
+//   timesteps, success     whether every agent reached its goal within --max-steps
+//   step_p50_us, step_p99_us, step_max_us   per-timestep latency
+//   allocs_per_step        heap allocations per timestep, setup excluded
+//   peak_rss_mb            process high-water mark; run one benchmark per process
+//                          (--benchmark_filter) to attribute it to a single configuration
+// Use --benchmark_format=json or --benchmark_out=FILE for machine-readable results.
+
+static std::atomic<std::size_t> allocation_count(0);
+
+void *operator new(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void *p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+    struct BenchConfig
+    {
+        std::vector<int> sizes = {32, 128, 512};
+        std::vector<int> agents = {10, 100, 1000, 10000, 100000};
+        std::vector<double> densities = {0.0, 0.1, 0.2};
+        std::vector<int> threads = {1};
+        long long seed = 1;
+        int iterations = 1;
+        int max_steps = 5000;
+    };
+
+    struct Instance
+    {
+        Graph graph;
+        std::vector<std::vector<int>> starts, goals;
+    };
+
+    // Random obstacles at the given density; starts and goals are distinct cells of the largest open region
+    Instance MakeInstance(int size, double density, int num_agents, long long seed)
+    {
+        std::mt19937 rng((std::mt19937::result_type)seed);
+        std::bernoulli_distribution obstacle(density);
+        std::vector<uint8_t> obstacles((std::size_t)size * size);
+        for (auto &cell : obstacles)
+            cell = obstacle(rng);
+
+        Instance instance{Graph(size, size, obstacles), {}, {}};
+        const Graph &graph = instance.graph;
+
+        // Label connected regions and keep the largest one
+        std::vector<int> region(graph.Size(), -1);
+        std::vector<int> queue;
+        std::vector<int> best;
+        for (const Vertex &v : graph.vertices)
+        {
+            if (graph.IsBlocked(v.id) || region[v.id] >= 0)
+                continue;
+            queue.assign(1, v.id);
+            region[v.id] = v.id;
+            for (std::size_t head = 0; head < queue.size(); ++head)
+            {
+                for (const Neighbor &n : graph.GetNeighbors(queue[head]))
+                {
+                    if (region[n.id] < 0)
+                    {
+                        region[n.id] = v.id;
+                        queue.push_back(n.id);
+                    }
+                }
+            }
+            if (queue.size() > best.size())
+                best.swap(queue);
+        }
+
+        std::vector<int> starts = best, goals = best;
+        std::shuffle(starts.begin(), starts.end(), rng);
+        std::shuffle(goals.begin(), goals.end(), rng);
+        for (int i = 0; i < num_agents; ++i)
+        {
+            const Vertex &s = graph.vertices[starts[i]];
+            const Vertex &g = graph.vertices[goals[i]];
+            instance.starts.push_back({s.x, s.y, (int)Direction::Up});
+            instance.goals.push_back({g.x, g.y, (int)Direction::Up});
+        }
+        return instance;
+    }
+
+    // Open cells in the largest region, used to skip configurations that do not fit
+    std::size_t Capacity(int size, double density, long long seed)
+    {
+        Instance instance = MakeInstance(size, density, 0, seed);
+        std::size_t free_cells = 0;
+        for (std::size_t id = 0; id < instance.graph.Size(); ++id)
+            free_cells += !instance.graph.IsBlocked((int)id);
+        return free_cells;
+    }
+
+    double Percentile(std::vector<double> &sorted, double p)
+    {
+        if (sorted.empty())
+            return 0.0;
+        std::size_t index = (std::size_t)(p * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    void BM_Solve(benchmark::State &state, int size, int num_agents, double density, int num_threads, long long seed, int max_steps)
+    {
+        const Instance instance = MakeInstance(size, density, num_agents, seed);
+        std::vector<double> latencies;
+        latencies.reserve(max_steps + 1);
+        std::size_t allocations = 0;
+        int timesteps = 0;
+        bool success = true;
+
+        for (auto _ : state)
+        {
+            PibtOptions options;
+            options.seed = seed;
+            options.num_threads = num_threads;
+            PIBT pibt(instance.graph, instance.starts, instance.goals, options);
+            pibt.paths.Reserve(max_steps + 2);
+
+            latencies.clear();
+            std::size_t allocations_before = allocation_count.load(std::memory_order_relaxed);
+            auto solve_start = std::chrono::steady_clock::now();
+            while (!pibt.AllReached() && pibt.timesteps < max_steps)
+            {
+                auto step_start = std::chrono::steady_clock::now();
+                pibt.Step();
+                auto step_end = std::chrono::steady_clock::now();
+                latencies.push_back(std::chrono::duration<double, std::micro>(step_end - step_start).count());
+            }
+            auto solve_end = std::chrono::steady_clock::now();
+            allocations = allocation_count.load(std::memory_order_relaxed) - allocations_before;
+
+            state.SetIterationTime(std::chrono::duration<double>(solve_end - solve_start).count());
+            timesteps = pibt.timesteps;
+            success = pibt.AllReached();
+        }
+
+        // Latencies from the last iteration; the instance and seed are fixed, so iterations repeat the same run
+        std::vector<double> sorted = latencies;
+        std::sort(sorted.begin(), sorted.end());
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+
+        state.counters["timesteps"] = timesteps;
+        state.counters["success"] = success;
+        state.counters["step_p50_us"] = Percentile(sorted, 0.50);
+        state.counters["step_p99_us"] = Percentile(sorted, 0.99);
+        state.counters["step_max_us"] = sorted.empty() ? 0.0 : sorted.back();
+        state.counters["allocs_per_step"] = timesteps ? (double)allocations / timesteps : 0.0;
+        state.counters["peak_rss_mb"] = usage.ru_maxrss / 1024.0;
+    }
+
+    template <typename T>
+    std::vector<T> ParseList(const char *text)
+    {
+        std::vector<T> values;
+        while (*text)
+        {
+            char *end = nullptr;
+            values.push_back((T)std::strtod(text, &end));
+            text = *end == ',' ? end + 1 : end;
+            if (end == text && *text)
+                break;
+        }
+        return values;
+    }
+
+    // Consumes our own flags and leaves the rest for Google Benchmark
+    BenchConfig ParseFlags(int &argc, char **argv)
+    {
+        BenchConfig config;
+        int kept = 1;
+        for (int i = 1; i < argc; ++i)
+        {
+            const char *arg = argv[i];
+            if (!std::strncmp(arg, "--sizes=", 8))
+                config.sizes = ParseList<int>(arg + 8);
+            else if (!std::strncmp(arg, "--agents=", 9))
+                config.agents = ParseList<int>(arg + 9);
+            else if (!std::strncmp(arg, "--densities=", 12))
+                config.densities = ParseList<double>(arg + 12);
+            else if (!std::strncmp(arg, "--threads=", 10))
+                config.threads = ParseList<int>(arg + 10);
+            else if (!std::strncmp(arg, "--seed=", 7))
+                config.seed = std::atoll(arg + 7);
+            else if (!std::strncmp(arg, "--iterations=", 13))
+                config.iterations = std::max(1, std::atoi(arg + 13));
+            else if (!std::strncmp(arg, "--max-steps=", 12))
+                config.max_steps = std::max(1, std::atoi(arg + 12));
+            else
+                argv[kept++] = argv[i];
+        }
+        argc = kept;
+        return config;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    BenchConfig config = ParseFlags(argc, argv);
+
+    for (int size : config.sizes)
+    {
+        for (double density : config.densities)
+        {
+            // Leave at least half of the open cells free so instances stay solvable
+            const std::size_t capacity = Capacity(size, density, config.seed);
+            for (int num_agents : config.agents)
+            {
+                if ((std::size_t)num_agents * 2 > capacity)
+                    continue;
+
+                for (int num_threads : config.threads)
+                {
+                    std::string name = "Solve/size:" + std::to_string(size) +
+                                       "/agents:" + std::to_string(num_agents) +
+                                       "/density:" + std::to_string((int)(density * 100 + 0.5)) + "%" +
+                                       "/threads:" + std::to_string(num_threads);
+                    benchmark::RegisterBenchmark(name.c_str(), BM_Solve, size, num_agents, density, num_threads, config.seed, config.max_steps)
+                        ->UseManualTime()
+                        ->Iterations(config.iterations)
+                        ->Unit(benchmark::kMillisecond);
+                }
+            }
+        }
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -1,9 +1,11 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <vector>
-#include <unordered_set>
 #include <string>
+#include <type_traits>
 
-enum Direction
+enum Direction : uint8_t
 {
     Up,
     Down,
@@ -12,23 +14,81 @@ enum Direction
     None
 };
 
+// Lightweight non-owning view over a contiguous range (C++17 has no std::span)
+template <typename T>
+struct Span
+{
+    T *first = nullptr;
+    std::size_t count = 0;
+
+    Span() = default;
+    Span(T *_first, std::size_t _count) : first(_first), count(_count) {}
+    template <typename U, typename = typename std::enable_if<std::is_convertible<U *, T *>::value>::type>
+    Span(const Span<U> &other) : first(other.data()), count(other.size()) {}
+
+    T *begin() const { return first; }
+    T *end() const { return first + count; }
+    T *data() const { return first; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T &operator[](std::size_t i) const { return first[i]; }
+};
+
 struct Vertex
 {
-    int x, y;
-    Direction direction;
+    int id = -1;
+    int x = 0, y = 0;
     Vertex() = default;
-    Vertex(int a, int b, Direction dir) : x(a), y(b), direction(dir) {}
+    Vertex(int a, int b) : x(a), y(b) {}
+    Vertex(int _id, int a, int b) : id(_id), x(a), y(b) {}
+};
+
+// Outgoing edge of the adjacency table: target vertex id and the heading of the move
+struct Neighbor
+{
+    int id;
+    Direction direction;
+    Neighbor() {} // left uninitialized so the adjacency can be sized without a zero-fill pass
+    Neighbor(int _id, Direction _direction) : id(_id), direction(_direction) {}
 };
 
+// Directed graph in compressed sparse row form. Built either as a 4-connected grid or as a roadmap
+// over arbitrary vertices and one-way edges; the planner only walks the rows.
 class Graph
 {
 public:
-    int width, height;
-    std::unordered_set<Vertex *> locations;
+    int width = 0, height = 0;             // grid size; for roadmaps the extent of the positions
+    std::vector<Vertex> vertices;          // indexed by vertex id; on grids id == y * width + x
+    std::vector<uint8_t> blocked;          // indexed by vertex id, 1 for obstacle cells
+    std::vector<int> adjacency_offsets;    // CSR row starts, size vertices.size() + 1
+    std::vector<Neighbor> adjacency;       // CSR rows; on grids ordered Up, Down, Left, Right, obstacles have no edges
+    std::vector<int> reverse_offsets;      // incoming edges, only for roadmaps with one-way edges
+    std::vector<Neighbor> reverse_adjacency; // (source, heading of the edge) by target
+    int max_degree = 0;                    // longest adjacency row; after SetBlocked, an upper bound
+    bool grid = true;                      // false for roadmaps
+    uint64_t revision = 0;                 // bumped by every passability change
 
     Graph() = default;
     Graph(int w, int h);
-    ~Graph();
-    std::vector<Vertex *> GetNeighbors(const Vertex *v);
+    Graph(int w, int h, std::vector<uint8_t> obstacles);
+    Graph(std::vector<Vertex> _vertices, bool positioned, Span<const int32_t> sources, Span<const int32_t> targets);
+
+    int GetId(int x, int y) const;
+    Vertex *GetVertex(int x, int y);
+    const Vertex *GetVertex(int x, int y) const;
+    Span<const Neighbor> GetNeighbors(int id) const;
+    Span<const Neighbor> GetNeighbors(const Vertex *v) const { return GetNeighbors(v->id); }
+    // Vertices with an edge into id; the same as GetNeighbors unless the graph has one-way edges
+    Span<const Neighbor> GetPredecessors(int id) const;
+    bool IsBlocked(int id) const { return blocked[id] != 0; }
+    bool SetBlocked(int id, bool value);
+    uint64_t Hash() const;
+    std::size_t Size() const { return vertices.size(); }
     std::string DirectionToString(Direction direction);
-};
\ No newline at end of file
+
+private:
+    void BuildAdjacency();
+    int FillRow(int id, Neighbor *row) const;
+
+    std::vector<int> location_order; // positioned roadmaps: ids sorted by (y, x), for GetId
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file; the mapping lives as long as the object
+class MappedFile
+{
+public:
+    // sequential hints the kernel to read ahead; pass false for random access
+    explicit MappedFile(const std::string &path, bool sequential = true);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return contents; }
+    std::size_t size() const { return length; }
+    const char *begin() const { return contents; }
+    const char *end() const { return contents + length; }
+
+private:
+    const char *contents = nullptr;
+    std::size_t length = 0;
+};
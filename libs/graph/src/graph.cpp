@@ -1,63 +1,343 @@
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <numeric>
 #include <stdexcept>
+#include <utility>
 #include "graph.h"
 
 Graph::Graph(int w, int h)
-    : width(w), height(h)
+    : Graph(w, h, std::vector<uint8_t>())
 {
+}
+
+// obstacles is row-major with one entry per cell, non-zero for blocked cells; empty means no obstacles
+Graph::Graph(int w, int h, std::vector<uint8_t> obstacles)
+    : width(w), height(h), blocked(std::move(obstacles))
+{
+    if (width <= 0 || height <= 0)
+    {
+        throw std::invalid_argument("Graph dimensions must be positive.");
+    }
+    if (blocked.empty())
+    {
+        blocked.assign((std::size_t)width * height, 0);
+    }
+    if (blocked.size() != (std::size_t)width * height)
+    {
+        throw std::invalid_argument("Obstacle grid does not match graph dimensions.");
+    }
+
+    vertices.reserve((std::size_t)width * height);
     for (int y = 0; y < height; ++y)
     {
         for (int x = 0; x < width; ++x)
         {
-            Vertex *v = new Vertex(x, y, Direction::Up);
-            locations.insert(v);
+            vertices.emplace_back((int)vertices.size(), x, y);
         }
     }
+
+    BuildAdjacency();
 }
 
-Graph::~Graph()
+namespace
 {
-    for (Vertex *v : locations)
+    // Heading of an edge: the dominant axis of its displacement, horizontal on ties, with y growing
+    // downwards as on grids. Edges between coincident positions (elevators) have none.
+    Direction EdgeDirection(const Vertex &from, const Vertex &to)
     {
-        delete v;
+        const int dx = to.x - from.x, dy = to.y - from.y;
+        if (dx == 0 && dy == 0)
+            return Direction::None;
+        if (std::abs(dx) >= std::abs(dy))
+            return dx > 0 ? Direction::Right : Direction::Left;
+        return dy > 0 ? Direction::Down : Direction::Up;
+    }
+
+    // Counting sort of the edges by `rows`, each row keeping the input order
+    int BuildRows(int num_vertices, Span<const int32_t> rows, Span<const int32_t> ends, const std::vector<Vertex> &vertices,
+                  bool positioned, bool reversed, std::vector<int> &offsets, std::vector<Neighbor> &edges)
+    {
+        offsets.assign(num_vertices + 1, 0);
+        for (std::size_t e = 0; e < rows.size(); ++e)
+            ++offsets[rows[e] + 1];
+        int max_degree = 0;
+        for (int v = 0; v < num_vertices; ++v)
+        {
+            max_degree = std::max(max_degree, offsets[v + 1]);
+            offsets[v + 1] += offsets[v];
+        }
+
+        edges.resize(rows.size());
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (std::size_t e = 0; e < rows.size(); ++e)
+        {
+            const Vertex &from = vertices[reversed ? ends[e] : rows[e]], &to = vertices[reversed ? rows[e] : ends[e]];
+            edges[fill[rows[e]]++] = Neighbor(ends[e], positioned ? EdgeDirection(from, to) : Direction::None);
+        }
+        return max_degree;
     }
-    locations.clear();
 }
 
-std::vector<Vertex *> Graph::GetNeighbors(const Vertex *v)
+// Roadmap: `_vertices` in id order, carrying positions when `positioned` (otherwise vertex i is
+// placed at (i, 0)), and the directed edges sources[e] -> targets[e]. Rows keep the edges in input
+// order. Edge headings follow the positions, see EdgeDirection; without positions they are all None.
+// Positions must be non-negative and may be shared; width and height span them.
+Graph::Graph(std::vector<Vertex> _vertices, bool positioned, Span<const int32_t> sources, Span<const int32_t> targets)
+    : vertices(std::move(_vertices)), grid(false)
 {
-    std::vector<Vertex *> neighbors;
+    const int num_vertices = (int)vertices.size();
+    if (num_vertices == 0)
+    {
+        throw std::invalid_argument("A roadmap needs at least one vertex.");
+    }
+    if (sources.size() != targets.size())
+    {
+        throw std::invalid_argument("Edge sources and targets differ in length.");
+    }
+
+    width = positioned ? 0 : num_vertices;
+    height = 1;
+    for (int v = 0; v < num_vertices; ++v)
+    {
+        Vertex &vertex = vertices[v];
+        vertex.id = v;
+        if (!positioned)
+        {
+            vertex.x = v;
+            vertex.y = 0;
+        }
+        else if (vertex.x < 0 || vertex.y < 0)
+        {
+            throw std::invalid_argument("Roadmap positions must not be negative.");
+        }
+        width = std::max(width, vertex.x + 1);
+        height = std::max(height, vertex.y + 1);
+    }
+    blocked.assign(num_vertices, 0);
 
-    int dx[] = {0, 0, -1, 1};
-    int dy[] = {-1, 1, 0, 0};
+    for (std::size_t e = 0; e < sources.size(); ++e)
+    {
+        if ((unsigned)sources[e] >= (unsigned)num_vertices || (unsigned)targets[e] >= (unsigned)num_vertices)
+        {
+            throw std::invalid_argument("Roadmap edge " + std::to_string(e) + " has an invalid vertex.");
+        }
+        if (sources[e] == targets[e])
+        {
+            throw std::invalid_argument("Roadmap edge " + std::to_string(e) + " is a self-loop.");
+        }
+    }
 
-    std::vector<Direction> direction_vector = {Direction::Up, Direction::Down, Direction::Left, Direction::Right};
+    max_degree = BuildRows(num_vertices, sources, targets, vertices, positioned, false, adjacency_offsets, adjacency);
+    BuildRows(num_vertices, targets, sources, vertices, positioned, true, reverse_offsets, reverse_adjacency);
 
-    for (int i = 0; i < 4; ++i)
+    // Reject parallel edges, and drop the reverse rows when every edge has its twin
+    bool symmetric = true;
+    std::vector<int> forward, backward;
+    for (int v = 0; v < num_vertices; ++v)
+    {
+        forward.clear();
+        backward.clear();
+        for (const Neighbor &n : GetNeighbors(v))
+            forward.push_back(n.id);
+        for (int e = reverse_offsets[v]; e < reverse_offsets[v + 1]; ++e)
+            backward.push_back(reverse_adjacency[e].id);
+        std::sort(forward.begin(), forward.end());
+        if (std::adjacent_find(forward.begin(), forward.end()) != forward.end())
+        {
+            throw std::invalid_argument("Roadmap has parallel edges out of vertex " + std::to_string(v) + ".");
+        }
+        std::sort(backward.begin(), backward.end());
+        symmetric = symmetric && forward == backward;
+    }
+    if (symmetric)
+    {
+        std::vector<int>().swap(reverse_offsets);
+        std::vector<Neighbor>().swap(reverse_adjacency);
+    }
+
+    if (positioned)
+    {
+        location_order.resize(num_vertices);
+        std::iota(location_order.begin(), location_order.end(), 0);
+        std::stable_sort(location_order.begin(), location_order.end(), [this](int a, int b)
+                         { return vertices[a].y != vertices[b].y ? vertices[a].y < vertices[b].y : vertices[a].x < vertices[b].x; });
+    }
+}
+
+void Graph::BuildAdjacency()
+{
+    const int dx[] = {0, 0, -1, 1};
+    const int dy[] = {-1, 1, 0, 0};
+    const Direction direction_vector[] = {Direction::Up, Direction::Down, Direction::Left, Direction::Right};
+
+    // First pass sizes the rows, second pass fills them in place
+    const int num_vertices = (int)vertices.size();
+    adjacency_offsets.resize(num_vertices + 1);
+    int num_edges = 0;
+    max_degree = 0;
+    for (int y = 0; y < height; ++y)
     {
-        int nx = v->x + dx[i];
-        int ny = v->y + dy[i];
+        for (int x = 0; x < width; ++x)
+        {
+            const int id = y * width + x;
+            adjacency_offsets[id] = num_edges;
+            if (blocked[id])
+                continue;
 
-        if (nx >= 0 && ny >= 0 && nx < width && ny < height)
+            int degree = (y > 0 && !blocked[id - width]) + (y + 1 < height && !blocked[id + width]) +
+                         (x > 0 && !blocked[id - 1]) + (x + 1 < width && !blocked[id + 1]);
+            num_edges += degree;
+            max_degree = std::max(max_degree, degree);
+        }
+    }
+    adjacency_offsets[num_vertices] = num_edges;
+
+    adjacency.resize(num_edges);
+    Neighbor *row = adjacency.data();
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
         {
-            Vertex *neighbor = nullptr;
-            for (Vertex *vert : locations)
+            if (blocked[y * width + x])
+                continue;
+
+            for (int i = 0; i < 4; ++i)
             {
-                if (vert->x == nx && vert->y == ny)
+                int neighbor = GetId(x + dx[i], y + dy[i]);
+                if (neighbor >= 0 && !blocked[neighbor])
                 {
-                    neighbor = vert;
-                    neighbor->direction = direction_vector[i];
-                    break;
+                    *row++ = Neighbor(neighbor, direction_vector[i]);
                 }
             }
-            if (neighbor)
-            {
-                neighbors.push_back(neighbor);
-            }
         }
     }
+}
+
+// Writes the edges of one vertex, in BuildAdjacency's order, and returns their count
+int Graph::FillRow(int id, Neighbor *row) const
+{
+    if (blocked[id])
+        return 0;
+
+    const int x = id % width, y = id / width;
+    int degree = 0;
+    if (y > 0 && !blocked[id - width])
+        row[degree++] = Neighbor(id - width, Direction::Up);
+    if (y + 1 < height && !blocked[id + width])
+        row[degree++] = Neighbor(id + width, Direction::Down);
+    if (x > 0 && !blocked[id - 1])
+        row[degree++] = Neighbor(id - 1, Direction::Left);
+    if (x + 1 < width && !blocked[id + 1])
+        row[degree++] = Neighbor(id + 1, Direction::Right);
+    return degree;
+}
+
+// Blocks or unblocks a cell at runtime and returns whether its state changed. Only the adjacency
+// rows of the cell and its neighbours are rewritten; later rows shift by the change in edge count.
+// Distance tables built on the graph must be repaired afterwards, see DistanceCache::Repair.
+bool Graph::SetBlocked(int id, bool value)
+{
+    if (!grid)
+    {
+        throw std::logic_error("Runtime obstacles are only supported on grid graphs.");
+    }
+    if (id < 0 || id >= (int)vertices.size())
+    {
+        throw std::out_of_range("Invalid vertex id.");
+    }
+    if (IsBlocked(id) == value)
+        return false;
+    blocked[id] = value;
+
+    // Rows of the cell and its four neighbours all lie between the ones above and below it
+    const int first = std::max(0, id - width);
+    const int last = std::min((int)vertices.size() - 1, id + width);
+    std::vector<Neighbor> rows((std::size_t)(last - first + 1) * 4);
+    std::vector<int> degrees(last - first + 1);
+    int num_edges = 0;
+    for (int v = first; v <= last; ++v)
+    {
+        degrees[v - first] = FillRow(v, rows.data() + num_edges);
+        num_edges += degrees[v - first];
+        max_degree = std::max(max_degree, degrees[v - first]);
+    }
 
-    return neighbors;
+    const int begin = adjacency_offsets[first];
+    const int delta = num_edges - (adjacency_offsets[last + 1] - begin);
+    adjacency.erase(adjacency.begin() + begin, adjacency.begin() + adjacency_offsets[last + 1]);
+    adjacency.insert(adjacency.begin() + begin, rows.begin(), rows.begin() + num_edges);
+    for (int v = first + 1; v <= last; ++v)
+        adjacency_offsets[v] = adjacency_offsets[v - 1] + degrees[v - 1 - first];
+    for (std::size_t v = last + 1; v < adjacency_offsets.size(); ++v)
+        adjacency_offsets[v] += delta;
+
+    ++revision;
+    return true;
+}
+
+// On roadmaps, the lowest id at that position, found by binary search
+int Graph::GetId(int x, int y) const
+{
+    if (x < 0 || y < 0 || x >= width || y >= height)
+        return -1;
+    if (grid)
+        return y * width + x;
+    if (location_order.empty())
+        return x; // vertex i sits at (i, 0)
+
+    auto found = std::lower_bound(location_order.begin(), location_order.end(), std::make_pair(y, x), [this](int id, const std::pair<int, int> &position)
+                                  { return std::make_pair(vertices[id].y, vertices[id].x) < position; });
+    return found != location_order.end() && vertices[*found].x == x && vertices[*found].y == y ? *found : -1;
+}
+
+Vertex *Graph::GetVertex(int x, int y)
+{
+    int id = GetId(x, y);
+    return id < 0 ? nullptr : &vertices[id];
+}
+
+const Vertex *Graph::GetVertex(int x, int y) const
+{
+    int id = GetId(x, y);
+    return id < 0 ? nullptr : &vertices[id];
+}
+
+Span<const Neighbor> Graph::GetNeighbors(int id) const
+{
+    const int begin = adjacency_offsets[id];
+    return Span<const Neighbor>(adjacency.data() + begin, adjacency_offsets[id + 1] - begin);
+}
+
+Span<const Neighbor> Graph::GetPredecessors(int id) const
+{
+    if (reverse_offsets.empty())
+        return GetNeighbors(id);
+    const int begin = reverse_offsets[id];
+    return Span<const Neighbor>(reverse_adjacency.data() + begin, reverse_offsets[id + 1] - begin);
+}
+
+// FNV-1a over the dimensions and the adjacency, identifies a map for on-disk caches
+uint64_t Graph::Hash() const
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            hash ^= (value >> (8 * i)) & 0xFF;
+            hash *= 1099511628211ull;
+        }
+    };
+
+    mix((uint64_t)width);
+    mix((uint64_t)height);
+    mix(vertices.size());
+    for (int offset : adjacency_offsets)
+        mix((uint64_t)offset);
+    for (const Neighbor &n : adjacency)
+        mix(((uint64_t)n.id << 8) | n.direction);
+    return hash;
 }
 
 std::string Graph::DirectionToString(Direction direction) {
@@ -78,4 +358,4 @@ std::string Graph::DirectionToString(Direction direction) {
 
     // Shouldn't reach here
     return "INVALID";
-}
\ No newline at end of file
+}
@@ -0,0 +1,45 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &path, bool sequential)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Cannot stat file: " + path);
+    }
+
+    length = (std::size_t)info.st_size;
+    if (length > 0)
+    {
+        void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Cannot map file: " + path);
+        }
+        madvise(mapping, length, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+        contents = static_cast<const char *>(mapping);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (contents != nullptr)
+    {
+        munmap(const_cast<char *>(contents), length);
+    }
+}
@@ -18,51 +18,107 @@ TEST_F(GraphTest, InitializationTest) {
 
 // Test 2: Verify neighbor retrieval for a specific vertex
 TEST_F(GraphTest, GetNeighborsTest) {
-    Vertex *vertex = nullptr;
     // Find a vertex at (2, 2)
-    for (Vertex *v : graph.locations) {
-        if (v->x == 2 && v->y == 2) {
-            vertex = v;
-            break;
-        }
-    }
+    Vertex *vertex = graph.GetVertex(2, 2);
+    ASSERT_NE(vertex, nullptr);
 
     // Get neighbors for (2, 2)
-    std::vector<Vertex *> neighbors = graph.GetNeighbors(vertex);
+    Span<const Neighbor> neighbors = graph.GetNeighbors(vertex);
     
     // Expect there to be 4 neighbors (if no boundary issues)
     EXPECT_EQ(neighbors.size(), 4);
 
     // Check if all the directions are correctly set
-    EXPECT_EQ(neighbors[0]->direction, Direction::Up);
-    EXPECT_EQ(neighbors[1]->direction, Direction::Down);
-    EXPECT_EQ(neighbors[2]->direction, Direction::Left);
-    EXPECT_EQ(neighbors[3]->direction, Direction::Right);
+    EXPECT_EQ(neighbors[0].direction, Direction::Up);
+    EXPECT_EQ(neighbors[1].direction, Direction::Down);
+    EXPECT_EQ(neighbors[2].direction, Direction::Left);
+    EXPECT_EQ(neighbors[3].direction, Direction::Right);
+
+    // Check that the neighbors are the adjacent cells
+    EXPECT_EQ(neighbors[0].id, graph.GetId(2, 1));
+    EXPECT_EQ(neighbors[1].id, graph.GetId(2, 3));
+    EXPECT_EQ(neighbors[2].id, graph.GetId(1, 2));
+    EXPECT_EQ(neighbors[3].id, graph.GetId(3, 2));
 }
 
 // Test 3: Verify boundary conditions for neighbors
 TEST_F(GraphTest, GetNeighborsBoundaryTest) {
-    Vertex *vertex = nullptr;
     // Find a vertex at the top-left corner (0, 0)
-    for (Vertex *v : graph.locations) {
-        if (v->x == 0 && v->y == 0) {
-            vertex = v;
-            break;
-        }
-    }
+    Vertex *vertex = graph.GetVertex(0, 0);
+    ASSERT_NE(vertex, nullptr);
 
     // Get neighbors for (0, 0)
-    std::vector<Vertex *> neighbors = graph.GetNeighbors(vertex);
+    Span<const Neighbor> neighbors = graph.GetNeighbors(vertex);
     
     // Expect only 2 neighbors (down and right) due to boundary limits
     EXPECT_EQ(neighbors.size(), 2);
 
     // Check if the directions are correct
-    EXPECT_EQ(neighbors[0]->direction, Direction::Down);
-    EXPECT_EQ(neighbors[1]->direction, Direction::Right);
+    EXPECT_EQ(neighbors[0].direction, Direction::Down);
+    EXPECT_EQ(neighbors[1].direction, Direction::Right);
+}
+
+// Test 4: Verify the (x, y) -> id index
+TEST_F(GraphTest, VertexIndexTest) {
+    for (int y = 0; y < graph.height; ++y) {
+        for (int x = 0; x < graph.width; ++x) {
+            Vertex *v = graph.GetVertex(x, y);
+            ASSERT_NE(v, nullptr);
+            EXPECT_EQ(v->x, x);
+            EXPECT_EQ(v->y, y);
+            EXPECT_EQ(&graph.vertices[v->id], v);
+        }
+    }
+
+    // Out of bounds cells have no vertex
+    EXPECT_EQ(graph.GetVertex(-1, 0), nullptr);
+    EXPECT_EQ(graph.GetVertex(0, 5), nullptr);
+    EXPECT_EQ(graph.GetId(5, 5), -1);
+}
+
+// Test 5: Verify obstacle cells are cut out of the adjacency
+TEST_F(GraphTest, ObstacleTest) {
+    std::vector<uint8_t> obstacles(9, 0);
+    obstacles[4] = 1; // block the center of a 3x3 grid
+    Graph blocked(3, 3, obstacles);
+
+    EXPECT_TRUE(blocked.IsBlocked(blocked.GetId(1, 1)));
+    EXPECT_EQ(blocked.GetNeighbors(blocked.GetId(1, 1)).size(), 0);
+
+    // (1, 0) loses its Down neighbor
+    Span<const Neighbor> neighbors = blocked.GetNeighbors(blocked.GetId(1, 0));
+    ASSERT_EQ(neighbors.size(), 2);
+    EXPECT_EQ(neighbors[0].direction, Direction::Left);
+    EXPECT_EQ(neighbors[1].direction, Direction::Right);
+
+    EXPECT_THROW(Graph(3, 3, std::vector<uint8_t>(4, 0)), std::invalid_argument);
 }
 
-// Test 4: Verify direction to string conversion
+// Test 6: Verify runtime blocking patches the adjacency as a rebuild would
+TEST_F(GraphTest, SetBlockedTest) {
+    std::vector<uint8_t> obstacles(7 * 6, 0);
+    Graph dynamic(7, 6, obstacles);
+    for (int i = 0; i < 200; ++i) {
+        int id = rand() % (7 * 6);
+        bool value = rand() % 3 != 0;
+        EXPECT_EQ(dynamic.SetBlocked(id, value), obstacles[id] != value);
+        obstacles[id] = value;
+
+        Graph rebuilt(7, 6, obstacles);
+        ASSERT_EQ(dynamic.adjacency_offsets, rebuilt.adjacency_offsets);
+        ASSERT_EQ(dynamic.adjacency.size(), rebuilt.adjacency.size());
+        for (std::size_t e = 0; e < rebuilt.adjacency.size(); ++e) {
+            EXPECT_EQ(dynamic.adjacency[e].id, rebuilt.adjacency[e].id);
+            EXPECT_EQ(dynamic.adjacency[e].direction, rebuilt.adjacency[e].direction);
+        }
+        EXPECT_EQ(dynamic.Hash(), rebuilt.Hash());
+        EXPECT_GE(dynamic.max_degree, rebuilt.max_degree);
+    }
+    EXPECT_GT(dynamic.revision, 0u);
+    EXPECT_THROW(dynamic.SetBlocked(7 * 6, true), std::out_of_range);
+}
+
+// Test 7: Verify direction to string conversion
 TEST_F(GraphTest, DirectionToStringTest) {
     EXPECT_EQ(graph.DirectionToString(Direction::Up), "UP");
     EXPECT_EQ(graph.DirectionToString(Direction::Down), "DOWN");
@@ -71,19 +127,73 @@ TEST_F(GraphTest, DirectionToStringTest) {
     EXPECT_EQ(graph.DirectionToString(Direction::None), "INVALID");
 }
 
-// Test 5: Verify invalid direction handling
+// Test 8: Verify invalid direction handling
 TEST_F(GraphTest, InvalidDirectionTest) {
     // Test an invalid direction that is out of the defined range
     Direction invalidDirection = static_cast<Direction>(-1);  // Invalid direction
     EXPECT_EQ(graph.DirectionToString(invalidDirection), "INVALID");
 }
 
-// Test 6: Ensure proper cleanup in the destructor
+// Test 9: Ensure proper cleanup in the destructor
 TEST_F(GraphTest, DestructorTest) {
-    // Check if the locations set is empty after destruction
+    // Check that the vertex array and adjacency are released with the graph
     {
         Graph tempGraph(5, 5);
         // Check that the graph was initialized with vertices
-        EXPECT_EQ(tempGraph.locations.size(), 25);
+        EXPECT_EQ(tempGraph.vertices.size(), 25);
+        // 4 corners with 2 edges, 12 border cells with 3 edges, 9 inner cells with 4 edges
+        EXPECT_EQ(tempGraph.adjacency.size(), 4 * 2 + 12 * 3 + 9 * 4);
     }
 }
+
+// Test 10: Verify a roadmap built from a directed edge list
+TEST_F(GraphTest, RoadmapFromEdgeList) {
+    // A one-way lane 0 -> 1 -> 2, a two-way diagonal 2 <-> 3 and an elevator 3 -> 4 at the same position
+    std::vector<Vertex> points = {Vertex(0, 0, 0), Vertex(1, 2, 0), Vertex(2, 2, 1), Vertex(3, 4, 4), Vertex(4, 4, 4)};
+    const std::vector<int32_t> sources = {0, 1, 2, 3, 3};
+    const std::vector<int32_t> targets = {1, 2, 3, 2, 4};
+    Graph roadmap(points, true, Span<const int32_t>(sources.data(), sources.size()), Span<const int32_t>(targets.data(), targets.size()));
+
+    EXPECT_FALSE(roadmap.grid);
+    EXPECT_EQ(roadmap.width, 5);
+    EXPECT_EQ(roadmap.height, 5);
+    EXPECT_EQ(roadmap.max_degree, 2);
+    ASSERT_EQ(roadmap.GetNeighbors(0).size(), 1u);
+    EXPECT_EQ(roadmap.GetNeighbors(0)[0].id, 1);
+    EXPECT_EQ(roadmap.GetNeighbors(0)[0].direction, Direction::Right);
+    EXPECT_EQ(roadmap.GetNeighbors(1)[0].direction, Direction::Down);
+    EXPECT_EQ(roadmap.GetNeighbors(3)[0].direction, Direction::Up);
+    EXPECT_EQ(roadmap.GetNeighbors(3)[1].direction, Direction::None);
+    EXPECT_EQ(roadmap.GetNeighbors(4).size(), 0u);
+
+    // One-way edges keep reverse rows
+    ASSERT_EQ(roadmap.GetPredecessors(1).size(), 1u);
+    EXPECT_EQ(roadmap.GetPredecessors(1)[0].id, 0);
+    EXPECT_EQ(roadmap.GetPredecessors(0).size(), 0u);
+    EXPECT_EQ(roadmap.GetPredecessors(2).size(), 2u);
+
+    // Positions find the lowest id there
+    EXPECT_EQ(roadmap.GetId(2, 1), 2);
+    EXPECT_EQ(roadmap.GetId(4, 4), 3);
+    EXPECT_EQ(roadmap.GetId(1, 1), -1);
+    EXPECT_THROW(roadmap.SetBlocked(0, true), std::logic_error);
+
+    // Without positions, vertex i sits at (i, 0) and every edge is undirected in heading
+    Graph unplaced(points, false, Span<const int32_t>(sources.data(), sources.size()), Span<const int32_t>(targets.data(), targets.size()));
+    EXPECT_EQ(unplaced.width, 5);
+    EXPECT_EQ(unplaced.height, 1);
+    EXPECT_EQ(unplaced.GetId(3, 0), 3);
+    EXPECT_EQ(unplaced.GetNeighbors(0)[0].direction, Direction::None);
+
+    // Symmetric roadmaps share the forward rows
+    const std::vector<int32_t> both_sources = {0, 1}, both_targets = {1, 0};
+    Graph pair(std::vector<Vertex>(2), false, Span<const int32_t>(both_sources.data(), 2), Span<const int32_t>(both_targets.data(), 2));
+    EXPECT_TRUE(pair.reverse_offsets.empty());
+    EXPECT_EQ(pair.GetPredecessors(0)[0].id, 1);
+
+    const std::vector<int32_t> loop = {2}, parallel_sources = {0, 0}, parallel_targets = {1, 1}, outside = {7};
+    EXPECT_THROW(Graph(points, true, Span<const int32_t>(loop.data(), 1), Span<const int32_t>(loop.data(), 1)), std::invalid_argument);
+    EXPECT_THROW(Graph(points, true, Span<const int32_t>(parallel_sources.data(), 2), Span<const int32_t>(parallel_targets.data(), 2)), std::invalid_argument);
+    EXPECT_THROW(Graph(points, true, Span<const int32_t>(loop.data(), 1), Span<const int32_t>(outside.data(), 1)), std::invalid_argument);
+    EXPECT_THROW(Graph(std::vector<Vertex>(), false, Span<const int32_t>(), Span<const int32_t>()), std::invalid_argument);
+}
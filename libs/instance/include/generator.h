@@ -0,0 +1,64 @@
+#pragma once
+
+#include <graph.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Seeded synthetic instances for stress and regression runs. The same options and seed always give
+// the same map and agents. Starts and goals are distinct cells of the map's largest connected
+// region, so every instance is solvable in principle. Agents start and end facing Up, as when
+// loaded from a scenario file.
+
+enum class MapFamily
+{
+    Open,      // no obstacles
+    Random,    // each cell blocked with probability `density`
+    Warehouse, // rows of 2-deep shelves `shelf_length` long, between aisles
+    Rooms,     // square rooms of side `room_size`, one door in every wall between neighbours
+    Maze       // perfect maze with corridors `corridor_width` wide
+};
+
+enum class GoalPattern
+{
+    Uniform, // goals spread over the whole region
+    Hotspot, // `hotspot_fraction` of the goals packed around `num_hotspots` cells, the rest uniform
+    Swap     // agents in pairs, each heading for its partner's start
+};
+
+struct GeneratorOptions
+{
+    MapFamily family = MapFamily::Random;
+    int width = 256, height = 256;
+    double density = 0.2;
+    int shelf_length = 10;
+    int room_size = 16;
+    int corridor_width = 2;
+    int num_agents = 1000; // at most the size of the largest region; -1 fills it
+    GoalPattern goals = GoalPattern::Uniform;
+    int num_hotspots = 4;
+    double hotspot_fraction = 0.5;
+    long long seed = 0;
+};
+
+// Agents as flat arrays of vertex ids and headings, ready for the PIBT span constructor
+struct GeneratedInstance
+{
+    std::shared_ptr<Graph> graph;
+    std::vector<int32_t> starts, goals, headings;
+    std::size_t capacity = 0; // cells in the largest region
+};
+
+// Blocked-cell mask of the map alone, row-major
+std::vector<uint8_t> GenerateObstacles(const GeneratorOptions &options);
+// Throws std::invalid_argument on bad options or more agents than the region holds
+GeneratedInstance Generate(const GeneratorOptions &options);
+
+// Writes the MovingAI formats read by LoadMap and LoadScenario. The scenario's optimal-length
+// column is written as 0: computing it would take a search per agent.
+void WriteMap(const std::string &path, const Graph &graph);
+void WriteScenario(const std::string &path, const std::string &map_name, const GeneratedInstance &instance);
+
+bool ParseMapFamily(const std::string &name, MapFamily &family);
+bool ParseGoalPattern(const std::string &name, GoalPattern &pattern);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <graph.h>
+#include <string>
+#include <vector>
+
+// Loaders for the MovingAI benchmark formats (https://movingai.com/benchmarks/formats.html).
+// Files are memory-mapped and parsed in place without copying lines into strings.
+
+// Scenario agents in the {x, y, direction} layout taken by PIBT
+struct Scenario
+{
+    int width = 0, height = 0; // map dimensions recorded in the scenario entries
+    std::vector<std::vector<int>> starts;
+    std::vector<std::vector<int>> goals;
+};
+
+// '.', 'G' and 'S' cells are passable, every other terrain character is an obstacle. A file
+// starting with a `roadmap` line is read with ParseRoadmap instead.
+Graph ParseMap(const char *begin, const char *end);
+Graph LoadMap(const std::string &path);
+
+// Roadmap: a `roadmap <vertices> <edges>` line, then in any order `v <x> <y>` lines giving the
+// positions of vertices 0, 1, ... (for all vertices or none), `e <a> <b>` lines for one-way edges
+// and `u <a> <b>` lines for two-way ones, <edges> lines in all. '#' starts a comment up to the line's end.
+// Scenario coordinates then name a vertex's position, or (id, 0) without positions.
+Graph ParseRoadmap(const char *begin, const char *end);
+Graph LoadRoadmap(const std::string &path);
+
+// Reads num_agents entries starting at entry `offset`; a negative num_agents reads all remaining entries.
+// Scenarios carry no headings, so every agent starts and ends facing Up.
+Scenario ParseScenario(const char *begin, const char *end, int num_agents = -1, int offset = 0);
+Scenario LoadScenario(const std::string &path, int num_agents = -1, int offset = 0);
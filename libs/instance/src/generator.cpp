@@ -0,0 +1,339 @@
+#include "generator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    // Warehouse shelves keep this many free cells to the map border
+    constexpr int kWarehouseMargin = 2;
+
+    void Validate(const GeneratorOptions &options)
+    {
+        if (options.width < 1 || options.height < 1)
+            throw std::invalid_argument("Map width and height must be positive.");
+        if (options.density < 0.0 || options.density > 1.0)
+            throw std::invalid_argument("Obstacle density must be between 0 and 1.");
+        if (options.shelf_length < 1 || options.room_size < 1 || options.corridor_width < 1)
+            throw std::invalid_argument("Shelf length, room size and corridor width must be positive.");
+        if (options.num_agents < -1)
+            throw std::invalid_argument("Agent count must not be negative.");
+        if (options.num_hotspots < 1 || options.hotspot_fraction < 0.0 || options.hotspot_fraction > 1.0)
+            throw std::invalid_argument("Hotspot goals need at least one hotspot and a fraction between 0 and 1.");
+    }
+
+    void Warehouse(const GeneratorOptions &options, std::vector<uint8_t> &blocked)
+    {
+        const int inner_width = options.width - 2 * kWarehouseMargin;
+        const int inner_height = options.height - 2 * kWarehouseMargin;
+        const int period = options.shelf_length + 2; // shelf, then a two-cell cross aisle
+        for (int y = 0; y < inner_height; ++y)
+        {
+            // Two shelf rows, then an aisle; only whole shelves are placed
+            if (y % 3 == 2 || y - y % 3 + 2 > inner_height)
+                continue;
+            for (int x = 0; x < inner_width; ++x)
+            {
+                if (x % period < options.shelf_length && x - x % period + options.shelf_length <= inner_width)
+                    blocked[(std::size_t)(y + kWarehouseMargin) * options.width + x + kWarehouseMargin] = 1;
+            }
+        }
+    }
+
+    void Rooms(const GeneratorOptions &options, std::mt19937 &rng, std::vector<uint8_t> &blocked)
+    {
+        const int stride = options.room_size + 1;
+        for (int y = 0; y < options.height; ++y)
+        {
+            for (int x = 0; x < options.width; ++x)
+                blocked[(std::size_t)y * options.width + x] = x % stride == options.room_size || y % stride == options.room_size;
+        }
+
+        // One door in each wall segment between two rooms
+        auto door = [&](int first, int last) { return std::uniform_int_distribution<int>(first, last)(rng); };
+        for (int wall = options.room_size; wall + 1 < options.width; wall += stride)
+        {
+            for (int y = 0; y < options.height; y += stride)
+                blocked[(std::size_t)door(y, std::min(y + options.room_size, options.height) - 1) * options.width + wall] = 0;
+        }
+        for (int wall = options.room_size; wall + 1 < options.height; wall += stride)
+        {
+            for (int x = 0; x < options.width; x += stride)
+                blocked[(std::size_t)wall * options.width + door(x, std::min(x + options.room_size, options.width) - 1)] = 0;
+        }
+    }
+
+    // Randomized depth-first carving over cells corridor_width wide, separated by one-cell walls
+    void Maze(const GeneratorOptions &options, std::mt19937 &rng, std::vector<uint8_t> &blocked)
+    {
+        std::fill(blocked.begin(), blocked.end(), 1);
+        const int width = options.corridor_width, stride = width + 1;
+        if (options.width < width || options.height < width)
+            return;
+        const int cells_x = (options.width - width) / stride + 1;
+        const int cells_y = (options.height - width) / stride + 1;
+
+        // Opens the cells [x, x + w) x [y, y + h)
+        auto open = [&](int x, int y, int w, int h)
+        {
+            for (int j = y; j < y + h; ++j)
+                std::fill_n(blocked.begin() + (std::size_t)j * options.width + x, w, 0);
+        };
+
+        std::vector<uint8_t> visited((std::size_t)cells_x * cells_y, 0);
+        std::vector<int> stack(1, 0);
+        visited[0] = 1;
+        open(0, 0, width, width);
+        const int dx[4] = {0, 0, -1, 1}, dy[4] = {-1, 1, 0, 0};
+        while (!stack.empty())
+        {
+            const int cell = stack.back();
+            const int cx = cell % cells_x, cy = cell / cells_x;
+            int num_choices = 0, choices[4];
+            for (int d = 0; d < 4; ++d)
+            {
+                const int nx = cx + dx[d], ny = cy + dy[d];
+                if (nx >= 0 && ny >= 0 && nx < cells_x && ny < cells_y && !visited[(std::size_t)ny * cells_x + nx])
+                    choices[num_choices++] = d;
+            }
+            if (num_choices == 0)
+            {
+                stack.pop_back();
+                continue;
+            }
+
+            const int d = choices[std::uniform_int_distribution<int>(0, num_choices - 1)(rng)];
+            const int nx = cx + dx[d], ny = cy + dy[d];
+            visited[(std::size_t)ny * cells_x + nx] = 1;
+            stack.push_back(ny * cells_x + nx);
+            open(nx * stride, ny * stride, width, width);
+            // The wall between the two cells
+            if (dx[d] != 0)
+                open(std::min(cx, nx) * stride + width, cy * stride, 1, width);
+            else
+                open(cx * stride, std::min(cy, ny) * stride + width, width, 1);
+        }
+    }
+
+    // Cells of the largest 4-connected open region, in BFS order
+    std::vector<int32_t> LargestRegion(const Graph &graph)
+    {
+        std::vector<uint8_t> seen(graph.Size(), 0);
+        std::vector<int32_t> queue, best;
+        for (const Vertex &v : graph.vertices)
+        {
+            if (graph.IsBlocked(v.id) || seen[v.id])
+                continue;
+            queue.assign(1, v.id);
+            seen[v.id] = 1;
+            for (std::size_t head = 0; head < queue.size(); ++head)
+            {
+                for (const Neighbor &n : graph.GetNeighbors(queue[head]))
+                {
+                    if (!seen[n.id])
+                    {
+                        seen[n.id] = 1;
+                        queue.push_back(n.id);
+                    }
+                }
+            }
+            if (queue.size() > best.size())
+                best.swap(queue);
+        }
+        return best;
+    }
+
+    // First `count` entries of a uniform random permutation of `cells`, shuffling only those
+    std::vector<int32_t> Sample(std::vector<int32_t> cells, std::size_t count, std::mt19937 &rng)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            std::swap(cells[i], cells[std::uniform_int_distribution<std::size_t>(i, cells.size() - 1)(rng)]);
+        cells.resize(count);
+        return cells;
+    }
+
+    // Nearest cells around randomly placed hotspots first, the rest uniformly from what is left
+    std::vector<int32_t> HotspotGoals(const GeneratorOptions &options, const Graph &graph,
+                                      const std::vector<int32_t> &region, std::size_t count, std::mt19937 &rng)
+    {
+        const std::size_t num_hot = std::min(count, (std::size_t)(options.hotspot_fraction * count + 0.5));
+        const std::size_t num_hotspots = std::min(region.size(), (std::size_t)options.num_hotspots);
+
+        // Breadth-first from all hotspots at once, so each gathers goals at the same pace
+        std::vector<uint8_t> used(graph.Size(), 0);
+        std::vector<int32_t> goals = Sample(region, num_hotspots, rng);
+        for (int32_t hotspot : goals)
+            used[hotspot] = 1;
+        for (std::size_t head = 0; head < goals.size() && goals.size() < num_hot; ++head)
+        {
+            for (const Neighbor &n : graph.GetNeighbors(goals[head]))
+            {
+                if (!used[n.id] && goals.size() < num_hot)
+                {
+                    used[n.id] = 1;
+                    goals.push_back(n.id);
+                }
+            }
+        }
+        goals.resize(std::min(goals.size(), num_hot));
+        std::fill(used.begin(), used.end(), 0);
+        for (int32_t goal : goals)
+            used[goal] = 1;
+
+        std::vector<int32_t> rest;
+        rest.reserve(region.size() - goals.size());
+        for (int32_t cell : region)
+        {
+            if (!used[cell])
+                rest.push_back(cell);
+        }
+        rest = Sample(std::move(rest), count - goals.size(), rng);
+        goals.insert(goals.end(), rest.begin(), rest.end());
+        std::shuffle(goals.begin(), goals.end(), rng);
+        return goals;
+    }
+}
+
+std::vector<uint8_t> GenerateObstacles(const GeneratorOptions &options)
+{
+    Validate(options);
+    std::mt19937 rng((std::mt19937::result_type)options.seed);
+    std::vector<uint8_t> blocked((std::size_t)options.width * options.height, 0);
+    switch (options.family)
+    {
+    case MapFamily::Open:
+        break;
+    case MapFamily::Random:
+    {
+        std::bernoulli_distribution obstacle(options.density);
+        for (auto &cell : blocked)
+            cell = obstacle(rng);
+        break;
+    }
+    case MapFamily::Warehouse:
+        Warehouse(options, blocked);
+        break;
+    case MapFamily::Rooms:
+        Rooms(options, rng, blocked);
+        break;
+    case MapFamily::Maze:
+        Maze(options, rng, blocked);
+        break;
+    }
+    return blocked;
+}
+
+GeneratedInstance Generate(const GeneratorOptions &options)
+{
+    GeneratedInstance instance;
+    instance.graph = std::make_shared<Graph>(options.width, options.height, GenerateObstacles(options));
+    const Graph &graph = *instance.graph;
+
+    const std::vector<int32_t> region = LargestRegion(graph);
+    instance.capacity = region.size();
+    const std::size_t count = options.num_agents < 0 ? region.size() : (std::size_t)options.num_agents;
+    if (count > region.size())
+    {
+        throw std::invalid_argument("The map's largest region has room for only " + std::to_string(region.size()) + " agents.");
+    }
+
+    // Agents draw from a stream of their own, so the map does not depend on the agent count
+    std::mt19937 rng((std::mt19937::result_type)options.seed ^ 0x9e3779b9u);
+    instance.starts = Sample(region, count, rng);
+    switch (options.goals)
+    {
+    case GoalPattern::Uniform:
+        instance.goals = Sample(region, count, rng);
+        break;
+    case GoalPattern::Hotspot:
+        instance.goals = HotspotGoals(options, graph, region, count, rng);
+        break;
+    case GoalPattern::Swap:
+        // An odd agent out keeps its start as goal
+        instance.goals = instance.starts;
+        for (std::size_t i = 0; i + 1 < count; i += 2)
+            std::swap(instance.goals[i], instance.goals[i + 1]);
+        break;
+    }
+    instance.headings.assign(count, (int32_t)Direction::Up);
+    return instance;
+}
+
+void WriteMap(const std::string &path, const Graph &graph)
+{
+    std::string text = "type octile\nheight " + std::to_string(graph.height) + "\nwidth " + std::to_string(graph.width) + "\nmap\n";
+    const std::size_t header = text.size();
+    text.resize(header + (std::size_t)(graph.width + 1) * graph.height);
+    char *p = &text[header];
+    for (int y = 0; y < graph.height; ++y)
+    {
+        for (int x = 0; x < graph.width; ++x)
+            *p++ = graph.IsBlocked(graph.GetId(x, y)) ? '@' : '.';
+        *p++ = '\n';
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out || !out.write(text.data(), text.size()))
+    {
+        throw std::runtime_error("Cannot write map: " + path);
+    }
+}
+
+void WriteScenario(const std::string &path, const std::string &map_name, const GeneratedInstance &instance)
+{
+    const Graph &graph = *instance.graph;
+    std::string text = "version 1\n";
+    text.reserve(text.size() + instance.starts.size() * (map_name.size() + 48));
+    char line[96];
+    for (std::size_t i = 0; i < instance.starts.size(); ++i)
+    {
+        const Vertex &s = graph.vertices[instance.starts[i]];
+        const Vertex &g = graph.vertices[instance.goals[i]];
+        text += "0\t";
+        text += map_name;
+        const int length = std::snprintf(line, sizeof(line), "\t%d\t%d\t%d\t%d\t%d\t%d\t0\n",
+                                         graph.width, graph.height, s.x, s.y, g.x, g.y);
+        text.append(line, length);
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out || !out.write(text.data(), text.size()))
+    {
+        throw std::runtime_error("Cannot write scenario: " + path);
+    }
+}
+
+bool ParseMapFamily(const std::string &name, MapFamily &family)
+{
+    static const std::pair<const char *, MapFamily> kNames[] = {
+        {"open", MapFamily::Open}, {"random", MapFamily::Random}, {"warehouse", MapFamily::Warehouse},
+        {"rooms", MapFamily::Rooms}, {"maze", MapFamily::Maze}};
+    for (const auto &entry : kNames)
+    {
+        if (name == entry.first)
+        {
+            family = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseGoalPattern(const std::string &name, GoalPattern &pattern)
+{
+    static const std::pair<const char *, GoalPattern> kNames[] = {
+        {"uniform", GoalPattern::Uniform}, {"hotspot", GoalPattern::Hotspot}, {"swap", GoalPattern::Swap}};
+    for (const auto &entry : kNames)
+    {
+        if (name == entry.first)
+        {
+            pattern = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,277 @@
+#include "instance.h"
+
+#include <cstring>
+#include <mapped_file.h>
+#include <stdexcept>
+
+namespace
+{
+    bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    // Advances past whitespace and returns the next token as [token, p)
+    const char *NextToken(const char *&p, const char *end)
+    {
+        while (p < end && IsSpace(*p))
+            ++p;
+        const char *token = p;
+        while (p < end && !IsSpace(*p))
+            ++p;
+        return token;
+    }
+
+    bool TokenEquals(const char *token, const char *token_end, const char *word)
+    {
+        std::size_t length = std::strlen(word);
+        return (std::size_t)(token_end - token) == length && std::memcmp(token, word, length) == 0;
+    }
+
+    int ReadInt(const char *&p, const char *end)
+    {
+        const char *token = NextToken(p, end);
+        if (token == p)
+        {
+            throw std::runtime_error("Unexpected end of file.");
+        }
+
+        bool negative = *token == '-';
+        const char *c = negative ? token + 1 : token;
+        if (c == p)
+        {
+            throw std::runtime_error("Expected an integer.");
+        }
+
+        int value = 0;
+        for (; c < p; ++c)
+        {
+            if (*c < '0' || *c > '9')
+            {
+                throw std::runtime_error("Expected an integer, got '" + std::string(token, p) + "'.");
+            }
+            value = value * 10 + (*c - '0');
+        }
+        return negative ? -value : value;
+    }
+
+    void SkipLine(const char *&p, const char *end)
+    {
+        const void *newline = std::memchr(p, '\n', end - p);
+        p = newline ? static_cast<const char *>(newline) + 1 : end;
+    }
+
+    bool IsBlankLine(const char *p, const char *end)
+    {
+        for (; p < end && *p != '\n'; ++p)
+        {
+            if (!IsSpace(*p))
+                return false;
+        }
+        return true;
+    }
+}
+
+Graph ParseMap(const char *begin, const char *end)
+{
+    const char *p = begin;
+    const char *first = NextToken(p, end);
+    if (TokenEquals(first, p, "roadmap"))
+        return ParseRoadmap(begin, end);
+    p = begin;
+    int width = -1, height = -1;
+
+    while (true)
+    {
+        const char *token = NextToken(p, end);
+        if (token == p)
+        {
+            throw std::runtime_error("Map header is missing the 'map' line.");
+        }
+
+        if (TokenEquals(token, p, "map"))
+            break;
+        if (TokenEquals(token, p, "height"))
+            height = ReadInt(p, end);
+        else if (TokenEquals(token, p, "width"))
+            width = ReadInt(p, end);
+        else
+            SkipLine(p, end); // "type octile" and unknown header fields
+    }
+
+    if (width <= 0 || height <= 0)
+    {
+        throw std::runtime_error("Map header has no valid width and height.");
+    }
+
+    std::vector<uint8_t> obstacles((std::size_t)width * height);
+    SkipLine(p, end);
+    for (int y = 0; y < height; ++y)
+    {
+        while (p < end && (*p == '\r' || *p == '\n'))
+            ++p;
+        if (end - p < width)
+        {
+            throw std::runtime_error("Map has fewer cells than its header declares.");
+        }
+
+        uint8_t *row = obstacles.data() + (std::size_t)y * width;
+        for (int x = 0; x < width; ++x)
+        {
+            char c = p[x];
+            row[x] = !(c == '.' || c == 'G' || c == 'S');
+        }
+        p += width;
+    }
+
+    return Graph(width, height, std::move(obstacles));
+}
+
+Graph LoadMap(const std::string &path)
+{
+    MappedFile file(path);
+    return ParseMap(file.begin(), file.end());
+}
+
+Graph ParseRoadmap(const char *begin, const char *end)
+{
+    const char *p = begin;
+    const char *token = NextToken(p, end);
+    if (!TokenEquals(token, p, "roadmap"))
+    {
+        throw std::runtime_error("Roadmap does not start with a 'roadmap' line.");
+    }
+    const int num_vertices = ReadInt(p, end), num_edges = ReadInt(p, end);
+    if (num_vertices <= 0 || num_edges < 0)
+    {
+        throw std::runtime_error("Roadmap header has no valid vertex and edge counts.");
+    }
+
+    std::vector<Vertex> vertices(num_vertices);
+    std::vector<int32_t> sources, targets;
+    sources.reserve((std::size_t)num_edges * 2);
+    targets.reserve((std::size_t)num_edges * 2);
+    int positioned = 0, edges = 0;
+    while (true)
+    {
+        token = NextToken(p, end);
+        if (token == p)
+            break;
+        if (*token == '#')
+        {
+            SkipLine(p, end);
+            continue;
+        }
+
+        if (TokenEquals(token, p, "v"))
+        {
+            if (positioned == num_vertices)
+            {
+                throw std::runtime_error("Roadmap has more positions than vertices.");
+            }
+            vertices[positioned].x = ReadInt(p, end);
+            vertices[positioned].y = ReadInt(p, end);
+            ++positioned;
+        }
+        else if (TokenEquals(token, p, "e") || TokenEquals(token, p, "u"))
+        {
+            const bool two_way = *token == 'u';
+            const int a = ReadInt(p, end), b = ReadInt(p, end);
+            sources.push_back(a);
+            targets.push_back(b);
+            if (two_way)
+            {
+                sources.push_back(b);
+                targets.push_back(a);
+            }
+            ++edges;
+        }
+        else
+        {
+            throw std::runtime_error("Unknown roadmap line '" + std::string(token, p) + "'.");
+        }
+    }
+
+    if (positioned != 0 && positioned != num_vertices)
+    {
+        throw std::runtime_error("Roadmap gives positions for only some of its vertices.");
+    }
+    if (edges != num_edges)
+    {
+        throw std::runtime_error("Roadmap has a different number of edges than its header declares.");
+    }
+    return Graph(std::move(vertices), positioned != 0,
+                 Span<const int32_t>(sources.data(), sources.size()),
+                 Span<const int32_t>(targets.data(), targets.size()));
+}
+
+Graph LoadRoadmap(const std::string &path)
+{
+    MappedFile file(path);
+    return ParseRoadmap(file.begin(), file.end());
+}
+
+Scenario ParseScenario(const char *begin, const char *end, int num_agents, int offset)
+{
+    const char *p = begin;
+    const char *token = NextToken(p, end);
+    if (!TokenEquals(token, p, "version"))
+    {
+        throw std::runtime_error("Scenario does not start with a version line.");
+    }
+    SkipLine(p, end);
+
+    // Skip the first `offset` entries without parsing them
+    for (int skipped = 0; skipped < offset;)
+    {
+        if (p >= end)
+        {
+            throw std::runtime_error("Scenario offset is past the last entry.");
+        }
+        if (!IsBlankLine(p, end))
+            ++skipped;
+        SkipLine(p, end);
+    }
+
+    Scenario scenario;
+    if (num_agents > 0)
+    {
+        scenario.starts.reserve(num_agents);
+        scenario.goals.reserve(num_agents);
+    }
+
+    while (num_agents < 0 || (int)scenario.starts.size() < num_agents)
+    {
+        while (p < end && IsBlankLine(p, end))
+            SkipLine(p, end);
+        if (p >= end)
+            break;
+
+        ReadInt(p, end);   // bucket
+        NextToken(p, end); // map file name
+        scenario.width = ReadInt(p, end);
+        scenario.height = ReadInt(p, end);
+        int start_x = ReadInt(p, end);
+        int start_y = ReadInt(p, end);
+        int goal_x = ReadInt(p, end);
+        int goal_y = ReadInt(p, end);
+        SkipLine(p, end); // optimal length
+
+        scenario.starts.push_back({start_x, start_y, (int)Direction::Up});
+        scenario.goals.push_back({goal_x, goal_y, (int)Direction::Up});
+    }
+
+    if (num_agents > 0 && (int)scenario.starts.size() < num_agents)
+    {
+        throw std::runtime_error("Scenario has only " + std::to_string(scenario.starts.size()) +
+                                 " entries after the offset, " + std::to_string(num_agents) + " requested.");
+    }
+
+    return scenario;
+}
+
+Scenario LoadScenario(const std::string &path, int num_agents, int offset)
+{
+    MappedFile file(path);
+    return ParseScenario(file.begin(), file.end(), num_agents, offset);
+}
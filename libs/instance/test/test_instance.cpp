@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include "generator.h"
+#include "instance.h"
+
+static const std::string kMap =
+    "type octile\n"
+    "height 3\n"
+    "width 4\n"
+    "map\n"
+    "..@.\n"
+    ".T..\n"
+    "G..S\n";
+
+static const std::string kScenario =
+    "version 1\n"
+    "0\ttest.map\t4\t3\t0\t0\t3\t2\t5.00000000\n"
+    "0\ttest.map\t4\t3\t3\t0\t0\t2\t5.00000000\n"
+    "\n"
+    "1\ttest.map\t4\t3\t2\t2\t3\t1\t2.00000000\n";
+
+// Test case 1: Verify map dimensions and obstacles
+TEST(InstanceTest, ParseMap) {
+    Graph graph = ParseMap(kMap.data(), kMap.data() + kMap.size());
+
+    EXPECT_EQ(graph.width, 4);
+    EXPECT_EQ(graph.height, 3);
+    EXPECT_TRUE(graph.IsBlocked(graph.GetId(2, 0)));
+    EXPECT_TRUE(graph.IsBlocked(graph.GetId(1, 1)));
+    EXPECT_FALSE(graph.IsBlocked(graph.GetId(0, 2)));
+    EXPECT_FALSE(graph.IsBlocked(graph.GetId(3, 2)));
+
+    // (1, 0) has the obstacle at (1, 1) below and (2, 0) to the right
+    EXPECT_EQ(graph.GetNeighbors(graph.GetId(1, 0)).size(), 1);
+    EXPECT_EQ(graph.GetNeighbors(graph.GetId(2, 0)).size(), 0);
+}
+
+// Test case 2: Verify malformed maps are rejected
+TEST(InstanceTest, ParseTruncatedMap) {
+    std::string truncated = kMap.substr(0, kMap.size() - 4);
+    EXPECT_THROW(ParseMap(truncated.data(), truncated.data() + truncated.size()), std::runtime_error);
+
+    std::string no_header = "type octile\nmap\n....\n";
+    EXPECT_THROW(ParseMap(no_header.data(), no_header.data() + no_header.size()), std::runtime_error);
+}
+
+// Test case 3: Verify scenario slices
+TEST(InstanceTest, ParseScenario) {
+    const char *begin = kScenario.data();
+    const char *end = begin + kScenario.size();
+
+    Scenario all = ParseScenario(begin, end);
+    ASSERT_EQ(all.starts.size(), 3);
+    EXPECT_EQ(all.width, 4);
+    EXPECT_EQ(all.height, 3);
+    EXPECT_EQ(all.starts[0], (std::vector<int>{0, 0, 0}));
+    EXPECT_EQ(all.goals[0], (std::vector<int>{3, 2, 0}));
+
+    Scenario slice = ParseScenario(begin, end, 1, 1);
+    ASSERT_EQ(slice.starts.size(), 1);
+    EXPECT_EQ(slice.starts[0], (std::vector<int>{3, 0, 0}));
+
+    Scenario tail = ParseScenario(begin, end, -1, 2);
+    ASSERT_EQ(tail.starts.size(), 1);
+    EXPECT_EQ(tail.goals[0], (std::vector<int>{3, 1, 0}));
+
+    EXPECT_THROW(ParseScenario(begin, end, 3, 1), std::runtime_error);
+    EXPECT_THROW(ParseScenario(begin, end, 1, 4), std::runtime_error);
+}
+
+// Test case 4: Verify loading through a memory-mapped file
+TEST(InstanceTest, LoadFromFile) {
+    std::string path = testing::TempDir() + "instance_test.map";
+    {
+        std::ofstream out(path);
+        out << kMap;
+    }
+
+    Graph graph = LoadMap(path);
+    EXPECT_EQ(graph.Size(), 12);
+    std::remove(path.c_str());
+
+    EXPECT_THROW(LoadMap(path), std::runtime_error);
+}
+
+// Test case 5: Verify generated instances are reproducible and solvable in principle
+TEST(InstanceTest, GenerateFamilies) {
+    for (MapFamily family : {MapFamily::Open, MapFamily::Random, MapFamily::Warehouse, MapFamily::Rooms, MapFamily::Maze}) {
+        GeneratorOptions options;
+        options.family = family;
+        options.width = 90;
+        options.height = 70;
+        options.num_agents = 500;
+        options.seed = 5;
+        GeneratedInstance a = Generate(options), b = Generate(options);
+        const Graph &graph = *a.graph;
+        ASSERT_EQ(graph.Size(), 90 * 70);
+        EXPECT_EQ(a.starts, b.starts);
+        EXPECT_EQ(a.goals, b.goals);
+        EXPECT_EQ(GenerateObstacles(options), GenerateObstacles(options));
+
+        // Distinct starts and goals, all in one region
+        std::vector<int32_t> starts = a.starts, goals = a.goals;
+        std::sort(starts.begin(), starts.end());
+        std::sort(goals.begin(), goals.end());
+        EXPECT_EQ(std::unique(starts.begin(), starts.end()), starts.end());
+        EXPECT_EQ(std::unique(goals.begin(), goals.end()), goals.end());
+        std::vector<uint8_t> reached(graph.Size(), 0);
+        std::vector<int> queue(1, a.starts[0]);
+        reached[a.starts[0]] = 1;
+        for (std::size_t head = 0; head < queue.size(); ++head) {
+            for (const Neighbor &n : graph.GetNeighbors(queue[head])) {
+                if (!reached[n.id]) {
+                    reached[n.id] = 1;
+                    queue.push_back(n.id);
+                }
+            }
+        }
+        EXPECT_EQ(queue.size(), a.capacity);
+        for (int i = 0; i < 500; ++i) {
+            EXPECT_TRUE(reached[a.starts[i]] && reached[a.goals[i]]);
+            EXPECT_EQ(a.headings[i], Direction::Up);
+        }
+
+        options.seed = 6;
+        EXPECT_NE(Generate(options).starts, a.starts);
+    }
+
+    GeneratorOptions full;
+    full.family = MapFamily::Maze;
+    full.width = full.height = 40;
+    full.num_agents = -1;
+    GeneratedInstance filled = Generate(full);
+    EXPECT_EQ(filled.starts.size(), filled.capacity);
+    full.num_agents = (int)filled.capacity + 1;
+    EXPECT_THROW(Generate(full), std::invalid_argument);
+    full.density = 1.5;
+    EXPECT_THROW(Generate(full), std::invalid_argument);
+}
+
+// Test case 6: Verify the goal patterns and writing generated instances as MovingAI files
+TEST(InstanceTest, GenerateGoalPatterns) {
+    GeneratorOptions options;
+    options.family = MapFamily::Open;
+    options.width = options.height = 64;
+    options.num_agents = 101;
+    options.goals = GoalPattern::Swap;
+    GeneratedInstance swap = Generate(options);
+    for (int i = 0; i + 1 < 101; i += 2) {
+        EXPECT_EQ(swap.goals[i], swap.starts[i + 1]);
+        EXPECT_EQ(swap.goals[i + 1], swap.starts[i]);
+    }
+    EXPECT_EQ(swap.goals[100], swap.starts[100]);
+
+    // All goals around one hotspot: a diamond, possibly clipped by the border, not spread over the map
+    options.num_agents = 100;
+    options.goals = GoalPattern::Hotspot;
+    options.num_hotspots = 1;
+    options.hotspot_fraction = 1.0;
+    for (options.seed = 0; options.seed < 8; ++options.seed) {
+        GeneratedInstance hotspot = Generate(options);
+        int min_x = 64, max_x = 0, min_y = 64, max_y = 0;
+        for (int32_t goal : hotspot.goals) {
+            const Vertex &v = hotspot.graph->vertices[goal];
+            min_x = std::min(min_x, v.x);
+            max_x = std::max(max_x, v.x);
+            min_y = std::min(min_y, v.y);
+            max_y = std::max(max_y, v.y);
+        }
+        EXPECT_LE((max_x - min_x + 1) * (max_y - min_y + 1), 400);
+    }
+
+    options.family = MapFamily::Rooms;
+    options.room_size = 7;
+    options.hotspot_fraction = 0.3;
+    GeneratedInstance instance = Generate(options);
+    std::string map_path = testing::TempDir() + "generated.map";
+    std::string scen_path = testing::TempDir() + "generated.scen";
+    WriteMap(map_path, *instance.graph);
+    WriteScenario(scen_path, "generated.map", instance);
+    Graph graph = LoadMap(map_path);
+    Scenario scenario = LoadScenario(scen_path);
+    for (int id = 0; id < (int)graph.Size(); ++id)
+        ASSERT_EQ(graph.IsBlocked(id), instance.graph->IsBlocked(id));
+    ASSERT_EQ(scenario.starts.size(), 100u);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(graph.GetId(scenario.starts[i][0], scenario.starts[i][1]), instance.starts[i]);
+        EXPECT_EQ(graph.GetId(scenario.goals[i][0], scenario.goals[i][1]), instance.goals[i]);
+    }
+    std::remove(map_path.c_str());
+    std::remove(scen_path.c_str());
+}
+
+// Test case 7: Verify roadmaps are read from edge lists, through ParseMap as well
+TEST(InstanceTest, ParseRoadmap) {
+    const std::string roadmap =
+        "roadmap 4 3\n"
+        "# one-way ring 0 -> 1 -> 2 -> 0 with a spur to 3\n"
+        "v 0 0\nv 3 0\nv 3 2\nv 0 5\n"
+        "e 0 1\n"
+        "e 1 2\n"
+        "u 2 3\n";
+    Graph graph = ParseMap(roadmap.data(), roadmap.data() + roadmap.size());
+
+    EXPECT_FALSE(graph.grid);
+    EXPECT_EQ(graph.Size(), 4);
+    EXPECT_EQ(graph.adjacency.size(), 4u);
+    EXPECT_EQ(graph.GetId(0, 5), 3);
+    ASSERT_EQ(graph.GetNeighbors(2).size(), 1u);
+    EXPECT_EQ(graph.GetNeighbors(2)[0].id, 3);
+    EXPECT_EQ(graph.GetNeighbors(2)[0].direction, Direction::Left);
+    EXPECT_EQ(graph.GetPredecessors(1)[0].id, 0);
+
+    const std::string unplaced = "roadmap 2 1\ne 1 0\n";
+    Graph line = ParseRoadmap(unplaced.data(), unplaced.data() + unplaced.size());
+    EXPECT_EQ(line.GetNeighbors(1)[0].id, 0);
+    EXPECT_EQ(line.GetNeighbors(0).size(), 0u);
+
+    for (const std::string bad : {"roadmap 2 2\ne 0 1\n", "roadmap 2 0\nv 0 0\n", "roadmap 2 1\nx 0 1\n", "roadmap 2 1\ne 0 2\n", "roadmap 0 0\n"})
+        EXPECT_THROW(ParseRoadmap(bad.data(), bad.data() + bad.size()), std::exception) << bad;
+}
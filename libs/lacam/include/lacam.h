@@ -0,0 +1,128 @@
+#pragma once
+
+#include <graph.h>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "pibt.h"
+
+// Search settings
+struct LacamOptions
+{
+    // Give up once the search holds this many bytes of configurations and constraints
+    std::size_t memory_limit_bytes = std::size_t(1) << 30;
+    // Give up after this long; 0 for no limit
+    double time_limit_seconds = 0.0;
+    // Seed for the order in which constraints are tried
+    long long seed = 0;
+};
+
+// Fixed-length rows of T allocated in blocks, so that growing never moves or copies stored rows
+template <typename T>
+class RowBlocks
+{
+public:
+    void Reset(std::size_t _row_length, std::size_t _rows_per_block)
+    {
+        blocks.clear();
+        row_length = _row_length;
+        rows_per_block = _rows_per_block ? _rows_per_block : 1;
+        num_rows = 0;
+    }
+    T *Append()
+    {
+        if (num_rows == blocks.size() * rows_per_block)
+            blocks.emplace_back(new T[row_length * rows_per_block]);
+        return Row(num_rows++);
+    }
+    T *Row(std::size_t i) { return blocks[i / rows_per_block].get() + (i % rows_per_block) * row_length; }
+    const T *Row(std::size_t i) const { return blocks[i / rows_per_block].get() + (i % rows_per_block) * row_length; }
+    std::size_t MemoryUsage() const { return blocks.size() * rows_per_block * row_length * sizeof(T); }
+
+private:
+    std::vector<std::unique_ptr<T[]>> blocks;
+    std::size_t row_length = 0;
+    std::size_t rows_per_block = 1;
+    std::size_t num_rows = 0;
+};
+
+// Complete planner on top of PIBT (LaCAM, Okumura 2023). A depth-first search over joint
+// configurations where PIBT generates each successor; when a successor is a dead end or repeats,
+// the search backs up and asks PIBT again with some agents' moves fixed, widening those
+// constraints one agent at a time. Where PIBT alone succeeds the first descent is its own run.
+class LaCAM
+{
+public:
+    LaCAM(std::shared_ptr<Graph> _graph,
+          const std::vector<std::vector<int>> &starts,
+          const std::vector<std::vector<int>> &goals,
+          const PibtOptions &pibt_options = PibtOptions(),
+          const LacamOptions &_options = LacamOptions(),
+          std::shared_ptr<DistanceCache> distance_cache = nullptr);
+
+    // Searches until every agent is at its goal; on success `paths` holds one row per timestep
+    bool Solve();
+
+    std::size_t NumNodes() const { return nodes.size(); }
+    std::size_t MemoryUsage() const;
+    std::size_t SumOfCosts() const;
+
+    bool failed = false;
+    int timesteps = 0;
+    PathStore paths;
+    PIBT pibt; // successor generator; its agents hold the goals and tie-breaking priorities
+
+private:
+    // Joint configuration reached by the search. Its vertices and headings are row `index` of
+    // `configurations`, its priorities and planning order rows `index` of the blocks below.
+    struct Node
+    {
+        uint32_t parent;
+        uint32_t queue_head; // pending constraints, a list threaded through Constraint::next
+        uint32_t queue_tail;
+        uint32_t at_goal;    // agents at their goal
+        uint64_t hash;
+    };
+
+    // Fixes the next state of the agent at depth - 1 in its node's planning order; constraints
+    // inherit their parent's, so a chain of them fixes the first `depth` agents
+    struct Constraint
+    {
+        uint32_t parent;
+        uint32_t next;
+        uint32_t depth;
+        int32_t vertex;
+        Direction heading;
+    };
+
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    uint64_t Zobrist(int agent, int32_t vertex, Direction heading) const;
+    uint32_t AddNode(uint32_t parent, const int32_t *vertices, const Direction *headings, uint64_t hash);
+    uint32_t AddConstraint(uint32_t node, uint32_t parent, uint32_t depth, int32_t vertex, Direction heading);
+    void ExpandConstraint(uint32_t node, uint32_t constraint);
+    bool SameConfiguration(uint32_t node, const int32_t *vertices, const Direction *headings) const;
+    void Backtrack(uint32_t goal);
+
+    std::size_t num_agents;
+    LacamOptions options;
+    bool match_headings; // headings matter to the motion model, so they are part of a configuration
+    std::mt19937_64 rng;
+
+    std::deque<Node> nodes;
+    PathStore configurations;
+    RowBlocks<float> node_priorities;
+    RowBlocks<int> node_orders;
+    std::deque<Constraint> constraints;
+    std::unordered_multimap<uint64_t, uint32_t> explored;
+
+    // Scratch of Solve
+    std::vector<FixedMove> fixed;
+    std::vector<int32_t> next_vertices;
+    std::vector<Direction> next_headings;
+    std::vector<uint32_t> open;
+    std::vector<FixedMove> moves; // of ExpandConstraint, max_degree + 1
+};
@@ -0,0 +1,292 @@
+#include "lacam.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+
+namespace
+{
+    // PIBT only generates successors here: it records nothing and plans on the calling thread
+    PibtOptions GeneratorOptions(PibtOptions options)
+    {
+        if (options.rotation_steps != 1)
+        {
+            throw std::invalid_argument("LaCAM needs rotation_steps == 1, a turn must fit in one timestep.");
+        }
+        options.record_paths = false;
+        options.num_threads = 1;
+        return options;
+    }
+
+    uint64_t SplitMix64(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+}
+
+LaCAM::LaCAM(std::shared_ptr<Graph> _graph,
+             const std::vector<std::vector<int>> &starts,
+             const std::vector<std::vector<int>> &goals,
+             const PibtOptions &pibt_options,
+             const LacamOptions &_options,
+             std::shared_ptr<DistanceCache> distance_cache)
+    : pibt(std::move(_graph), starts, goals, GeneratorOptions(pibt_options), std::move(distance_cache)),
+      num_agents(starts.size()),
+      options(_options),
+      match_headings(pibt_options.motion_model != MotionModel::Holonomic),
+      rng((std::mt19937_64::result_type)_options.seed)
+{
+    // Blocks of about 256 KB each
+    const std::size_t rows_per_block = std::max<std::size_t>(1, (std::size_t(1) << 18) / (4 * std::max<std::size_t>(num_agents, 1)));
+    configurations.Reset(num_agents, rows_per_block);
+    node_priorities.Reset(num_agents, rows_per_block);
+    node_orders.Reset(num_agents, rows_per_block);
+    fixed.reserve(num_agents);
+    moves.resize(pibt.graph.max_degree + 1);
+    next_vertices.resize(num_agents);
+    next_headings.resize(num_agents);
+}
+
+// Random key of one agent's state; a configuration's hash is the XOR of its agents' keys, so a
+// successor's hash only needs the agents that moved or turned
+uint64_t LaCAM::Zobrist(int agent, int32_t vertex, Direction heading) const
+{
+    if (!match_headings)
+        heading = Direction::None;
+    return SplitMix64(((uint64_t)agent << 35) ^ ((uint64_t)vertex << 3) ^ (uint64_t)heading);
+}
+
+bool LaCAM::SameConfiguration(uint32_t node, const int32_t *vertices, const Direction *headings) const
+{
+    if (!std::equal(vertices, vertices + num_agents, configurations.Vertices(node).begin()))
+        return false;
+    return !match_headings || std::equal(headings, headings + num_agents, configurations.Headings(node).begin());
+}
+
+uint32_t LaCAM::AddConstraint(uint32_t node, uint32_t parent, uint32_t depth, int32_t vertex, Direction heading)
+{
+    const uint32_t index = (uint32_t)constraints.size();
+    constraints.push_back({parent, kNone, depth, vertex, heading});
+    Node &n = nodes[node];
+    if (n.queue_tail == kNone)
+        n.queue_head = index;
+    else
+        constraints[n.queue_tail].next = index;
+    n.queue_tail = index;
+    return index;
+}
+
+// Stores a configuration with the priorities PIBT would plan it with: one more than the parent's
+// for agents away from their goal, the tie-breaker alone for agents at it
+uint32_t LaCAM::AddNode(uint32_t parent, const int32_t *vertices, const Direction *headings, uint64_t hash)
+{
+    const uint32_t index = (uint32_t)configurations.AppendRow();
+    std::copy(vertices, vertices + num_agents, configurations.Vertices(index).begin());
+    std::copy(headings, headings + num_agents, configurations.Headings(index).begin());
+
+    float *priorities = node_priorities.Append();
+    const float *parent_priorities = parent == kNone ? nullptr : node_priorities.Row(parent);
+    uint32_t at_goal = 0;
+    for (const Agent &agent : pibt.agent_arena)
+    {
+        const float previous = parent == kNone ? agent.initial_priority : parent_priorities[agent.id];
+        if (vertices[agent.id] == agent.goal->id)
+        {
+            priorities[agent.id] = agent.initial_priority;
+            ++at_goal;
+        }
+        else
+        {
+            priorities[agent.id] = previous + 1.0f;
+        }
+    }
+
+    int *order = node_orders.Append();
+    std::iota(order, order + num_agents, 0);
+    std::sort(order, order + num_agents, [&](int a, int b)
+              {
+        if (priorities[a] != priorities[b])
+            return priorities[a] > priorities[b];
+        return pibt.agent_arena[a].initial_priority > pibt.agent_arena[b].initial_priority; });
+
+    nodes.push_back({parent, kNone, kNone, at_goal, hash});
+    AddConstraint(index, kNone, 0, -1, Direction::None);
+    return index;
+}
+
+// Queues the children of a constraint: every state the next agent in the node's order can reach
+// in one timestep, in random order
+void LaCAM::ExpandConstraint(uint32_t node, uint32_t constraint)
+{
+    const uint32_t depth = constraints[constraint].depth;
+    if (depth >= num_agents)
+        return;
+
+    const int agent = node_orders.Row(node)[depth];
+    const int32_t v = configurations.Vertices(node)[agent];
+    const Direction h = configurations.Headings(node)[agent];
+    const bool holonomic = pibt.options.motion_model == MotionModel::Holonomic;
+
+    std::size_t num_moves = 0;
+    moves[num_moves++] = {agent, v, h};
+    for (const Neighbor &n : pibt.graph.GetNeighbors(v))
+    {
+        if (holonomic)
+            moves[num_moves++] = {agent, n.id, HolonomicMotion::Heading(h, n.direction)};
+        else if (RotateThenMoveMotion::MustTurn(h, n.direction))
+            moves[num_moves++] = {agent, v, n.direction};
+        else
+            moves[num_moves++] = {agent, n.id, RotateThenMoveMotion::Heading(h, n.direction)};
+    }
+    std::shuffle(moves.begin(), moves.begin() + num_moves, rng);
+    for (std::size_t i = 0; i < num_moves; ++i)
+        AddConstraint(node, constraint, depth + 1, moves[i].vertex, moves[i].heading);
+}
+
+bool LaCAM::Solve()
+{
+    const auto start_time = std::chrono::steady_clock::now();
+
+    for (const Agent &agent : pibt.agent_arena)
+    {
+        next_vertices[agent.id] = agent.start->id;
+        next_headings[agent.id] = agent.current_direction;
+    }
+    uint64_t root_hash = 0;
+    for (std::size_t a = 0; a < num_agents; ++a)
+        root_hash ^= Zobrist((int)a, next_vertices[a], next_headings[a]);
+    const uint32_t root = AddNode(kNone, next_vertices.data(), next_headings.data(), root_hash);
+    explored.emplace(root_hash, root);
+    open.push_back(root);
+
+    std::size_t iterations = 0;
+    while (!open.empty())
+    {
+        if (MemoryUsage() > options.memory_limit_bytes)
+            break;
+        if (options.time_limit_seconds > 0.0 && ++iterations % 256 == 0 &&
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count() > options.time_limit_seconds)
+        {
+            break;
+        }
+
+        const uint32_t node = open.back();
+        if (nodes[node].at_goal == num_agents)
+        {
+            Backtrack(node);
+            return true;
+        }
+
+        // Every constraint of this configuration has been tried
+        const uint32_t constraint = nodes[node].queue_head;
+        if (constraint == kNone)
+        {
+            open.pop_back();
+            continue;
+        }
+        nodes[node].queue_head = constraints[constraint].next;
+        if (nodes[node].queue_head == kNone)
+            nodes[node].queue_tail = kNone;
+        ExpandConstraint(node, constraint);
+
+        const int *order = node_orders.Row(node);
+        fixed.clear();
+        for (uint32_t c = constraint; constraints[c].depth > 0; c = constraints[c].parent)
+        {
+            fixed.push_back({order[constraints[c].depth - 1], constraints[c].vertex, constraints[c].heading});
+        }
+
+        const Span<const int32_t> vertices = configurations.Vertices(node);
+        const Span<const Direction> headings = configurations.Headings(node);
+        if (!pibt.PlanFrom(vertices, headings, Span<const int>(order, num_agents),
+                           Span<const FixedMove>(fixed.data(), fixed.size()),
+                           Span<int32_t>(next_vertices.data(), num_agents), Span<Direction>(next_headings.data(), num_agents)))
+        {
+            continue;
+        }
+
+        uint64_t hash = nodes[node].hash;
+        for (std::size_t a = 0; a < num_agents; ++a)
+        {
+            if (next_vertices[a] != vertices[a] || next_headings[a] != headings[a])
+                hash ^= Zobrist((int)a, vertices[a], headings[a]) ^ Zobrist((int)a, next_vertices[a], next_headings[a]);
+        }
+
+        // Revisit a known configuration rather than storing it twice
+        uint32_t known = kNone;
+        auto range = explored.equal_range(hash);
+        for (auto it = range.first; it != range.second && known == kNone; ++it)
+        {
+            if (SameConfiguration(it->second, next_vertices.data(), next_headings.data()))
+                known = it->second;
+        }
+        if (known != kNone)
+        {
+            open.push_back(known);
+            continue;
+        }
+
+        const uint32_t child = AddNode(node, next_vertices.data(), next_headings.data(), hash);
+        explored.emplace(hash, child);
+        open.push_back(child);
+    }
+
+    failed = true;
+    return false;
+}
+
+// Writes the configurations from the start to `goal` into `paths`
+void LaCAM::Backtrack(uint32_t goal)
+{
+    std::vector<uint32_t> chain;
+    for (uint32_t node = goal; node != kNone; node = nodes[node].parent)
+        chain.push_back(node);
+
+    paths.Reset(num_agents);
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+    {
+        const std::size_t t = paths.AppendRow();
+        Span<const int32_t> vertices = configurations.Vertices(*it);
+        Span<const Direction> headings = configurations.Headings(*it);
+        std::copy(vertices.begin(), vertices.end(), paths.Vertices(t).begin());
+        std::copy(headings.begin(), headings.end(), paths.Headings(t).begin());
+    }
+    timesteps = (int)chain.size() - 1;
+}
+
+std::size_t LaCAM::SumOfCosts() const
+{
+    std::vector<int> last_away(num_agents, -1);
+    for (std::size_t t = 0; t < paths.NumTimesteps(); ++t)
+    {
+        Span<const int32_t> vertices = paths.Vertices(t);
+        for (const Agent &agent : pibt.agent_arena)
+        {
+            if (vertices[agent.id] != agent.goal->id)
+                last_away[agent.id] = (int)t;
+        }
+    }
+
+    std::size_t cost = 0;
+    for (int t : last_away)
+        cost += t + 1;
+    return cost;
+}
+
+// Bytes held by the search; the generator's own memory is reported by pibt.MemoryUsage()
+std::size_t LaCAM::MemoryUsage() const
+{
+    return nodes.size() * sizeof(Node) +
+           configurations.MemoryUsage() +
+           node_priorities.MemoryUsage() +
+           node_orders.MemoryUsage() +
+           constraints.size() * sizeof(Constraint) +
+           explored.size() * (sizeof(std::pair<uint64_t, uint32_t>) + 2 * sizeof(void *)) +
+           explored.bucket_count() * sizeof(void *) +
+           open.capacity() * sizeof(uint32_t) +
+           paths.MemoryUsage();
+}
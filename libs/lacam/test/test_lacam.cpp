@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+#include "lacam.h"
+#include "validator.h"
+
+namespace {
+    bool ValidPaths(const LaCAM &lacam) {
+        ValidatorOptions options;
+        options.motion_model = lacam.pibt.options.motion_model;
+        options.num_threads = 1;
+        Validator validator(lacam.pibt.graph, lacam.pibt.agent_arena.size(), options);
+        validator.Check(lacam.paths);
+        return validator.Valid();
+    }
+
+    bool AtGoals(const LaCAM &lacam) {
+        Span<const int32_t> last = lacam.paths.Vertices(lacam.paths.NumTimesteps() - 1);
+        for (const Agent &agent : lacam.pibt.agent_arena) {
+            if (last[agent.id] != agent.goal->id)
+                return false;
+        }
+        return true;
+    }
+}
+
+// Test case 1: Verify the first descent is plain PIBT where PIBT succeeds
+TEST(LacamTest, MatchesPibt) {
+    auto graph = std::make_shared<Graph>(8, 8);
+    std::vector<std::vector<int>> starts, goals;
+    for (int i = 0; i < 12; ++i) {
+        starts.push_back({i % 8, i / 8 * 3, i % 4});
+        goals.push_back({7 - i % 8, 7 - i / 8 * 3, 0});
+    }
+    PibtOptions options;
+    options.seed = 4;
+    PIBT pibt(graph, starts, goals, options);
+    pibt.RunPibt();
+    ASSERT_FALSE(pibt.failed);
+
+    LaCAM lacam(graph, starts, goals, options);
+    ASSERT_TRUE(lacam.Solve());
+    EXPECT_TRUE(AtGoals(lacam));
+    EXPECT_TRUE(ValidPaths(lacam));
+    EXPECT_EQ(lacam.NumNodes(), lacam.paths.NumTimesteps());
+
+    // Without PIBT's pipelined first timestep; PIBT also stops once each agent has visited its
+    // goal, LaCAM only when all of them are there at once
+    ASSERT_GE(lacam.paths.NumTimesteps() + 1, pibt.paths.NumTimesteps());
+    for (std::size_t t = 1; t < pibt.paths.NumTimesteps(); ++t) {
+        for (std::size_t a = 0; a < starts.size(); ++a) {
+            EXPECT_EQ(lacam.paths.Vertices(t - 1)[a], pibt.paths.Vertices(t)[a]);
+            EXPECT_EQ(lacam.paths.Headings(t - 1)[a], pibt.paths.Headings(t)[a]);
+        }
+    }
+}
+
+// Test case 2: Verify instances where PIBT livelocks are solved
+TEST(LacamTest, SolvesWherePibtFails) {
+    // ....
+    // @...
+    std::vector<uint8_t> obstacles = {0, 0, 0, 0, 1, 0, 0, 0};
+    auto graph = std::make_shared<Graph>(4, 2, obstacles);
+    std::vector<std::vector<int>> starts = {{0, 0, 0}, {2, 1, 0}, {1, 1, 0}, {1, 0, 0}};
+    std::vector<std::vector<int>> goals = {{1, 0, 0}, {0, 0, 0}, {1, 1, 0}, {3, 1, 0}};
+
+    for (MotionModel model : {MotionModel::RotateThenMove, MotionModel::Holonomic}) {
+        PibtOptions options;
+        options.seed = 1;
+        options.max_timesteps = 500;
+        options.motion_model = model;
+        PIBT pibt(graph, starts, goals, options);
+        pibt.RunPibt();
+
+        LaCAM lacam(graph, starts, goals, options);
+        ASSERT_TRUE(lacam.Solve());
+        EXPECT_FALSE(lacam.failed);
+        EXPECT_TRUE(AtGoals(lacam));
+        EXPECT_TRUE(ValidPaths(lacam));
+        if (model == MotionModel::RotateThenMove) {
+            EXPECT_TRUE(pibt.failed);
+        }
+    }
+}
+
+// Test case 3: Verify unsolvable instances and the limits end the search
+TEST(LacamTest, Failure) {
+    // Two agents cannot swap in a corridor; the search runs out of configurations
+    auto corridor = std::make_shared<Graph>(3, 1);
+    LaCAM swap(corridor, {{0, 0, 3}, {1, 0, 2}}, {{1, 0, 0}, {0, 0, 0}});
+    EXPECT_FALSE(swap.Solve());
+    EXPECT_TRUE(swap.failed);
+    EXPECT_GT(swap.NumNodes(), 1);
+
+    std::vector<std::vector<int>> starts, goals;
+    for (int i = 0; i < 30; ++i) {
+        starts.push_back({i % 6, i / 6, 0});
+        goals.push_back({(i + 7) % 6, (i / 6 + 3) % 6, 0});
+    }
+    LacamOptions options;
+    options.memory_limit_bytes = 1;
+    LaCAM bounded(std::make_shared<Graph>(6, 6), starts, goals, PibtOptions(), options);
+    EXPECT_FALSE(bounded.Solve());
+    EXPECT_LT(bounded.NumNodes(), 300);
+
+    PibtOptions slow_turns;
+    slow_turns.rotation_steps = 2;
+    EXPECT_THROW(LaCAM(corridor, {{0, 0, 0}}, {{2, 0, 0}}, slow_turns), std::invalid_argument);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Batched move ordering. At the start of a planning phase every agent's candidates, its grid
+// neighbours in adjacency order and then waiting, are scored at once as distance << 3 | slot:
+// the slot in the low bits makes ties keep adjacency order, as the stable per-agent sort did.
+// Keys are stored slot-major so each sorting-network comparator is one vector min/max across
+// agents. Configure with -DPIBT_ENABLE_AVX2=ON to sort eight agents per instruction; otherwise the
+// compiler vectorizes the scalar loop for the baseline instruction set.
+constexpr std::size_t kScoredCandidates = 5;   // four neighbours and waiting
+constexpr uint32_t kWaitSlot = 4;
+constexpr uint32_t kNoCandidate = UINT32_MAX;  // key of a missing neighbour; sorts last, slot 7
+constexpr uint32_t kOrderEnd = 7;              // slot that ends a packed order
+
+inline uint32_t CandidateKey(uint16_t distance, uint32_t slot)
+{
+    return (uint32_t)distance << 3 | slot;
+}
+
+// Sorts the kScoredCandidates keys of every lane in [begin, end) ascending, slot s of lane i at
+// keys[s * stride + i], and writes each lane's slots best first into orders[i], three bits per
+// slot from the lowest, ending with kOrderEnd
+void SortCandidates(uint32_t *keys, std::size_t stride, std::size_t begin, std::size_t end, uint32_t *orders);
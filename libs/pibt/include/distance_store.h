@@ -0,0 +1,50 @@
+#pragma once
+
+#include <graph.h>
+#include <mapped_file.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// On-disk set of per-goal distance tables for one map, memory-mapped read-only so that
+// every planner process on a host shares the same page-cache pages.
+//
+// Layout (little endian):
+//   DistanceStoreHeader
+//   int32  goals[num_goals]                  sorted ascending, padded to 8 bytes
+//   uint16 tables[num_goals][num_vertices]   same encoding as DistanceTable
+struct DistanceStoreHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t graph_hash;
+    uint64_t num_vertices;
+    uint64_t num_goals;
+};
+
+class DistanceStore
+{
+public:
+    static constexpr char kMagic[8] = {'P', 'I', 'B', 'T', 'D', 'I', 'S', 'T'};
+    static constexpr uint32_t kVersion = 1;
+
+    // Throws if the file is malformed, from another format version or built for another graph
+    DistanceStore(const std::string &path, const Graph &graph);
+
+    // Distances to goal, or nullptr if the store has no table for it
+    const uint16_t *Find(int goal) const;
+    std::size_t NumGoals() const { return num_goals; }
+
+private:
+    std::unique_ptr<MappedFile> file;
+    const int32_t *goals = nullptr;
+    const uint16_t *tables = nullptr;
+    std::size_t num_goals = 0;
+    std::size_t num_vertices = 0;
+};
+
+// Computes the distance tables of goals on num_threads workers (0 = all cores) and writes them to path.
+// An empty goal list stores every unblocked vertex, which costs 2 * |V|^2 bytes.
+void BuildDistanceStore(const Graph &graph, std::vector<int> goals, const std::string &path, int num_threads = 0);
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <graph.h>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// BFS from goal, backwards along directed edges, writing one distance per vertex; queue is
+// scratch space reused between calls
+void FillDistances(const Graph &graph, int goal, uint16_t *distances, std::vector<int> &queue);
+
+// Scratch space of RepairDistances, reused between calls
+struct DistanceRepair
+{
+    std::vector<int> queue;
+    std::vector<std::pair<uint16_t, int>> frontier; // (distance, vertex)
+    std::vector<int> affected;
+};
+
+// Brings distances to goal up to date after `cell` was blocked or unblocked in the graph, visiting
+// only the cells whose distance changes and their neighbours. Returns the number of changed cells.
+std::size_t RepairDistances(const Graph &graph, int goal, int cell, uint16_t *distances, DistanceRepair &scratch);
+
+// Shortest-path distances from every vertex to one goal, filled by a BFS from the goal.
+// Distances are stored in 16 bits; paths longer than kMaxDistance are clamped to it.
+struct DistanceTable
+{
+    static constexpr uint16_t kUnreachable = 0xFFFF;
+    static constexpr uint16_t kMaxDistance = 0xFFFE;
+
+    int goal;
+    std::vector<uint16_t> distances; // indexed by vertex id
+    uint64_t revision;               // Graph::revision the distances are valid for
+
+    DistanceTable(const Graph &graph, int _goal);
+    std::size_t MemoryUsage() const { return distances.size() * sizeof(uint16_t); }
+};
+
+// Lazily built distance tables shared by every agent heading to the same goal.
+// memory_limit bounds every table the cache has handed out, including those agents still hold:
+// tables nobody else holds are evicted least recently used first to make room, and when the held
+// ones alone fill the limit, Get returns null. Safe to share between planners of the same graph
+// running on different threads. When the graph changes, Repair updates the cached tables in
+// place; Get rebuilds any table left behind the graph's revision.
+class DistanceCache
+{
+public:
+    static constexpr std::size_t kDefaultMemoryLimit = std::size_t(1) << 30;
+
+    explicit DistanceCache(const Graph &_graph, std::size_t _memory_limit = kDefaultMemoryLimit);
+
+    // Null when the tables held elsewhere leave no room for another one
+    std::shared_ptr<const DistanceTable> Get(int goal);
+    // Repairs every cached table after `cell` changed passability; returns the cells changed
+    std::size_t Repair(int cell);
+    void Clear();
+    std::size_t Size() const;
+    std::size_t MemoryUsage() const;
+    const Graph &GetGraph() const { return graph; }
+
+    std::size_t memory_limit;
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t evictions = 0;
+    std::size_t refusals = 0; // Gets that returned null
+
+private:
+    using Entry = std::shared_ptr<DistanceTable>;
+
+    std::list<Entry>::iterator Erase(std::list<Entry>::iterator entry);
+
+    const Graph &graph;
+    std::list<Entry> lru; // most recently used first
+    std::unordered_map<int, std::list<Entry>::iterator> index;
+    std::size_t memory_usage = 0;
+    DistanceRepair repair;
+    mutable std::mutex mutex;
+};
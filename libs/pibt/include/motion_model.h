@@ -0,0 +1,42 @@
+#pragma once
+
+#include <graph.h>
+
+// How agents may move, selected with PibtOptions::motion_model. The planner is instantiated
+// once per policy, so the heading logic compiles to straight-line code for each model.
+enum class MotionModel
+{
+    RotateThenMove, // moves only along the heading's axis; a quarter turn takes PibtOptions::rotation_steps
+    Holonomic       // moves to any neighbour at once; the heading follows the last move
+};
+
+// Differential-drive agents: a move across the heading is replaced by a quarter turn in place,
+// and moves along the axis, forwards or backwards, keep the heading. Roadmap edges without a
+// direction (elevators) are taken in any heading.
+struct RotateThenMoveMotion
+{
+    static constexpr bool kTurns = true;
+
+    // Up/Down and Left/Right differ only in the lowest bit of Direction, None has an axis of its own
+    static unsigned Axis(Direction d) { return (unsigned)d >> 1; }
+
+    // Whether moving in direction `move` first needs a turn
+    static bool MustTurn(Direction heading, Direction move)
+    {
+        return (heading != Direction::None) & (move != Direction::None) & (Axis(heading) != Axis(move));
+    }
+    // Heading after moving in direction `move`; an agent without a heading takes the move's
+    static Direction Heading(Direction heading, Direction move)
+    {
+        return heading == Direction::None ? move : heading;
+    }
+};
+
+// Omnidirectional agents: never turn in place; an edge without a direction keeps the heading
+struct HolonomicMotion
+{
+    static constexpr bool kTurns = false;
+
+    static bool MustTurn(Direction, Direction) { return false; }
+    static Direction Heading(Direction heading, Direction move) { return move == Direction::None ? heading : move; }
+};
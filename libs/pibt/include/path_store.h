@@ -0,0 +1,108 @@
+#pragma once
+
+#include <graph.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// One agent's state at one timestep
+struct PathEntry
+{
+    int32_t vertex;
+    Direction heading;
+};
+
+class PathView;
+
+// Agent states for every recorded timestep, stored as one flat row of vertex ids and one row of
+// headings per timestep (5 bytes per agent-step). Rows are allocated in chunks of chunk_timesteps
+// so the history grows without copying and most timesteps append without allocating.
+// With a history bound the chunks form a ring: only the latest rows, at least history_timesteps
+// of them, are kept and memory stays constant however long the run.
+class PathStore
+{
+public:
+    static constexpr std::size_t kDefaultChunkTimesteps = 64;
+
+    PathStore() = default;
+    PathStore(std::size_t _num_agents, std::size_t _chunk_timesteps = kDefaultChunkTimesteps,
+              std::size_t history_timesteps = 0);
+
+    // history_timesteps of 0 keeps every row
+    void Reset(std::size_t _num_agents, std::size_t _chunk_timesteps = kDefaultChunkTimesteps,
+               std::size_t history_timesteps = 0);
+    void Reserve(std::size_t timesteps);
+    std::size_t AppendRow();
+
+    Span<int32_t> Vertices(std::size_t t);
+    Span<Direction> Headings(std::size_t t);
+    Span<const int32_t> Vertices(std::size_t t) const;
+    Span<const Direction> Headings(std::size_t t) const;
+    PathEntry At(std::size_t t, int agent) const;
+    PathView Path(int agent) const;
+
+    // Rows [FirstTimestep(), NumTimesteps()) are available
+    std::size_t NumTimesteps() const { return num_rows; }
+    std::size_t FirstTimestep() const;
+    std::size_t NumAgents() const { return num_agents; }
+    std::size_t MemoryUsage() const;
+
+private:
+    struct Chunk
+    {
+        std::unique_ptr<int32_t[]> vertices;
+        std::unique_ptr<Direction[]> headings;
+    };
+
+    const Chunk &ChunkFor(std::size_t t) const { return chunks[max_chunks ? (t / chunk_timesteps) % max_chunks : t / chunk_timesteps]; }
+
+    std::size_t num_agents = 0;
+    std::size_t chunk_timesteps = kDefaultChunkTimesteps;
+    std::size_t max_chunks = 0; // ring size with a history bound, 0 without
+    std::size_t chunk_capacity = 0; // entries allocated per chunk, at least chunk_timesteps * num_agents
+    std::size_t num_rows = 0;
+    std::vector<Chunk> chunks;
+};
+
+// Read-only view of one agent's retained path; index 0 is the store's FirstTimestep()
+class PathView
+{
+public:
+    class iterator
+    {
+    public:
+        iterator(const PathView *_view, std::size_t _t) : view(_view), t(_t) {}
+        PathEntry operator*() const { return (*view)[t]; }
+        iterator &operator++()
+        {
+            ++t;
+            return *this;
+        }
+        bool operator!=(const iterator &other) const { return t != other.t; }
+
+    private:
+        const PathView *view;
+        std::size_t t;
+    };
+
+    PathView(const PathStore *_store, int _agent) : store(_store), agent(_agent), first(_store->FirstTimestep()) {}
+
+    std::size_t size() const { return store->NumTimesteps() - first; }
+    bool empty() const { return size() == 0; }
+    PathEntry operator[](std::size_t t) const { return store->At(first + t, agent); }
+    PathEntry front() const { return (*this)[0]; }
+    PathEntry back() const { return (*this)[size() - 1]; }
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, size()); }
+
+private:
+    const PathStore *store;
+    int agent;
+    std::size_t first;
+};
+
+inline PathView PathStore::Path(int agent) const
+{
+    return PathView(this, agent);
+}
@@ -1,52 +1,266 @@
 #pragma once
 
 #include <graph.h>
+#include <chrono>
+#include <memory>
+#include <string>
 #include <vector>
-#include <unordered_map>
+#include "candidate_scoring.h"
+#include "cluster_hierarchy.h"
+#include "distance_store.h"
+#include "distance_table.h"
+#include "motion_model.h"
+#include "path_store.h"
+#include "stats.h"
+#include "thread_pool.h"
 
-// PIBT agent
+class TrajectoryWriter;
+
+// PIBT agent. Agents live contiguously in PIBT::agent_arena with the fields read while
+// planning first; per-agent data used only on goal changes is kept in separate arrays.
 struct Agent
 {
-    int id;
     Vertex *v_now;
     Vertex *v_next;
-    Vertex *start;
     Vertex *goal;
-    float priority;
-    bool reached_goal;
+    const uint16_t *distances = nullptr; // distances to goal, read on every candidate
+    const ClusterHierarchy::GoalTable *goal_table = nullptr; // instead of distances under DistanceHeuristic::Clusters
+    float priority;         // timesteps since last at the goal plus initial_priority
+    float initial_priority; // unique tie-breaker in [0, 1)
+    int id;
     Direction current_direction;
-    std::vector<std::vector<int>> Path;
+    bool reached_goal;
+    uint16_t turn_wait = 0; // timesteps the last turn still holds the agent in place, unless pushed
+    Vertex *start;
 
-    Agent(int _id, Vertex *_vnow, Vertex *_vnext, Vertex *_start, Vertex *_goal, float _priority, bool _reached_goal, Direction _current_direction) : id(_id), v_now(_vnow), v_next(_vnext), start(_start), goal(_goal), priority(_priority), reached_goal(_reached_goal), current_direction(_current_direction)
+    Agent(int _id, Vertex *_vnow, Vertex *_vnext, Vertex *_start, Vertex *_goal, float _priority, bool _reached_goal, Direction _current_direction) : v_now(_vnow), v_next(_vnext), goal(_goal), priority(_priority), initial_priority(_priority), id(_id), current_direction(_current_direction), reached_goal(_reached_goal), start(_start)
     {
-        Path = {{_start->x, _start->y, _start->direction}, {_start->x, _start->y, _start->direction}};
     }
 };
 
 // Alias for a collection of agents
 using Agents = std::vector<Agent *>;
 
+// Move candidate: target vertex and the heading of the edge leading to it
+struct Candidate
+{
+    Vertex *vertex;
+    Direction direction;
+};
+
+// Move imposed on an agent in PIBT::PlanFrom: the state it must have after the timestep
+struct FixedMove
+{
+    int agent;
+    int vertex;
+    Direction heading;
+    // Push the agent on `vertex` instead: if it stays, turning or pushing on in turn, wait in place
+    bool yield = false;
+};
+
+// One level of a priority-inheritance chain in PIBT::PibtAlgorithmIterative
+struct PibtFrame
+{
+    Agent *ai;             // agent being planned
+    Agent *aj;             // agent that pushed it, or null for the chain's root
+    Candidate *candidates; // its slice of the candidate stack
+    uint32_t num_candidates;
+    uint32_t next;         // candidate being tried
+};
+
+// Implementation of the priority-inheritance search used by Step
+enum class PibtEngine
+{
+    Recursive, // PibtAlgorithm: one call per agent in a chain
+    Iterative  // PibtAlgorithmIterative: explicit stack, depth bounded by the agent count only
+};
+
+// Working memory of one planning thread
+struct PlannerWorkspace
+{
+    std::vector<Candidate> candidates; // candidate stack: each frame of a chain takes max_degree + 1 slots
+    std::size_t top = 0;
+    std::vector<PibtFrame> frames;     // explicit stack of PibtAlgorithmIterative, one frame per agent
+    StepStats stats;                   // planning counters of the current Step, with PIBT_ENABLE_STATS
+    std::size_t depth = 0;
+    // Budget of the current Step, see PibtOptions::step_budget_seconds; max() when unlimited
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    uint32_t clock_countdown = 1; // deadline checks left before the clock is read again
+    bool out_of_time = false;
+};
+
+// Source of the distances that order each agent's moves
+enum class DistanceHeuristic
+{
+    Tables,  // exact table per goal, 2 bytes per cell
+    Clusters // ClusterHierarchy: near-exact, per goal a fraction of a table, for very large maps
+};
+
+// Planner settings
+struct PibtOptions
+{
+    // Ceiling in bytes for the exact distance tables in use, whether cached or held by agents. Once
+    // it is reached, further goals get cluster goal tables (on grids; roadmaps throw instead). Also
+    // the cache size for cluster goal tables, which agents keep alive beyond it while they use them.
+    std::size_t distance_cache_bytes = DistanceCache::kDefaultMemoryLimit;
+    DistanceHeuristic heuristic = DistanceHeuristic::Tables;
+    // Side of a ClusterHierarchy cluster, a power of two
+    int cluster_size = 32;
+    // Precomputed distance store to map at construction (see BuildDistanceStore); goals it
+    // does not cover fall back to the cache
+    std::string distance_store_path;
+    // Record every agent's path in `paths`, growing it by this many timesteps at a time
+    bool record_paths = true;
+    std::size_t path_chunk_timesteps = PathStore::kDefaultChunkTimesteps;
+    // Keep only the latest this many timesteps in `paths` (0 keeps all), e.g. when streaming
+    // the run to a TrajectoryWriter instead
+    std::size_t path_history_timesteps = 0;
+    // Seed for the initial priority shuffle; negative draws one from std::random_device
+    long long seed = -1;
+    // Both engines make the same decisions; the iterative one cannot overflow the call stack
+    PibtEngine engine = PibtEngine::Iterative;
+    // Planning threads, 0 for one per hardware thread. Above one, each Step splits the agents into
+    // clusters that cannot interact and plans them concurrently, with the same result as one thread.
+    std::size_t num_threads = 1;
+    // Movement constraints; see MotionModel
+    MotionModel motion_model = MotionModel::RotateThenMove;
+    // Timesteps a quarter turn takes under MotionModel::RotateThenMove
+    int rotation_steps = 1;
+    // RunPibt gives up after this many timesteps; 0 allows agents * max(width, height) * 10
+    int max_timesteps = 0;
+    // Wall-clock budget of one Step in seconds, 0 for none. Agents not yet planned when it runs
+    // out, including a priority-inheritance chain cut short, wait in place for that timestep.
+    double step_budget_seconds = 0.0;
+};
+
 // PIBT class
 class PIBT
 {
 public:
     PIBT(int w, int h,
          const std::vector<std::vector<int>> &starts,
-         const std::vector<std::vector<int>> &goals);
-    ~PIBT();
+         const std::vector<std::vector<int>> &goals,
+         const PibtOptions &_options = PibtOptions());
+    PIBT(Graph _graph,
+         const std::vector<std::vector<int>> &starts,
+         const std::vector<std::vector<int>> &goals,
+         const PibtOptions &_options = PibtOptions());
+    // Shares a read-only graph, and optionally a distance cache or cluster hierarchy built for it,
+    // with other planners
+    PIBT(std::shared_ptr<Graph> _graph,
+         const std::vector<std::vector<int>> &starts,
+         const std::vector<std::vector<int>> &goals,
+         const PibtOptions &_options = PibtOptions(),
+         std::shared_ptr<DistanceCache> _distance_cache = nullptr,
+         std::shared_ptr<ClusterHierarchy> _hierarchy = nullptr);
+    // Same from flat arrays, one entry per agent: start and goal vertex ids and start headings
+    // (Direction values)
+    PIBT(std::shared_ptr<Graph> _graph,
+         Span<const int32_t> start_vertices,
+         Span<const int32_t> goal_vertices,
+         Span<const int32_t> headings,
+         const PibtOptions &_options = PibtOptions(),
+         std::shared_ptr<DistanceCache> _distance_cache = nullptr,
+         std::shared_ptr<ClusterHierarchy> _hierarchy = nullptr);
 
+    void Reset(Span<const int32_t> start_vertices, Span<const int32_t> goal_vertices, Span<const int32_t> headings, long long seed);
     int HeuristicDistance(const Vertex *start, const Vertex *goal);
+    void AssignDistances(Agent *agent);
+    // Distance from v to the agent's goal under the configured heuristic
+    uint16_t Distance(const Agent *agent, const Vertex *v) const
+    {
+        return agent->distances ? agent->distances[v->id] : hierarchy->Distance(*agent->goal_table, v->id);
+    }
     Agent * FindConflictingAgent(const Vertex *v, const Agent *agent);
     bool AllReached();
     void SortAgentsById();
     void RunPibt();
-    bool PibtAlgorithm(Agent *ai, Agent *aj = nullptr);
+    void Step();
+    void SetGoal(int agent_id, int x, int y);
+    bool SetBlocked(int x, int y, bool blocked);
+    void SyncWithGraph();
+    // The planning routines are instantiated per motion policy (RotateThenMoveMotion, HolonomicMotion);
+    // PlanAgent picks the one matching options.motion_model
+    template <typename Motion>
+    bool PibtAlgorithm(PlannerWorkspace &ws, Agent *ai, Agent *aj = nullptr);
+    template <typename Motion>
+    bool PibtAlgorithmIterative(PlannerWorkspace &ws, Agent *ai);
+    template <typename Motion>
+    void PlanAgent(PlannerWorkspace &ws, Agent *agent);
+    void PlanAgent(PlannerWorkspace &ws, Agent *agent);
+    bool OutOfTime(PlannerWorkspace &ws);
+    void ScoreCandidates(std::size_t begin, std::size_t end);
+    void ScoreAllCandidates();
+    template <typename Motion>
+    std::size_t PushCandidates(PlannerWorkspace &ws, Agent *ai, const Agent *aj);
+    bool CanClaim(const Agent *ai, const Agent *aj, const Vertex *u, Agent *&occupant) const;
+    template <typename Motion>
+    void CommitMove(Agent *ai, const Candidate &candidate, bool inherited);
+    void SetNext(Agent *agent, Vertex *v);
+    bool PlanFrom(Span<const int32_t> vertices, Span<const Direction> headings, Span<const int> order,
+                  Span<const FixedMove> fixed, Span<int32_t> next_vertices, Span<Direction> next_headings,
+                  Span<int32_t> roots = Span<int32_t>());
+    void RecordTimestep();
+    void StreamTo(TrajectoryWriter *writer);
+    void BuildClusters();
+    int FindCluster(int agent_id);
+    void PlanCluster(std::size_t cluster, std::size_t worker);
+    PathView GetPath(int agent_id) const { return paths.Path(agent_id); }
+    std::size_t SumOfCosts() const;
+    std::size_t MemoryUsage() const;
     void PrintAgents();
-    
+    Agent *GetAgent(int agent_id) { return &agent_arena[agent_id]; }
+
     int timesteps = 0;
     bool failed = false;
-    Agents agents;
-    Graph graph;
-    std::unordered_map<Vertex *, Agent *> occupied_now;
-    std::unordered_map<Vertex *, Agent *> occupied_next;
+    std::size_t tasks_completed = 0; // goal arrivals since construction
+    PibtOptions options;
+    std::vector<Agent> agent_arena; // indexed by agent id; never resized after construction
+    Agents agents;                  // in planning order, highest priority first after each Step
+    Agents arrived;                 // agents that reached their goal during the last Step
+    std::size_t num_travelling = 0; // agents with reached_goal unset
+    bool degraded = false;          // the last Step ran out of its budget, see PibtOptions::step_budget_seconds
+    std::size_t fallback_waits = 0; // agents the last Step left waiting for lack of time
+    std::size_t degraded_steps = 0; // Steps since construction that ran out of their budget
+    std::shared_ptr<Graph> shared_graph;
+    Graph &graph;
+    std::shared_ptr<DistanceCache> shared_distance_cache;
+    DistanceCache &distance_cache;
+    std::vector<std::shared_ptr<const DistanceTable>> distance_tables; // indexed by agent id, null when served by the store
+    std::unique_ptr<DistanceStore> distance_store;
+    std::shared_ptr<ClusterHierarchy> hierarchy; // null unless options.heuristic is Clusters
+    std::vector<std::shared_ptr<const ClusterHierarchy::GoalTable>> goal_tables; // indexed by agent id
+    uint64_t graph_revision = 0; // Graph::revision the agents' distances and orderings are valid for
+    std::vector<Agent *> occupied_now;  // indexed by vertex id: agent at the vertex this timestep
+    std::vector<Agent *> occupied_next; // indexed by vertex id: agent planned onto the vertex next timestep
+    PathStore paths;                    // one row of agent states per timestep, indexed by agent id
+    TrajectoryWriter *trajectory = nullptr; // receives every recorded row, see StreamTo
+
+    // Move orderings from v_now, computed for all agents before each planning phase when the
+    // graph's degree allows (see candidate_scoring.h); otherwise PushCandidates sorts per agent
+    bool batched_candidates = false;
+    std::vector<uint32_t> candidate_keys;   // slot-major scratch of ScoreCandidates
+    std::vector<uint32_t> candidate_orders; // indexed by agent id, packed best-first slots
+
+    // One workspace per planning thread; index 0 serves single-threaded planning
+    std::vector<PlannerWorkspace> workspaces;
+    std::unique_ptr<ThreadPool> thread_pool; // null when planning on one thread
+
+    // Clusters of the current Step: agents closer than three edges share one. Members are listed
+    // in planning order, cluster c owning cluster_members[cluster_offsets[c], cluster_offsets[c + 1]).
+    std::vector<int> cluster_parent; // union-find forest over agent ids
+    std::vector<int> cluster_of;     // cluster index by agent id
+    std::vector<std::size_t> cluster_offsets;
+    Agents cluster_members;
+    std::size_t num_clusters = 0;
+
+    // Step keeps `agents` ordered incrementally; a full sort is needed only after the order is
+    // disturbed (construction, SortAgentsById)
+    bool order_valid = false;
+    Agents departed_scratch, settled_scratch, arrived_scratch;
+    std::vector<float> priority_scratch; // initial priorities drawn by Reset
+
+    // Filled only when built with PIBT_ENABLE_STATS
+    StepStats stats;                     // counters of the last Step
+    std::vector<StepStats> stats_history; // one entry per Step
 };
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+// Hot-path instrumentation. Configure with -DPIBT_ENABLE_STATS=ON to compile the counters in;
+// otherwise PIBT_STAT expands to nothing and the planner's hot path is unchanged.
+#ifdef PIBT_ENABLE_STATS
+#define PIBT_STAT(...) __VA_ARGS__
+constexpr bool kPibtStatsEnabled = true;
+#else
+#define PIBT_STAT(...)
+constexpr bool kPibtStatsEnabled = false;
+#endif
+
+// Counters for one PIBT timestep
+struct StepStats
+{
+    int timestep = 0;
+    std::size_t calls = 0;          // PibtAlgorithm invocations, including inherited ones
+    std::size_t max_depth = 0;      // deepest PibtAlgorithm recursion
+    std::size_t chains = 0;         // top-level calls, one priority-inheritance chain each
+    std::size_t chain_agents = 0;   // agents planned across all chains (sum of chain lengths)
+    std::size_t max_chain = 0;      // agents planned by the longest chain
+    std::size_t candidates = 0;     // candidate vertices evaluated
+    std::size_t backtracks = 0;     // candidates abandoned because the pushed agent found no move
+    std::size_t waits = 0;          // agents away from their goal planned to stay in place
+    double update_seconds = 0.0;    // executing moves and updating priorities
+    double sort_seconds = 0.0;      // ordering agents by priority
+    double plan_seconds = 0.0;      // PibtAlgorithm calls
+};
+
+// Adds the planning counters of one worker's share of a timestep to the timestep's totals
+void AccumulatePlanningStats(StepStats &total, const StepStats &part);
+
+void WriteStatsCsv(std::ostream &out, const std::vector<StepStats> &history);
+void WriteStatsJson(std::ostream &out, const std::vector<StepStats> &history);
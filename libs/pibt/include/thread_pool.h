@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. Each ParallelFor splits the index range
+// into one contiguous slice per worker; a worker that runs out of its own slice steals indices
+// from the far end of the others', so uneven tasks still balance.
+class ThreadPool
+{
+public:
+    // num_threads counts the calling thread, which works as worker 0; 0 uses every hardware thread
+    explicit ThreadPool(std::size_t num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    std::size_t Size() const { return num_workers; }
+
+    // Calls task(index, worker) once for every index in [0, count) and returns when all are done
+    void ParallelFor(std::size_t count, const std::function<void(std::size_t, std::size_t)> &task);
+
+private:
+    // Unclaimed indices of one worker's slice: low 32 bits next, high 32 bits end
+    struct alignas(64) Slice
+    {
+        std::atomic<uint64_t> bounds{0};
+    };
+
+    bool TakeOwn(std::size_t worker, std::size_t &index);
+    bool Steal(std::size_t victim, std::size_t &index);
+    void Run(std::size_t worker);
+    void WorkerLoop(std::size_t worker);
+
+    std::size_t num_workers;
+    std::unique_ptr<Slice[]> slices;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(std::size_t, std::size_t)> *task = nullptr;
+    std::size_t generation = 0;
+    std::size_t running = 0;
+    bool stopping = false;
+};
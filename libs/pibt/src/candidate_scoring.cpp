@@ -0,0 +1,79 @@
+#include "candidate_scoring.h"
+
+#include <algorithm>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Optimal sorting network for five keys (Knuth, TAOCP 5.3.4): nine compare-exchanges
+    constexpr int kNetwork[9][2] = {{0, 1}, {3, 4}, {2, 4}, {2, 3}, {0, 3}, {0, 2}, {1, 4}, {1, 3}, {1, 2}};
+
+    void SortLanes(uint32_t *keys, std::size_t stride, std::size_t begin, std::size_t end, uint32_t *orders)
+    {
+        uint32_t *k[kScoredCandidates];
+        for (std::size_t s = 0; s < kScoredCandidates; ++s)
+            k[s] = keys + s * stride;
+
+        for (const auto &comparator : kNetwork)
+        {
+            uint32_t *a = k[comparator[0]];
+            uint32_t *b = k[comparator[1]];
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                const uint32_t lo = std::min(a[i], b[i]);
+                const uint32_t hi = std::max(a[i], b[i]);
+                a[i] = lo;
+                b[i] = hi;
+            }
+        }
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            uint32_t order = kOrderEnd;
+            for (std::size_t s = kScoredCandidates; s-- > 0;)
+                order = order << 3 | (k[s][i] & 7);
+            orders[i] = order;
+        }
+    }
+
+#ifdef __AVX2__
+    // Same as SortLanes, eight lanes per iteration; returns the first lane left for SortLanes
+    std::size_t SortLanesAvx2(uint32_t *keys, std::size_t stride, std::size_t begin, std::size_t end, uint32_t *orders)
+    {
+        const __m256i slot_mask = _mm256_set1_epi32(7);
+        std::size_t i = begin;
+        for (; i + 8 <= end; i += 8)
+        {
+            __m256i k[kScoredCandidates];
+            for (std::size_t s = 0; s < kScoredCandidates; ++s)
+                k[s] = _mm256_loadu_si256((const __m256i *)(keys + s * stride + i));
+
+            for (const auto &comparator : kNetwork)
+            {
+                const __m256i lo = _mm256_min_epu32(k[comparator[0]], k[comparator[1]]);
+                k[comparator[1]] = _mm256_max_epu32(k[comparator[0]], k[comparator[1]]);
+                k[comparator[0]] = lo;
+            }
+
+            for (std::size_t s = 0; s < kScoredCandidates; ++s)
+                _mm256_storeu_si256((__m256i *)(keys + s * stride + i), k[s]);
+
+            __m256i order = slot_mask;
+            for (std::size_t s = kScoredCandidates; s-- > 0;)
+                order = _mm256_or_si256(_mm256_slli_epi32(order, 3), _mm256_and_si256(k[s], slot_mask));
+            _mm256_storeu_si256((__m256i *)(orders + i), order);
+        }
+        return i;
+    }
+#endif
+}
+
+void SortCandidates(uint32_t *keys, std::size_t stride, std::size_t begin, std::size_t end, uint32_t *orders)
+{
+#ifdef __AVX2__
+    begin = SortLanesAvx2(keys, stride, begin, end, orders);
+#endif
+    SortLanes(keys, stride, begin, end, orders);
+}
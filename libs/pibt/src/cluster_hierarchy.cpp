@@ -0,0 +1,317 @@
+#include "cluster_hierarchy.h"
+
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+namespace
+{
+    // Entrances at least this long get a portal pair at each end instead of one in the middle
+    constexpr int kLongEntrance = 6;
+}
+
+ClusterHierarchy::ClusterHierarchy(const Graph &_graph, int cluster_size, std::size_t _memory_limit)
+    : memory_limit(_memory_limit),
+      graph(_graph),
+      size(cluster_size),
+      revision(_graph.revision)
+{
+    if (!graph.grid)
+    {
+        throw std::invalid_argument("The cluster hierarchy needs a grid graph.");
+    }
+    if (cluster_size < 2 || (cluster_size & (cluster_size - 1)) != 0)
+    {
+        throw std::invalid_argument("cluster_size must be a power of two of at least 2.");
+    }
+    shift = 0;
+    while ((1 << shift) < size)
+        ++shift;
+    mask = size - 1;
+    window = 3 * size;
+    clusters_x = (graph.width + mask) >> shift;
+    clusters_y = (graph.height + mask) >> shift;
+
+    // Borders between horizontal neighbours, then between vertical ones
+    for (int cy = 0; cy < clusters_y; ++cy)
+    {
+        for (int cx = 0; cx + 1 < clusters_x; ++cx)
+        {
+            const int x = ((cx + 1) << shift) - 1, y = cy << shift;
+            AddEntrances(graph.GetId(x, y), graph.GetId(x + 1, y), graph.width, std::min(size, graph.height - y));
+        }
+    }
+    for (int cy = 0; cy + 1 < clusters_y; ++cy)
+    {
+        for (int cx = 0; cx < clusters_x; ++cx)
+        {
+            const int x = cx << shift, y = ((cy + 1) << shift) - 1;
+            AddEntrances(graph.GetId(x, y), graph.GetId(x, y + 1), 1, std::min(size, graph.width - x));
+        }
+    }
+
+    // Group the portals by cluster
+    const int num_clusters = clusters_x * clusters_y;
+    cluster_offsets.assign(num_clusters + 1, 0);
+    std::vector<int> portal_cluster(portal_cells.size());
+    for (std::size_t p = 0; p < portal_cells.size(); ++p)
+    {
+        const Vertex &v = graph.vertices[portal_cells[p]];
+        portal_cluster[p] = ClusterOf(v.x, v.y);
+        ++cluster_offsets[portal_cluster[p] + 1];
+    }
+    for (int c = 0; c < num_clusters; ++c)
+        cluster_offsets[c + 1] += cluster_offsets[c];
+    cluster_portals.resize(portal_cells.size());
+    std::vector<int> fill(cluster_offsets.begin(), cluster_offsets.end() - 1);
+    for (std::size_t p = 0; p < portal_cells.size(); ++p)
+        cluster_portals[fill[portal_cluster[p]]++] = (int)p;
+
+    cell_offsets.resize(num_clusters);
+    std::size_t rows = 0;
+    for (int c = 0; c < num_clusters; ++c)
+    {
+        cell_offsets[c] = rows;
+        rows += (std::size_t)size * size * (cluster_offsets[c + 1] - cluster_offsets[c]);
+    }
+    portal_distances.assign(rows, DistanceTable::kUnreachable);
+    for (int c = 0; c < num_clusters; ++c)
+        FillClusterDistances(c);
+
+    // Abstract graph: portals of one cluster joined by their in-cluster distance, portals facing
+    // each other across an entrance by one step
+    std::vector<std::vector<std::pair<int, uint16_t>>> adjacency(portal_cells.size());
+    for (int c = 0; c < num_clusters; ++c)
+    {
+        const int first = cluster_offsets[c], count = cluster_offsets[c + 1] - first;
+        for (int k = 0; k < count; ++k)
+        {
+            for (int m = 0; m < count; ++m)
+            {
+                const Vertex &target = graph.vertices[portal_cells[cluster_portals[first + m]]];
+                const uint16_t d = portal_distances[cell_offsets[c] + (std::size_t)LocalIndex(target.x, target.y) * count + k];
+                if (k != m && d != DistanceTable::kUnreachable)
+                    adjacency[cluster_portals[first + k]].push_back({cluster_portals[first + m], d});
+            }
+        }
+    }
+    for (const auto &crossing : crossings)
+    {
+        adjacency[crossing.first].push_back({crossing.second, 1});
+        adjacency[crossing.second].push_back({crossing.first, 1});
+    }
+    edge_offsets.assign(1, 0);
+    for (const auto &row : adjacency)
+    {
+        edges.insert(edges.end(), row.begin(), row.end());
+        edge_offsets.push_back((int)edges.size());
+    }
+
+    std::unordered_map<int, int>().swap(portal_of_cell);
+    std::vector<std::pair<int, int>>().swap(crossings);
+}
+
+// Splits one cluster border, cells a_first + i * step facing b_first + i * step, into entrances
+void ClusterHierarchy::AddEntrances(int a_first, int b_first, int step, int length)
+{
+    int run = 0;
+    for (int i = 0; i <= length; ++i)
+    {
+        if (i < length && !graph.IsBlocked(a_first + i * step) && !graph.IsBlocked(b_first + i * step))
+        {
+            ++run;
+            continue;
+        }
+        if (run == 0)
+            continue;
+
+        auto cross = [&](int j)
+        {
+            crossings.push_back({AddPortal(a_first + j * step), AddPortal(b_first + j * step)});
+        };
+        if (run < kLongEntrance)
+        {
+            cross(i - run + run / 2);
+        }
+        else
+        {
+            cross(i - run);
+            cross(i - 1);
+        }
+        run = 0;
+    }
+}
+
+int ClusterHierarchy::AddPortal(int cell)
+{
+    auto inserted = portal_of_cell.emplace(cell, (int)portal_cells.size());
+    if (inserted.second)
+        portal_cells.push_back(cell);
+    return inserted.first->second;
+}
+
+// BFS from each portal of the cluster, restricted to the cluster's cells
+void ClusterHierarchy::FillClusterDistances(int cluster)
+{
+    const int first = cluster_offsets[cluster], count = cluster_offsets[cluster + 1] - first;
+    uint16_t *rows = portal_distances.data() + cell_offsets[cluster];
+    std::vector<int> queue;
+    for (int k = 0; k < count; ++k)
+    {
+        const int source = portal_cells[cluster_portals[first + k]];
+        auto at = [&](int v) -> uint16_t &
+        {
+            const Vertex &vertex = graph.vertices[v];
+            return rows[(std::size_t)LocalIndex(vertex.x, vertex.y) * count + k];
+        };
+
+        queue.assign(1, source);
+        at(source) = 0;
+        for (std::size_t head = 0; head < queue.size(); ++head)
+        {
+            const int v = queue[head];
+            const uint16_t d = at(v) + 1;
+            for (const Neighbor &n : graph.GetNeighbors(v))
+            {
+                const Vertex &u = graph.vertices[n.id];
+                if (ClusterOf(u.x, u.y) == cluster && at(n.id) == DistanceTable::kUnreachable)
+                {
+                    at(n.id) = d;
+                    queue.push_back(n.id);
+                }
+            }
+        }
+    }
+}
+
+// Exact distances inside the window around the goal, then Dijkstra over the portals seeded with
+// those of the window's portals
+std::shared_ptr<ClusterHierarchy::GoalTable> ClusterHierarchy::Build(int goal) const
+{
+    auto table = std::make_shared<GoalTable>();
+    const Vertex &g = graph.vertices[goal];
+    table->goal = goal;
+    table->window_x = ((g.x >> shift) - 1) << shift;
+    table->window_y = ((g.y >> shift) - 1) << shift;
+    table->local.assign((std::size_t)window * window, DistanceTable::kUnreachable);
+    auto local = [&](const Vertex &v) -> uint16_t *
+    {
+        const unsigned wx = (unsigned)(v.x - table->window_x), wy = (unsigned)(v.y - table->window_y);
+        return wx < (unsigned)window && wy < (unsigned)window ? &table->local[wy * window + wx] : nullptr;
+    };
+
+    std::vector<int> queue(1, goal);
+    *local(g) = 0;
+    for (std::size_t head = 0; head < queue.size(); ++head)
+    {
+        const uint16_t d = *local(graph.vertices[queue[head]]) + 1;
+        for (const Neighbor &n : graph.GetNeighbors(queue[head]))
+        {
+            uint16_t *du = local(graph.vertices[n.id]);
+            if (du && *du == DistanceTable::kUnreachable)
+            {
+                *du = d;
+                queue.push_back(n.id);
+            }
+        }
+    }
+
+    using Item = std::pair<uint32_t, int>;
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> open;
+    std::vector<uint32_t> distances(portal_cells.size(), UINT32_MAX);
+    for (int cy = (g.y >> shift) - 1; cy <= (g.y >> shift) + 1; ++cy)
+    {
+        for (int cx = (g.x >> shift) - 1; cx <= (g.x >> shift) + 1; ++cx)
+        {
+            if (cx < 0 || cy < 0 || cx >= clusters_x || cy >= clusters_y)
+                continue;
+            const int cluster = cy * clusters_x + cx;
+            for (int i = cluster_offsets[cluster]; i < cluster_offsets[cluster + 1]; ++i)
+            {
+                const uint16_t d = *local(graph.vertices[portal_cells[cluster_portals[i]]]);
+                if (d != DistanceTable::kUnreachable)
+                {
+                    distances[cluster_portals[i]] = d;
+                    open.push({d, cluster_portals[i]});
+                }
+            }
+        }
+    }
+    while (!open.empty())
+    {
+        const Item top = open.top();
+        open.pop();
+        if (top.first != distances[top.second])
+            continue;
+        for (int e = edge_offsets[top.second]; e < edge_offsets[top.second + 1]; ++e)
+        {
+            const uint32_t d = top.first + edges[e].second;
+            if (d < distances[edges[e].first])
+            {
+                distances[edges[e].first] = d;
+                open.push({d, edges[e].first});
+            }
+        }
+    }
+
+    table->portal_distances.resize(portal_cells.size());
+    for (std::size_t p = 0; p < portal_cells.size(); ++p)
+    {
+        table->portal_distances[p] = distances[p] == UINT32_MAX ? DistanceTable::kUnreachable
+                                                                : (uint16_t)std::min<uint32_t>(distances[p], DistanceTable::kMaxDistance);
+    }
+    return table;
+}
+
+std::shared_ptr<const ClusterHierarchy::GoalTable> ClusterHierarchy::Get(int goal)
+{
+    if (graph.revision != revision)
+    {
+        throw std::logic_error("The graph changed since the cluster hierarchy was built.");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = index.find(goal);
+        if (found != index.end())
+        {
+            ++hits;
+            lru.splice(lru.begin(), lru, found->second);
+            return *found->second;
+        }
+        ++misses;
+    }
+
+    // Build unlocked; if another thread built the same table meanwhile, keep theirs
+    Entry table = Build(goal);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = index.find(goal);
+    if (found != index.end())
+    {
+        lru.splice(lru.begin(), lru, found->second);
+        return *found->second;
+    }
+    lru.push_front(table);
+    index[goal] = lru.begin();
+    cache_usage += table->MemoryUsage();
+
+    while (cache_usage > memory_limit && lru.size() > 1)
+    {
+        cache_usage -= lru.back()->MemoryUsage();
+        index.erase(lru.back()->goal);
+        lru.pop_back();
+        ++evictions;
+    }
+    return table;
+}
+
+std::size_t ClusterHierarchy::MemoryUsage() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return (portal_cells.capacity() + cluster_offsets.capacity() + cluster_portals.capacity() + edge_offsets.capacity()) * sizeof(int) +
+           cell_offsets.capacity() * sizeof(std::size_t) +
+           portal_distances.capacity() * sizeof(uint16_t) +
+           edges.capacity() * sizeof(edges[0]) +
+           cache_usage;
+}
@@ -0,0 +1,151 @@
+#include "distance_store.h"
+#include "distance_table.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+constexpr char DistanceStore::kMagic[8];
+
+namespace
+{
+    std::size_t TablesOffset(std::size_t num_goals)
+    {
+        std::size_t offset = sizeof(DistanceStoreHeader) + num_goals * sizeof(int32_t);
+        return (offset + 7) & ~std::size_t(7);
+    }
+}
+
+DistanceStore::DistanceStore(const std::string &path, const Graph &graph)
+    : file(new MappedFile(path, false))
+{
+    if (file->size() < sizeof(DistanceStoreHeader))
+    {
+        throw std::runtime_error("Distance store is truncated: " + path);
+    }
+
+    DistanceStoreHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0)
+    {
+        throw std::runtime_error("Not a distance store: " + path);
+    }
+    if (header.version != kVersion)
+    {
+        throw std::runtime_error("Distance store has unsupported version " + std::to_string(header.version) + ": " + path);
+    }
+    if (header.graph_hash != graph.Hash() || header.num_vertices != graph.Size())
+    {
+        throw std::runtime_error("Distance store was built for a different map: " + path);
+    }
+
+    num_goals = header.num_goals;
+    num_vertices = header.num_vertices;
+    if (file->size() < TablesOffset(num_goals) + num_goals * num_vertices * sizeof(uint16_t))
+    {
+        throw std::runtime_error("Distance store is truncated: " + path);
+    }
+
+    goals = reinterpret_cast<const int32_t *>(file->data() + sizeof(DistanceStoreHeader));
+    tables = reinterpret_cast<const uint16_t *>(file->data() + TablesOffset(num_goals));
+}
+
+const uint16_t *DistanceStore::Find(int goal) const
+{
+    const int32_t *found = std::lower_bound(goals, goals + num_goals, goal);
+    if (found == goals + num_goals || *found != goal)
+        return nullptr;
+    return tables + (std::size_t)(found - goals) * num_vertices;
+}
+
+void BuildDistanceStore(const Graph &graph, std::vector<int> goals, const std::string &path, int num_threads)
+{
+    if (goals.empty())
+    {
+        for (const Vertex &v : graph.vertices)
+        {
+            if (!graph.IsBlocked(v.id))
+                goals.push_back(v.id);
+        }
+    }
+    std::sort(goals.begin(), goals.end());
+    goals.erase(std::unique(goals.begin(), goals.end()), goals.end());
+    for (int goal : goals)
+    {
+        if (goal < 0 || goal >= (int)graph.Size())
+            throw std::invalid_argument("Goal vertex " + std::to_string(goal) + " is not in the graph.");
+    }
+
+    const std::size_t num_vertices = graph.Size();
+    const std::size_t tables_offset = TablesOffset(goals.size());
+    const std::size_t size = tables_offset + goals.size() * num_vertices * sizeof(uint16_t);
+
+    // Write to a temporary file and rename it into place so readers never map a partial store
+    const std::string temp_path = path + ".tmp";
+    int fd = open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Cannot create distance store: " + temp_path);
+    }
+    if (ftruncate(fd, (off_t)size) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Cannot size distance store: " + temp_path);
+    }
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("Cannot map distance store: " + temp_path);
+    }
+    char *data = static_cast<char *>(mapping);
+
+    DistanceStoreHeader header = {};
+    std::memcpy(header.magic, DistanceStore::kMagic, sizeof(header.magic));
+    header.version = DistanceStore::kVersion;
+    header.graph_hash = graph.Hash();
+    header.num_vertices = num_vertices;
+    header.num_goals = goals.size();
+    std::memcpy(data, &header, sizeof(header));
+    for (std::size_t i = 0; i < goals.size(); ++i)
+    {
+        int32_t goal = goals[i];
+        std::memcpy(data + sizeof(header) + i * sizeof(int32_t), &goal, sizeof(goal));
+    }
+
+    // Workers claim goals from a shared counter and fill their rows in place
+    if (num_threads <= 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::min<int>(num_threads, std::max<std::size_t>(goals.size(), 1));
+
+    uint16_t *tables = reinterpret_cast<uint16_t *>(data + tables_offset);
+    std::atomic<std::size_t> next_goal(0);
+    auto worker = [&]()
+    {
+        std::vector<int> queue;
+        for (std::size_t i = next_goal++; i < goals.size(); i = next_goal++)
+        {
+            FillDistances(graph, goals[i], tables + i * num_vertices, queue);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread &thread : threads)
+        thread.join();
+
+    munmap(mapping, size);
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temp_path.c_str());
+        throw std::runtime_error("Cannot move distance store into place: " + path);
+    }
+}
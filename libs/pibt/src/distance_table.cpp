@@ -0,0 +1,288 @@
+#include "distance_table.h"
+
+#include <algorithm>
+
+void FillDistances(const Graph &graph, int goal, uint16_t *distances, std::vector<int> &queue)
+{
+    std::fill(distances, distances + graph.Size(), DistanceTable::kUnreachable);
+
+    // Each vertex is queued at most once, so a flat array serves as the BFS queue
+    queue.resize(graph.Size());
+    std::size_t head = 0, tail = 0;
+
+    distances[goal] = 0;
+    queue[tail++] = goal;
+    while (head < tail)
+    {
+        const int v = queue[head++];
+        const uint16_t d = distances[v] == DistanceTable::kMaxDistance ? DistanceTable::kMaxDistance : distances[v] + 1;
+        for (const Neighbor &n : graph.GetPredecessors(v))
+        {
+            if (distances[n.id] == DistanceTable::kUnreachable)
+            {
+                distances[n.id] = d;
+                queue[tail++] = n.id;
+            }
+        }
+    }
+}
+
+namespace
+{
+    uint16_t NextDistance(uint16_t d)
+    {
+        return d == DistanceTable::kMaxDistance ? DistanceTable::kMaxDistance : d + 1;
+    }
+
+    // Lowers distances outward from the queued vertices in BFS order; the queue holds vertices
+    // whose distance just dropped, in nondecreasing distance
+    std::size_t PropagateDecrease(const Graph &graph, uint16_t *distances, std::vector<int> &queue, std::size_t head)
+    {
+        std::size_t changed = 0;
+        while (head < queue.size())
+        {
+            const int v = queue[head++];
+            const uint16_t d = NextDistance(distances[v]);
+            for (const Neighbor &n : graph.GetPredecessors(v))
+            {
+                if (distances[n.id] > d)
+                {
+                    distances[n.id] = d;
+                    queue.push_back(n.id);
+                    ++changed;
+                }
+            }
+        }
+        return changed;
+    }
+}
+
+// Unblocking can only shorten distances: the cell takes its best neighbour's distance plus one
+// and improvements spread from there. Blocking can only lengthen them: a cell is affected when
+// every neighbour one step closer to the goal was the blocked cell or is itself affected.
+// Checking layer by layer outward from the blocked cell finds exactly those, which are then
+// re-seeded from their unaffected neighbours and settled in distance order.
+std::size_t RepairDistances(const Graph &graph, int goal, int cell, uint16_t *distances, DistanceRepair &scratch)
+{
+    constexpr uint16_t kUnreachable = DistanceTable::kUnreachable;
+    if (cell == goal)
+    {
+        FillDistances(graph, goal, distances, scratch.queue);
+        return graph.Size();
+    }
+
+    std::vector<int> &queue = scratch.queue;
+    queue.clear();
+    if (!graph.IsBlocked(cell))
+    {
+        uint16_t best = kUnreachable;
+        for (const Neighbor &n : graph.GetNeighbors(cell))
+        {
+            if (distances[n.id] != kUnreachable)
+                best = std::min(best, NextDistance(distances[n.id]));
+        }
+        if (best == kUnreachable)
+            return 0;
+        distances[cell] = best;
+        queue.push_back(cell);
+        return 1 + PropagateDecrease(graph, distances, queue, 0);
+    }
+
+    const uint16_t old = distances[cell];
+    distances[cell] = kUnreachable;
+    if (old == kUnreachable)
+        return 0;
+
+    // The blocked cell has no edges left; its former neighbours are the free cells around it
+    std::vector<std::pair<uint16_t, int>> &frontier = scratch.frontier;
+    frontier.clear();
+    const int x = cell % graph.width, y = cell / graph.width;
+    const int around[4] = {graph.GetId(x, y - 1), graph.GetId(x, y + 1), graph.GetId(x - 1, y), graph.GetId(x + 1, y)};
+    for (int u : around)
+    {
+        if (u >= 0 && distances[u] == old + 1)
+            frontier.push_back({distances[u], u});
+    }
+
+    std::vector<int> &affected = scratch.affected;
+    affected.clear();
+    for (std::size_t head = 0; head < frontier.size(); ++head)
+    {
+        const uint16_t d = frontier[head].first;
+        const int v = frontier[head].second;
+        if (distances[v] != d)
+            continue; // queued twice and already affected
+
+        bool supported = false;
+        for (const Neighbor &n : graph.GetNeighbors(v))
+            supported |= distances[n.id] + 1 == d;
+        if (supported)
+            continue;
+
+        distances[v] = kUnreachable;
+        affected.push_back(v);
+        for (const Neighbor &n : graph.GetPredecessors(v))
+        {
+            if (distances[n.id] == d + 1)
+                frontier.push_back({distances[n.id], n.id});
+        }
+    }
+
+    // Re-seed the affected cells from the rest, then settle them in distance order by merging the
+    // sorted seeds into a BFS queue
+    frontier.clear();
+    for (int v : affected)
+    {
+        uint16_t best = kUnreachable;
+        for (const Neighbor &n : graph.GetNeighbors(v))
+        {
+            if (distances[n.id] != kUnreachable)
+                best = std::min(best, NextDistance(distances[n.id]));
+        }
+        if (best != kUnreachable)
+        {
+            distances[v] = best;
+            frontier.push_back({best, v});
+        }
+    }
+    std::sort(frontier.begin(), frontier.end());
+
+    std::size_t head = 0, next_seed = 0;
+    while (next_seed < frontier.size() || head < queue.size())
+    {
+        int v;
+        if (head == queue.size() ||
+            (next_seed < frontier.size() && frontier[next_seed].first <= distances[queue[head]]))
+        {
+            v = frontier[next_seed++].second;
+            if (distances[v] != frontier[next_seed - 1].first)
+                continue; // improved since it was seeded, and queued then
+        }
+        else
+        {
+            v = queue[head++];
+        }
+
+        const uint16_t d = NextDistance(distances[v]);
+        for (const Neighbor &n : graph.GetPredecessors(v))
+        {
+            if (distances[n.id] > d)
+            {
+                distances[n.id] = d;
+                queue.push_back(n.id);
+            }
+        }
+    }
+    return 1 + affected.size();
+}
+
+DistanceTable::DistanceTable(const Graph &graph, int _goal)
+    : goal(_goal),
+      distances(graph.Size()),
+      revision(graph.revision)
+{
+    std::vector<int> queue;
+    FillDistances(graph, goal, distances.data(), queue);
+}
+
+DistanceCache::DistanceCache(const Graph &_graph, std::size_t _memory_limit)
+    : memory_limit(_memory_limit),
+      graph(_graph)
+{
+}
+
+std::shared_ptr<const DistanceTable> DistanceCache::Get(int goal)
+{
+    const std::size_t table_bytes = graph.Size() * sizeof(uint16_t);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = index.find(goal);
+        if (found != index.end() && (*found->second)->revision == graph.revision)
+        {
+            ++hits;
+            lru.splice(lru.begin(), lru, found->second);
+            return *found->second;
+        }
+        ++misses;
+        if (found != index.end())
+            Erase(found->second); // left behind by a graph change without Repair
+
+        // Evict from the cold end, skipping tables still held elsewhere, until the new one fits
+        for (auto it = lru.end(); memory_usage + table_bytes > memory_limit && it != lru.begin();)
+        {
+            --it;
+            if (it->use_count() == 1)
+            {
+                it = Erase(it);
+                ++evictions;
+            }
+        }
+        if (memory_usage + table_bytes > memory_limit)
+        {
+            ++refusals;
+            return nullptr;
+        }
+        memory_usage += table_bytes; // reserved while the table is built
+    }
+
+    // Run the BFS unlocked; if another thread built the same table meanwhile, keep theirs
+    Entry table = std::make_shared<DistanceTable>(graph, goal);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = index.find(goal);
+    if (found != index.end() && (*found->second)->revision == graph.revision)
+    {
+        memory_usage -= table_bytes;
+        lru.splice(lru.begin(), lru, found->second);
+        return *found->second;
+    }
+    if (found != index.end())
+        Erase(found->second);
+    lru.push_front(table);
+    index[goal] = lru.begin();
+    return table;
+}
+
+// Drops a table from the cache; a holder keeps it alive, but it no longer counts
+std::list<DistanceCache::Entry>::iterator DistanceCache::Erase(std::list<Entry>::iterator entry)
+{
+    memory_usage -= (*entry)->MemoryUsage();
+    index.erase((*entry)->goal);
+    return lru.erase(entry);
+}
+
+// Tables dropped after a graph change without Repair are not repaired; their revision tells them apart
+std::size_t DistanceCache::Repair(int cell)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::size_t changed = 0;
+    for (const Entry &table : lru)
+    {
+        if (table->revision + 1 == graph.revision)
+        {
+            changed += RepairDistances(graph, table->goal, cell, table->distances.data(), repair);
+            table->revision = graph.revision;
+        }
+    }
+    return changed;
+}
+
+void DistanceCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    lru.clear();
+    index.clear();
+    memory_usage = 0;
+}
+
+std::size_t DistanceCache::Size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return lru.size();
+}
+
+std::size_t DistanceCache::MemoryUsage() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return memory_usage;
+}
@@ -0,0 +1,91 @@
+#include "path_store.h"
+
+#include <algorithm>
+
+PathStore::PathStore(std::size_t _num_agents, std::size_t _chunk_timesteps, std::size_t history_timesteps)
+{
+    Reset(_num_agents, _chunk_timesteps, history_timesteps);
+}
+
+// Drops the recorded rows; chunks are kept for reuse as long as they can hold the new rows
+void PathStore::Reset(std::size_t _num_agents, std::size_t _chunk_timesteps, std::size_t history_timesteps)
+{
+    if (_chunk_timesteps == 0)
+        _chunk_timesteps = 1;
+    // One chunk more than the bound needs, so that a full bound survives while a chunk is refilled
+    const std::size_t _max_chunks = history_timesteps ? (history_timesteps + _chunk_timesteps - 1) / _chunk_timesteps + 1 : 0;
+    if (_chunk_timesteps * _num_agents > chunk_capacity)
+    {
+        chunks.clear();
+        chunk_capacity = _chunk_timesteps * _num_agents;
+    }
+
+    num_agents = _num_agents;
+    chunk_timesteps = _chunk_timesteps;
+    max_chunks = _max_chunks;
+    num_rows = 0;
+}
+
+std::size_t PathStore::FirstTimestep() const
+{
+    if (!max_chunks || num_rows <= max_chunks * chunk_timesteps)
+        return 0;
+    return ((num_rows - 1) / chunk_timesteps + 1 - max_chunks) * chunk_timesteps;
+}
+
+void PathStore::Reserve(std::size_t timesteps)
+{
+    if (max_chunks)
+        timesteps = std::min(timesteps, max_chunks * chunk_timesteps);
+    chunks.reserve((timesteps + chunk_timesteps - 1) / chunk_timesteps);
+    while (chunks.size() * chunk_timesteps < timesteps)
+    {
+        Chunk chunk;
+        chunk.vertices.reset(new int32_t[chunk_capacity]);
+        chunk.headings.reset(new Direction[chunk_capacity]);
+        chunks.push_back(std::move(chunk));
+    }
+}
+
+// Adds a timestep and returns its index; the row's contents are left for the caller to fill
+std::size_t PathStore::AppendRow()
+{
+    Reserve(num_rows + 1);
+    return num_rows++;
+}
+
+Span<int32_t> PathStore::Vertices(std::size_t t)
+{
+    const Chunk &chunk = ChunkFor(t);
+    return Span<int32_t>(chunk.vertices.get() + (t % chunk_timesteps) * num_agents, num_agents);
+}
+
+Span<Direction> PathStore::Headings(std::size_t t)
+{
+    const Chunk &chunk = ChunkFor(t);
+    return Span<Direction>(chunk.headings.get() + (t % chunk_timesteps) * num_agents, num_agents);
+}
+
+Span<const int32_t> PathStore::Vertices(std::size_t t) const
+{
+    const Chunk &chunk = ChunkFor(t);
+    return Span<const int32_t>(chunk.vertices.get() + (t % chunk_timesteps) * num_agents, num_agents);
+}
+
+Span<const Direction> PathStore::Headings(std::size_t t) const
+{
+    const Chunk &chunk = ChunkFor(t);
+    return Span<const Direction>(chunk.headings.get() + (t % chunk_timesteps) * num_agents, num_agents);
+}
+
+PathEntry PathStore::At(std::size_t t, int agent) const
+{
+    const Chunk &chunk = ChunkFor(t);
+    const std::size_t index = (t % chunk_timesteps) * num_agents + agent;
+    return {chunk.vertices[index], chunk.headings[index]};
+}
+
+std::size_t PathStore::MemoryUsage() const
+{
+    return chunks.size() * chunk_capacity * (sizeof(int32_t) + sizeof(Direction));
+}
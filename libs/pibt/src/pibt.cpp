@@ -1,73 +1,227 @@
 #include "pibt.h"
+#include "trajectory.h"
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <iterator>
 #include <random>
+#include <stdexcept>
+#include <utility>
 
 PIBT::PIBT(int w, int h,
            const std::vector<std::vector<int>> &starts,
-           const std::vector<std::vector<int>> &goals)
-    : graph(w, h),
-      agents()
+           const std::vector<std::vector<int>> &goals,
+           const PibtOptions &_options)
+    : PIBT(Graph(w, h), starts, goals, _options)
 {
-    // Create a list of unique priorities
-    const int num_agents = starts.size();
-    std::vector<float> priorities(num_agents);
+}
+
+PIBT::PIBT(Graph _graph,
+           const std::vector<std::vector<int>> &starts,
+           const std::vector<std::vector<int>> &goals,
+           const PibtOptions &_options)
+    : PIBT(std::make_shared<Graph>(std::move(_graph)), starts, goals, _options)
+{
+}
 
-    // Initialize priorities with evenly spaced values
-    for (int i = 0; i < num_agents; ++i)
+PIBT::PIBT(std::shared_ptr<Graph> _graph,
+           const std::vector<std::vector<int>> &starts,
+           const std::vector<std::vector<int>> &goals,
+           const PibtOptions &_options,
+           std::shared_ptr<DistanceCache> _distance_cache,
+           std::shared_ptr<ClusterHierarchy> _hierarchy)
+    : PIBT(std::move(_graph), Span<const int32_t>(), Span<const int32_t>(), Span<const int32_t>(),
+           _options, std::move(_distance_cache), std::move(_hierarchy))
+{
+    if (starts.size() != goals.size())
     {
-        priorities[i] = (float)(i) / num_agents;
+        throw std::invalid_argument("Every agent needs a start and a goal.");
     }
 
-    // Shuffle priorities to ensure randomness
-    std::random_device rd;
-    std::mt19937 g(rd());
-    std::shuffle(priorities.begin(), priorities.end(), g);
-
-    for (int i = 0; i < num_agents; ++i)
+    const std::size_t num_agents = starts.size();
+    std::vector<int32_t> start_vertices(num_agents), goal_vertices(num_agents), headings(num_agents);
+    for (std::size_t i = 0; i < num_agents; ++i)
     {
-        const auto &start = starts[i];
-        const auto &goal = goals[i];
-        Vertex *start_vertex = nullptr;
-        Vertex *goal_vertex = nullptr;
+        const Vertex *start_vertex = graph.GetVertex(starts[i][0], starts[i][1]);
+        const Vertex *goal_vertex = graph.GetVertex(goals[i][0], goals[i][1]);
+        if (!start_vertex || !goal_vertex)
+        {
+            throw std::runtime_error("Invalid start or goal location.");
+        }
+        start_vertices[i] = start_vertex->id;
+        goal_vertices[i] = goal_vertex->id;
+        headings[i] = starts[i][2];
+    }
+    Reset(Span<const int32_t>(start_vertices.data(), num_agents), Span<const int32_t>(goal_vertices.data(), num_agents),
+          Span<const int32_t>(headings.data(), num_agents), options.seed);
+}
 
-        for (Vertex *v : graph.locations)
+PIBT::PIBT(std::shared_ptr<Graph> _graph,
+           Span<const int32_t> start_vertices,
+           Span<const int32_t> goal_vertices,
+           Span<const int32_t> headings,
+           const PibtOptions &_options,
+           std::shared_ptr<DistanceCache> _distance_cache,
+           std::shared_ptr<ClusterHierarchy> _hierarchy)
+    : options(_options),
+      agents(),
+      shared_graph(std::move(_graph)),
+      graph(*shared_graph),
+      shared_distance_cache(_distance_cache ? std::move(_distance_cache)
+                                            : std::make_shared<DistanceCache>(graph, options.distance_cache_bytes)),
+      distance_cache(*shared_distance_cache)
+{
+    if (&distance_cache.GetGraph() != &graph)
+    {
+        throw std::invalid_argument("Distance cache was built for a different graph.");
+    }
+    if (options.rotation_steps < 1 || options.rotation_steps > UINT16_MAX)
+    {
+        throw std::invalid_argument("rotation_steps must be between 1 and 65535.");
+    }
+    if (!options.distance_store_path.empty())
+    {
+        distance_store = std::make_unique<DistanceStore>(options.distance_store_path, graph);
+    }
+    if (options.heuristic == DistanceHeuristic::Clusters)
+    {
+        hierarchy = _hierarchy ? std::move(_hierarchy)
+                               : std::make_shared<ClusterHierarchy>(graph, options.cluster_size, options.distance_cache_bytes);
+        if (&hierarchy->GetGraph() != &graph)
         {
-            if (v->x == start[0] && v->y == start[1])
-            {
-                start_vertex = v;
-            }
-            if (v->x == goal[0] && v->y == goal[1])
-            {
-                goal_vertex = v;
-            }
+            throw std::invalid_argument("Cluster hierarchy was built for a different graph.");
         }
+    }
 
-        if (!start_vertex || !goal_vertex)
+    occupied_now.assign(graph.Size(), nullptr);
+    occupied_next.assign(graph.Size(), nullptr);
+    graph_revision = graph.revision;
+    if (options.num_threads != 1)
+        thread_pool = std::make_unique<ThreadPool>(options.num_threads);
+    workspaces.resize(thread_pool ? thread_pool->Size() : 1);
+
+    Reset(start_vertices, goal_vertices, headings, options.seed);
+}
+
+// Starts a new query on the same graph: agents at start_vertices with the given headings
+// (Direction values) and goals, priorities shuffled by seed as PibtOptions::seed. Buffers are
+// reused, so with at most as many agents as before nothing is allocated, except distance tables
+// for goals not cached yet. Detaches any trajectory.
+void PIBT::Reset(Span<const int32_t> start_vertices, Span<const int32_t> goal_vertices, Span<const int32_t> headings, long long seed)
+{
+    const std::size_t num_agents = start_vertices.size();
+    if (goal_vertices.size() != num_agents || headings.size() != num_agents)
+    {
+        throw std::invalid_argument("Every agent needs a start, a goal and a heading.");
+    }
+    const int32_t num_vertices = (int32_t)graph.Size();
+    for (std::size_t i = 0; i < num_agents; ++i)
+    {
+        if (start_vertices[i] < 0 || start_vertices[i] >= num_vertices || graph.IsBlocked(start_vertices[i]) ||
+            goal_vertices[i] < 0 || goal_vertices[i] >= num_vertices || graph.IsBlocked(goal_vertices[i]))
         {
             throw std::runtime_error("Invalid start or goal location.");
         }
+        if (headings[i] < 0 || headings[i] > (int32_t)Direction::None)
+        {
+            throw std::invalid_argument("Invalid heading.");
+        }
+    }
+
+    // The store describes the map as it was loaded
+    if (graph_revision != graph.revision)
+    {
+        graph_revision = graph.revision;
+        distance_store.reset();
+    }
+    for (const Agent &agent : agent_arena)
+    {
+        occupied_now[agent.v_now->id] = nullptr;
+        if (agent.v_next != nullptr)
+            occupied_next[agent.v_next->id] = nullptr;
+    }
 
-        Agent *agent = new Agent(
-            (int)(i),            // id
-            start_vertex,        // current location
-            nullptr,             // next location
-            start_vertex,        // start
-            goal_vertex,         // goal
-            priorities[i],       // unique priority
-            false,               // reached goal
-            (Direction)start[2] // initialize current direction
+    options.seed = seed;
+    timesteps = 0;
+    failed = false;
+    tasks_completed = 0;
+    degraded = false;
+    fallback_waits = 0;
+    degraded_steps = 0;
+    order_valid = false;
+    trajectory = nullptr;
+    PIBT_STAT(stats = StepStats();
+              stats_history.clear());
+
+    agent_arena.clear();
+    agents.clear();
+    arrived.clear();
+    agent_arena.reserve(num_agents);
+    agents.reserve(num_agents);
+    arrived.reserve(num_agents);
+    departed_scratch.reserve(num_agents);
+    settled_scratch.reserve(num_agents);
+    arrived_scratch.reserve(num_agents);
+    distance_tables.assign(num_agents, nullptr);
+    if (hierarchy)
+        goal_tables.assign(num_agents, nullptr);
+
+    // Evenly spaced unique priorities, shuffled reproducibly when a seed is given
+    priority_scratch.resize(num_agents);
+    for (std::size_t i = 0; i < num_agents; ++i)
+    {
+        priority_scratch[i] = (float)(i) / num_agents;
+    }
+    std::mt19937 g(seed >= 0 ? (std::mt19937::result_type)seed : std::random_device()());
+    std::shuffle(priority_scratch.begin(), priority_scratch.end(), g);
+
+    for (std::size_t i = 0; i < num_agents; ++i)
+    {
+        Vertex *start_vertex = &graph.vertices[start_vertices[i]];
+        agent_arena.emplace_back(
+            (int)(i),                          // id
+            start_vertex,                      // current location
+            nullptr,                           // next location
+            start_vertex,                      // start
+            &graph.vertices[goal_vertices[i]], // goal
+            priority_scratch[i],               // unique priority
+            false,                             // reached goal
+            (Direction)headings[i]             // initial direction
         );
+        Agent *agent = &agent_arena.back();
+        AssignDistances(agent);
         agents.push_back(agent);
+        occupied_now[start_vertex->id] = agent;
     }
-}
+    num_travelling = num_agents;
 
-PIBT::~PIBT()
-{
-    for (Agent *agent : agents)
+    // A priority-inheritance chain visits each agent at most once
+    if (thread_pool)
+    {
+        cluster_parent.resize(num_agents);
+        cluster_of.resize(num_agents);
+        cluster_offsets.resize(num_agents + 1);
+        cluster_members.resize(num_agents);
+    }
+    for (PlannerWorkspace &ws : workspaces)
     {
-        delete agent;
+        ws.candidates.resize((std::size_t)(graph.max_degree + 1) * (num_agents + 1));
+        ws.frames.resize(num_agents + 1);
+    }
+
+    batched_candidates = graph.max_degree < (int)kScoredCandidates;
+    if (batched_candidates)
+    {
+        candidate_keys.resize(kScoredCandidates * num_agents);
+        candidate_orders.resize(num_agents);
+        ScoreAllCandidates();
+    }
+
+    if (options.record_paths)
+    {
+        paths.Reset(num_agents, options.path_chunk_timesteps, options.path_history_timesteps);
+        RecordTimestep();
     }
 }
 
@@ -76,26 +230,149 @@ int PIBT::HeuristicDistance(const Vertex *start, const Vertex *goal)
     return std::abs(start->x - goal->x) + std::abs(start->y - goal->y);
 }
 
-Agent * PIBT::FindConflictingAgent(const Vertex *v, const Agent *agent)
+// Points the agent at the distances to its goal: exact ones from the store, else a cluster goal
+// table under DistanceHeuristic::Clusters, else an exact table built on first use. When the tables
+// in use already fill distance_cache_bytes, the agent gets a cluster goal table instead.
+void PIBT::AssignDistances(Agent *agent)
 {
-    for (auto ak : agents)
+    if (distance_store)
     {
-        if (ak->v_now == v && ak->v_next == nullptr && ak->id != agent->id)
+        agent->distances = distance_store->Find(agent->goal->id);
+        if (agent->distances != nullptr)
         {
-            return ak;
+            distance_tables[agent->id].reset();
+            if (hierarchy)
+                goal_tables[agent->id].reset();
+            return;
         }
     }
+
+    if (options.heuristic == DistanceHeuristic::Tables)
+    {
+        // Let go of the previous goal's table first, so that it does not count against the limit
+        distance_tables[agent->id].reset();
+        distance_tables[agent->id] = distance_cache.Get(agent->goal->id);
+        if (distance_tables[agent->id])
+        {
+            agent->distances = distance_tables[agent->id]->distances.data();
+            if (hierarchy)
+                goal_tables[agent->id].reset();
+            return;
+        }
+        if (!graph.grid)
+        {
+            throw std::runtime_error("The agents' goals need more distance tables than distance_cache_bytes allows.");
+        }
+        if (!hierarchy)
+        {
+            hierarchy = std::make_shared<ClusterHierarchy>(graph, options.cluster_size, options.distance_cache_bytes);
+            goal_tables.assign(distance_tables.size(), nullptr);
+        }
+    }
+
+    goal_tables[agent->id] = hierarchy->Get(agent->goal->id);
+    agent->goal_table = goal_tables[agent->id].get();
+    agent->distances = nullptr;
+}
+
+Agent * PIBT::FindConflictingAgent(const Vertex *v, const Agent *agent)
+{
+    Agent *ak = occupied_now[v->id];
+    if (ak != nullptr && ak->v_next == nullptr && ak->id != agent->id)
+    {
+        return ak;
+    }
     return nullptr;
 }
 
-bool PIBT::AllReached()
+// Moves an agent's reservation for the next timestep, keeping occupied_next in sync
+void PIBT::SetNext(Agent *agent, Vertex *v)
 {
-    for (auto agent : agents)
+    if (agent->v_next != nullptr && occupied_next[agent->v_next->id] == agent)
     {
-        if (!agent->reached_goal)
-            return false;
+        occupied_next[agent->v_next->id] = nullptr;
+    }
+    agent->v_next = v;
+    if (v != nullptr)
+    {
+        occupied_next[v->id] = agent;
     }
-    return true;
+}
+
+// Appends the agents' current vertices and headings to the path store, and to the trajectory
+// when one is attached
+void PIBT::RecordTimestep()
+{
+    const std::size_t t = paths.AppendRow();
+    Span<int32_t> vertices = paths.Vertices(t);
+    Span<Direction> headings = paths.Headings(t);
+    // By id: Step records before `agents` is back in planning order
+    for (const Agent &agent : agent_arena)
+    {
+        vertices[agent.id] = agent.v_now->id;
+        headings[agent.id] = agent.current_direction;
+    }
+    if (trajectory)
+        trajectory->Append(vertices, headings);
+}
+
+// Streams every timestep from now on to writer, starting with the current state; null detaches.
+// Needs record_paths; a small path_history_timesteps keeps memory bounded meanwhile.
+void PIBT::StreamTo(TrajectoryWriter *writer)
+{
+    if (writer && !options.record_paths)
+    {
+        throw std::logic_error("Streaming a trajectory needs record_paths.");
+    }
+    trajectory = writer;
+    if (trajectory)
+    {
+        const std::size_t t = paths.NumTimesteps() - 1;
+        trajectory->Append(paths.Vertices(t), paths.Headings(t));
+    }
+}
+
+// Sum over agents of the timestep after which they stayed at their current goal, from the
+// recorded paths; agents that end away from their goal count every recorded timestep.
+// With a bounded history only the retained timesteps are seen.
+std::size_t PIBT::SumOfCosts() const
+{
+    std::vector<int> last_away(agent_arena.size(), -1);
+    for (std::size_t t = paths.FirstTimestep(); t < paths.NumTimesteps(); ++t)
+    {
+        Span<const int32_t> vertices = paths.Vertices(t);
+        for (const Agent &agent : agent_arena)
+        {
+            if (vertices[agent.id] != agent.goal->id)
+                last_away[agent.id] = (int)t;
+        }
+    }
+
+    std::size_t cost = 0;
+    for (int t : last_away)
+        cost += t + 1;
+    return cost;
+}
+
+// Bytes owned by this planner; the graph and the distance tables may be shared and are not counted
+std::size_t PIBT::MemoryUsage() const
+{
+    std::size_t bytes = agent_arena.capacity() * sizeof(Agent) +
+                        (agents.capacity() + arrived.capacity() + departed_scratch.capacity() +
+                         settled_scratch.capacity() + arrived_scratch.capacity() + cluster_members.capacity() +
+                         occupied_now.capacity() + occupied_next.capacity()) * sizeof(Agent *) +
+                        (distance_tables.capacity() + goal_tables.capacity()) * sizeof(distance_tables[0]) +
+                        (cluster_parent.capacity() + cluster_of.capacity()) * sizeof(int) +
+                        cluster_offsets.capacity() * sizeof(std::size_t) +
+                        paths.MemoryUsage();
+    for (const PlannerWorkspace &ws : workspaces)
+        bytes += ws.candidates.capacity() * sizeof(Candidate) + ws.frames.capacity() * sizeof(PibtFrame);
+    return bytes;
+}
+
+bool PIBT::AllReached()
+{
+    return num_travelling == 0;
 }
 
 void PIBT::PrintAgents()
@@ -105,15 +382,18 @@ void PIBT::PrintAgents()
         std::cout << "Agent ID: " << agent->id << '\n';
         std::cout << "Priority: " << agent->priority << '\n';
         std::cout << "Reached Goal: " << (agent->reached_goal ? "Yes" : "No") << '\n';
-        std::cout << "Start Location(x, y, direction): (" << agent->start->x << ", " << agent->start->y << graph.DirectionToString((Direction) agent->start->direction) << ")\n";
-        std::cout << "Goal Location(x, y, direction): (" << agent->goal->x << ", " << agent->goal->y << graph.DirectionToString((Direction) agent->start->direction) << ")\n";
+        PathView path = GetPath(agent->id);
+        std::cout << "Start Location(x, y): (" << agent->start->x << ", " << agent->start->y << ")\n";
+        std::cout << "Goal Location(x, y): (" << agent->goal->x << ", " << agent->goal->y << ")\n";
         std::cout << "Current Location(x, y): (" << agent->v_now->x << ", " << agent->v_now->y << ")\n";
         std::cout << "Next Location(x, y): ";
         (agent->v_next)? std::cout << "(" << agent->v_next->x << ", " << agent->v_next->y << ")\n" : std::cout << "None\n";
         std::cout << "Path: ";
-        std::cout << "Path: ";
-        for (const auto& step : agent->Path)
-            std::cout << "(" << step[0] << ", " << step[1] << ", " << graph.DirectionToString((Direction) step[2]) << ") ";
+        for (PathEntry step : path)
+        {
+            const Vertex &v = graph.vertices[step.vertex];
+            std::cout << "(" << v.x << ", " << v.y << ", " << graph.DirectionToString(step.heading) << ") ";
+        }
         std::cout << "\n\n";
     }
 }
@@ -122,165 +402,739 @@ void PIBT::SortAgentsById()
 {
     std::sort(agents.begin(), agents.end(), [](const Agent *a, const Agent *b)
               { return a->id < b->id; });
+    order_valid = false;
 }
 
-// Function to determine next move for an agent
-bool PIBT::PibtAlgorithm(Agent *ai, Agent *aj)
+// Pushes the candidate moves of ai, pushed by aj if not null, onto the candidate stack, best first,
+// and returns their count
+template <typename Motion>
+std::size_t PIBT::PushCandidates(PlannerWorkspace &ws, Agent *ai, const Agent *aj)
 {
-    auto compare = [&](Vertex *const v, Vertex *const u)
+    Candidate *candidates = ws.candidates.data() + ws.top;
+    std::size_t num_candidates = 0;
+
+    // An agent still turning does not start a move of its own. It gives way when pushed, though:
+    // holding it in place would stall the priority inheritance and deadlock dense traffic. The turn
+    // is only abandoned once CommitMove sees it leave.
+    if (Motion::kTurns && ai->turn_wait > 0 && aj == nullptr)
     {
-        int d_v = HeuristicDistance(v, ai->goal);
-        int d_u = HeuristicDistance(u, ai->goal);
-        return d_v < d_u;
-    };
+        candidates[num_candidates++] = {ai->v_now, ai->current_direction};
+        ws.top += num_candidates;
+        return num_candidates;
+    }
 
-    std::vector<Vertex *> candidates = graph.GetNeighbors(ai->v_now);
-    candidates.push_back(ai->v_now); // Include current vertex as a candidate
-    std::sort(candidates.begin(), candidates.end(), compare);
+    const Span<const Neighbor> neighbors = graph.GetNeighbors(ai->v_now);
+    if (batched_candidates)
+    {
+        // Already ordered by ScoreCandidates
+        for (uint32_t order = candidate_orders[ai->id]; (order & 7) != kOrderEnd; order >>= 3)
+        {
+            const uint32_t slot = order & 7;
+            if (slot == kWaitSlot)
+                candidates[num_candidates++] = {ai->v_now, ai->current_direction};
+            else
+                candidates[num_candidates++] = {&graph.vertices[neighbors[slot].id], neighbors[slot].direction};
+        }
+        ws.top += num_candidates;
+        return num_candidates;
+    }
 
-    for (Vertex *u : candidates)
+    for (const Neighbor &n : neighbors)
     {
-        bool vertex_conflict = false;
-        for (auto ak : agents)
+        candidates[num_candidates++] = {&graph.vertices[n.id], n.direction};
+    }
+    candidates[num_candidates++] = {ai->v_now, ai->current_direction}; // Include current vertex as a candidate
+    ws.top += num_candidates;
+
+    // Insertion sort by distance to goal; stable, and cheaper than std::sort for at most a handful of entries
+    for (std::size_t i = 1; i < num_candidates; ++i)
+    {
+        Candidate c = candidates[i];
+        const uint16_t d = Distance(ai, c.vertex);
+        std::size_t j = i;
+        for (; j > 0 && Distance(ai, candidates[j - 1].vertex) > d; --j)
+            candidates[j] = candidates[j - 1];
+        candidates[j] = c;
+    }
+    return num_candidates;
+}
+
+// Scores and orders the candidates of agents [begin, end) by id for their current vertex and goal
+void PIBT::ScoreCandidates(std::size_t begin, std::size_t end)
+{
+    const std::size_t stride = agent_arena.size();
+    for (std::size_t id = begin; id < end; ++id)
+    {
+        const Agent &agent = agent_arena[id];
+        uint32_t *keys = candidate_keys.data() + id;
+        uint32_t slot = 0;
+        for (const Neighbor &n : graph.GetNeighbors(agent.v_now))
         {
-            if (ak->id == ai->id)
-                continue;
-            if (ak->v_next != nullptr)
-            {
-                if (ak->v_next == u)
-                {
-                    vertex_conflict = true;
-                    break;
-                }
-                if (ak->v_now == u)
-                {
-                    vertex_conflict = true;
-                    break;
-                }
-            }
+            keys[slot * stride] = CandidateKey(Distance(&agent, &graph.vertices[n.id]), slot);
+            ++slot;
+        }
+        for (; slot < kWaitSlot; ++slot)
+            keys[slot * stride] = kNoCandidate;
+        keys[kWaitSlot * stride] = CandidateKey(Distance(&agent, agent.v_now), kWaitSlot);
+    }
+    SortCandidates(candidate_keys.data(), stride, begin, end, candidate_orders.data());
+}
+
+// Orders every agent's candidates, split into blocks across the planning threads
+void PIBT::ScoreAllCandidates()
+{
+    constexpr std::size_t kBlock = 4096;
+    const std::size_t num_agents = agent_arena.size();
+    if (!thread_pool || num_agents <= kBlock)
+    {
+        ScoreCandidates(0, num_agents);
+        return;
+    }
+    thread_pool->ParallelFor((num_agents + kBlock - 1) / kBlock, [this, num_agents](std::size_t block, std::size_t)
+                             { ScoreCandidates(block * kBlock, std::min(num_agents, (block + 1) * kBlock)); });
+}
+
+// Whether ai may claim u: not reserved by another agent, not held by an agent that has already
+// planned, and not the vertex of the agent pushing ai
+bool PIBT::CanClaim(const Agent *ai, const Agent *aj, const Vertex *u, Agent *&occupant) const
+{
+    Agent *claimed = occupied_next[u->id];
+    if (claimed != nullptr && claimed != ai)
+        return false;
+
+    occupant = occupied_now[u->id];
+    if (occupant == ai)
+        occupant = nullptr;
+    return !((occupant != nullptr && occupant->v_next != nullptr) || (aj && aj->v_now == u));
+}
+
+// Settles ai's move onto a claimed candidate: an agent that pushed someone waits this timestep,
+// and a move the motion model does not allow becomes a turn in place. The heading the agent has
+// after this timestep is set here, so executing the move in Step only changes the position. A turn
+// in progress ends only when the agent leaves its vertex.
+template <typename Motion>
+void PIBT::CommitMove(Agent *ai, const Candidate &candidate, bool inherited)
+{
+    const bool turn = Motion::MustTurn(ai->current_direction, candidate.direction);
+    if (inherited || turn)
+    {
+        SetNext(ai, ai->v_now);
+        if (turn)
+        {
+            ai->current_direction = candidate.direction;
+            ai->turn_wait = (uint16_t)options.rotation_steps;
         }
+        return;
+    }
+    if (Motion::kTurns && candidate.vertex != ai->v_now)
+        ai->turn_wait = 0;
+    ai->current_direction = Motion::Heading(ai->current_direction, candidate.direction);
+}
+
+// Function to determine next move for an agent
+template <typename Motion>
+bool PIBT::PibtAlgorithm(PlannerWorkspace &ws, Agent *ai, Agent *aj)
+{
+    if (aj != nullptr && OutOfTime(ws))
+        return false;
+    PIBT_STAT(++ws.stats.calls;
+              ws.stats.max_depth = std::max(ws.stats.max_depth, ++ws.depth));
+
+    // Take this frame's slice of the candidate stack
+    Candidate *candidates = ws.candidates.data() + ws.top;
+    const std::size_t num_candidates = PushCandidates<Motion>(ws, ai, aj);
 
-        if (vertex_conflict || (aj && aj->v_now == u))
+    bool result = false;
+    for (std::size_t c = 0; c < num_candidates; ++c)
+    {
+        const Candidate &candidate = candidates[c];
+        Vertex *u = candidate.vertex;
+        PIBT_STAT(++ws.stats.candidates);
+
+        Agent *ak = nullptr;
+        if (!CanClaim(ai, aj, u, ak))
+            continue;
+
+        SetNext(ai, u);
+
+        // Push the unplanned occupant of u out of the way
+        if (ak != nullptr && !PibtAlgorithm<Motion>(ws, ak, ai))
         {
+            PIBT_STAT(++ws.stats.backtracks);
+            SetNext(ai, nullptr);
+            if (ws.out_of_time)
+                break; // the chain is abandoned, ai stays unplanned
             continue;
         }
 
-        ai->v_next = u;
-        bool found_valid_move = true;
-        bool inherited = false;
+        CommitMove<Motion>(ai, candidate, ak != nullptr);
+        result = true;
+        break;
+    }
 
-        for (auto ak : agents)
-        {
-            if (ak->id == ai->id)
-                continue;
+    if (!result && !ws.out_of_time)
+        SetNext(ai, ai->v_now);
 
-            if (!(ak->v_now == u))
-                continue;
-            if (ak->v_next != nullptr)
-                continue;
+    ws.top -= num_candidates;
+    PIBT_STAT(--ws.depth);
+    return result;
+}
+
+// Same decisions as PibtAlgorithm(ws, ai), with the priority-inheritance chain kept on ws.frames
+// instead of the call stack
+template <typename Motion>
+bool PIBT::PibtAlgorithmIterative(PlannerWorkspace &ws, Agent *root)
+{
+    const std::size_t base = ws.top;
+    std::size_t depth = 0;
+    auto push = [&](Agent *ai, Agent *aj)
+    {
+        PIBT_STAT(++ws.stats.calls;
+                  ws.stats.max_depth = std::max(ws.stats.max_depth, ++ws.depth));
+        PibtFrame &frame = ws.frames[depth++];
+        frame.ai = ai;
+        frame.aj = aj;
+        frame.candidates = ws.candidates.data() + ws.top;
+        frame.num_candidates = (uint32_t)PushCandidates<Motion>(ws, ai, aj);
+        frame.next = 0;
+    };
 
-            if (PibtAlgorithm(ak, ai))
+    push(root, nullptr);
+    bool result = false;
+    bool resuming = false; // the top frame's current candidate pushed an agent that returned `result`
+    while (depth > 0)
+    {
+        PibtFrame &frame = ws.frames[depth - 1];
+        Agent *ai = frame.ai;
+        bool done = false;
+
+        if (resuming)
+        {
+            resuming = false;
+            if (result)
             {
-                inherited = true;
+                CommitMove<Motion>(ai, frame.candidates[frame.next], true);
+                done = true;
             }
             else
             {
-                found_valid_move = false;
+                PIBT_STAT(++ws.stats.backtracks);
+                SetNext(ai, nullptr);
+                ++frame.next;
             }
-
-            // break;
         }
 
-        if (!found_valid_move)
+        bool pushed = false;
+        for (; !done && frame.next < frame.num_candidates; ++frame.next)
         {
-            // ai->v_next = ai->v_now;
-            ai->v_next = nullptr;
-            continue;
-        }
+            const Candidate &candidate = frame.candidates[frame.next];
+            PIBT_STAT(++ws.stats.candidates);
 
-        int dx = ai->v_now->x - u->x;
-        int dy = ai->v_now->y - u->y;
-        bool moving_side = (ai->current_direction == 0 || ai->current_direction == 1) && dx;
-        bool moving_side_up = (ai->current_direction == 2 || ai->current_direction == 3) && dy;
+            Agent *ak = nullptr;
+            if (!CanClaim(ai, frame.aj, candidate.vertex, ak))
+                continue;
 
-        if ((found_valid_move && inherited) || moving_side || moving_side_up)
-        {
-            ai->v_next = ai->v_now;
-            if (moving_side || moving_side_up)
-                ai->current_direction = u->direction;
+            SetNext(ai, candidate.vertex);
+            if (ak != nullptr)
+            {
+                if (OutOfTime(ws))
+                {
+                    // Abandon the chain: its agents stay unplanned, pushed agents that already
+                    // gave up keep waiting
+                    for (std::size_t d = 0; d < depth; ++d)
+                        SetNext(ws.frames[d].ai, nullptr);
+                    ws.top = base;
+                    PIBT_STAT(ws.depth -= depth);
+                    return false;
+                }
+                push(ak, ai); // resumed once ak's frame finishes
+                pushed = true;
+                break;
+            }
+
+            CommitMove<Motion>(ai, candidate, false);
+            done = true;
         }
+        if (pushed)
+            continue;
 
-        return found_valid_move;
+        // Frame finished, successfully or with every candidate exhausted
+        result = done;
+        if (!result)
+            SetNext(ai, ai->v_now);
+        ws.top -= frame.num_candidates;
+        PIBT_STAT(--ws.depth);
+        --depth;
+        resuming = true;
     }
+    return result;
+}
 
-    ai->v_next = ai->v_now;
+// Plans one priority-inheritance chain rooted at an agent that has no move yet
+template <typename Motion>
+void PIBT::PlanAgent(PlannerWorkspace &ws, Agent *agent)
+{
+    if (OutOfTime(ws))
+        return;
+    PIBT_STAT(std::size_t calls_before = ws.stats.calls);
+    if (options.engine == PibtEngine::Recursive)
+        PibtAlgorithm<Motion>(ws, agent, nullptr);
+    else
+        PibtAlgorithmIterative<Motion>(ws, agent);
+    PIBT_STAT(std::size_t chain = ws.stats.calls - calls_before;
+              ++ws.stats.chains;
+              ws.stats.chain_agents += chain;
+              ws.stats.max_chain = std::max(ws.stats.max_chain, chain));
+}
 
-    return false;
+void PIBT::PlanAgent(PlannerWorkspace &ws, Agent *agent)
+{
+    if (options.motion_model == MotionModel::Holonomic)
+        PlanAgent<HolonomicMotion>(ws, agent);
+    else
+        PlanAgent<RotateThenMoveMotion>(ws, agent);
 }
 
-void PIBT::RunPibt()
+// Whether the current Step's budget has run out. Reading the clock costs about as much as
+// planning an agent, so it is read on the first check of a Step and then every kClockInterval.
+bool PIBT::OutOfTime(PlannerWorkspace &ws)
+{
+    constexpr uint32_t kClockInterval = 16;
+    if (ws.out_of_time)
+        return true;
+    if (ws.deadline == std::chrono::steady_clock::time_point::max() || --ws.clock_countdown > 0)
+        return false;
+    ws.clock_countdown = kClockInterval;
+    ws.out_of_time = std::chrono::steady_clock::now() >= ws.deadline;
+    return ws.out_of_time;
+}
+
+template bool PIBT::PibtAlgorithm<RotateThenMoveMotion>(PlannerWorkspace &, Agent *, Agent *);
+template bool PIBT::PibtAlgorithm<HolonomicMotion>(PlannerWorkspace &, Agent *, Agent *);
+template bool PIBT::PibtAlgorithmIterative<RotateThenMoveMotion>(PlannerWorkspace &, Agent *);
+template bool PIBT::PibtAlgorithmIterative<HolonomicMotion>(PlannerWorkspace &, Agent *);
+
+int PIBT::FindCluster(int agent_id)
 {
-    auto compare = [](Agent *a, const Agent *b)
+    while (cluster_parent[agent_id] != agent_id)
     {
-        return a->priority > b->priority;
+        cluster_parent[agent_id] = cluster_parent[cluster_parent[agent_id]];
+        agent_id = cluster_parent[agent_id];
+    }
+    return agent_id;
+}
+
+// Groups agents that can affect each other's plans this timestep. An agent only claims its own
+// vertex or a successor and only pushes agents standing there, so agents that share no such vertex,
+// and any agents they push, never touch the same vertex or agent. Each agent is united with those
+// on its successors and on their predecessors: on undirected graphs, everyone within two edges.
+void PIBT::BuildClusters()
+{
+    for (std::size_t i = 0; i < cluster_parent.size(); ++i)
+        cluster_parent[i] = (int)i;
+
+    auto unite = [this](int a, int b)
+    {
+        a = FindCluster(a);
+        b = FindCluster(b);
+        if (a != b)
+            cluster_parent[std::max(a, b)] = std::min(a, b);
     };
 
-    while (!AllReached())
+    for (const Agent &agent : agent_arena)
     {
-        for (auto *agent : agents)
+        const int v = agent.v_now->id;
+        if (occupied_now[v] != nullptr && occupied_now[v] != &agent)
+            unite(agent.id, occupied_now[v]->id);
+        for (const Neighbor &n1 : graph.GetNeighbors(v))
         {
-            if (!(agent->v_now == agent->goal))
-                agent->priority++;
-            else
-                agent->reached_goal = true;
-
-            if (agent->v_next != nullptr)
+            if (occupied_now[n1.id] != nullptr)
+                unite(agent.id, occupied_now[n1.id]->id);
+            for (const Neighbor &n2 : graph.GetPredecessors(n1.id))
             {
-                Direction new_direction = Direction::None;
-                if (agent->v_next->x == agent->v_now->x && agent->v_next->y == agent->v_now->y - 1)
-                    new_direction = Direction::Up;
-                else if (agent->v_next->x == agent->v_now->x && agent->v_next->y == agent->v_now->y + 1)
-                    new_direction = Direction::Down;
-                else if (agent->v_next->x == agent->v_now->x - 1 && agent->v_next->y == agent->v_now->y)
-                    new_direction = Direction::Left;
-                else if (agent->v_next->x == agent->v_now->x + 1 && agent->v_next->y == agent->v_now->y)
-                    new_direction = Direction::Right;
-
-                // Maintain direction consistency for opposite moves
-                if ((new_direction == Direction::Up && agent->current_direction == Direction::Down) ||
-                    (new_direction == Direction::Down && agent->current_direction == Direction::Up) ||
-                    (new_direction == Direction::Left && agent->current_direction == Direction::Right) ||
-                    (new_direction == Direction::Right && agent->current_direction == Direction::Left) ||
-                    (new_direction == Direction::None))
-                {
-                    new_direction = agent->current_direction;
-                }
+                if (occupied_now[n2.id] != nullptr)
+                    unite(agent.id, occupied_now[n2.id]->id);
+            }
+        }
+    }
+
+    // Number clusters by their highest-priority member and bucket members in planning order
+    std::fill(cluster_of.begin(), cluster_of.end(), -1);
+    num_clusters = 0;
+    for (const Agent *agent : agents)
+    {
+        const int root = FindCluster(agent->id);
+        if (cluster_of[root] < 0)
+        {
+            cluster_of[root] = (int)num_clusters;
+            cluster_offsets[++num_clusters] = 0;
+        }
+        cluster_of[agent->id] = cluster_of[root];
+        ++cluster_offsets[cluster_of[agent->id] + 1];
+    }
+    cluster_offsets[0] = 0;
+    for (std::size_t c = 0; c < num_clusters; ++c)
+        cluster_offsets[c + 1] += cluster_offsets[c];
+    for (Agent *agent : agents)
+    {
+        cluster_members[cluster_offsets[cluster_of[agent->id]]++] = agent;
+    }
+    // The fill advanced each offset to the next cluster's start; shift them back
+    for (std::size_t c = num_clusters; c > 0; --c)
+        cluster_offsets[c] = cluster_offsets[c - 1];
+    cluster_offsets[0] = 0;
+}
+
+void PIBT::PlanCluster(std::size_t cluster, std::size_t worker)
+{
+    for (std::size_t i = cluster_offsets[cluster]; i < cluster_offsets[cluster + 1]; ++i)
+    {
+        if (cluster_members[i]->v_next == nullptr)
+            PlanAgent(workspaces[worker], cluster_members[i]);
+    }
+}
+
+// Advances the simulation by one timestep: executes the moves planned by the previous call,
+// records goal arrivals, then plans every agent's move for the next timestep
+void PIBT::Step()
+{
+    SyncWithGraph();
 
-                agent->Path.push_back({agent->v_next->x, agent->v_next->y, (int) new_direction});
-                agent->current_direction = new_direction; // Update previous direction
-                agent->v_now = agent->v_next;
-                agent->v_next = nullptr;
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    if (options.step_budget_seconds > 0.0)
+    {
+        deadline = std::chrono::steady_clock::now() +
+                   std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.step_budget_seconds));
+    }
+
+    PIBT_STAT(stats = StepStats();
+              stats.timestep = timesteps;
+              auto phase_start = std::chrono::steady_clock::now());
+
+    // Priorities only grow by one or drop back below one at the goal, so the new order is:
+    // agents still travelling in their previous order, then agents that just left their goal
+    // (priority initial + 1), then agents at their goal (priority initial). Only agents that
+    // changed group are sorted, by their tie-breaker, and merged in.
+    arrived.clear();
+    departed_scratch.clear();
+    settled_scratch.clear();
+    arrived_scratch.clear();
+    std::size_t num_kept = 0;
+    for (auto *agent : agents)
+    {
+        if (agent->v_next != nullptr)
+        {
+            // The heading was already settled by CommitMove; a turn in progress counts down
+            agent->turn_wait -= agent->turn_wait > 0;
+
+            // Agents move simultaneously: only release the old vertex if nobody has moved in yet
+            if (occupied_now[agent->v_now->id] == agent)
+                occupied_now[agent->v_now->id] = nullptr;
+            occupied_now[agent->v_next->id] = agent;
+            occupied_next[agent->v_next->id] = nullptr;
+            agent->v_now = agent->v_next;
+            agent->v_next = nullptr;
+        }
+
+        const bool was_travelling = agent->priority >= 1.0f;
+        if (!(agent->v_now == agent->goal))
+        {
+            agent->priority++;
+            if (was_travelling)
+                agents[num_kept++] = agent;
+            else
+                departed_scratch.push_back(agent);
+        }
+        else
+        {
+            agent->priority = agent->initial_priority;
+            (was_travelling ? arrived_scratch : settled_scratch).push_back(agent);
+            if (!agent->reached_goal)
+            {
+                agent->reached_goal = true;
+                --num_travelling;
+                arrived.push_back(agent);
             }
         }
+    }
+    tasks_completed += arrived.size();
+    if (options.record_paths)
+        RecordTimestep();
 
-        std::sort(agents.begin(), agents.end(), compare);
+    PIBT_STAT(auto sort_start = std::chrono::steady_clock::now();
+              stats.update_seconds = std::chrono::duration<double>(sort_start - phase_start).count());
 
+    auto by_initial_priority = [](const Agent *a, const Agent *b)
+    {
+        return a->initial_priority > b->initial_priority;
+    };
+    std::sort(departed_scratch.begin(), departed_scratch.end(), by_initial_priority);
+    std::sort(arrived_scratch.begin(), arrived_scratch.end(), by_initial_priority);
+    agents.resize(num_kept);
+    agents.insert(agents.end(), departed_scratch.begin(), departed_scratch.end());
+    std::merge(settled_scratch.begin(), settled_scratch.end(),
+               arrived_scratch.begin(), arrived_scratch.end(),
+               std::back_inserter(agents), by_initial_priority);
+    if (!order_valid)
+    {
+        std::sort(agents.begin(), agents.end(), [](const Agent *a, const Agent *b)
+                  { return a->priority > b->priority; });
+        order_valid = true;
+    }
+
+    PIBT_STAT(auto plan_start = std::chrono::steady_clock::now();
+              stats.sort_seconds = std::chrono::duration<double>(plan_start - sort_start).count());
+
+    if (batched_candidates)
+        ScoreAllCandidates();
+
+    for (PlannerWorkspace &ws : workspaces)
+    {
+        ws.deadline = deadline;
+        ws.clock_countdown = 1;
+        ws.out_of_time = false;
+        PIBT_STAT(ws.stats = StepStats());
+    }
+    if (thread_pool)
+    {
+        // Clusters are independent, so planning each in priority order matches a single thread
+        BuildClusters();
+        thread_pool->ParallelFor(num_clusters, [this](std::size_t c, std::size_t worker)
+                                 { PlanCluster(c, worker); });
+    }
+    else
+    {
+        for (auto *agent : agents)
+        {
+            if (agent->v_next == nullptr)
+                PlanAgent(workspaces[0], agent);
+        }
+    }
+
+    // Out of time: agents still unplanned wait in place. Claiming an unplanned agent's vertex
+    // means pushing it, which plans it, so nobody else is headed for these vertices.
+    fallback_waits = 0;
+    if (deadline != std::chrono::steady_clock::time_point::max())
+    {
         for (auto *agent : agents)
         {
             if (agent->v_next == nullptr)
             {
-                PibtAlgorithm(agent, nullptr);
+                SetNext(agent, agent->v_now);
+                ++fallback_waits;
             }
         }
-        ++timesteps;
+    }
+    degraded = fallback_waits > 0;
+    degraded_steps += degraded;
+
+    PIBT_STAT(stats.plan_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - plan_start).count();
+              for (const PlannerWorkspace &ws : workspaces)
+                  AccumulatePlanningStats(stats, ws.stats);
+              for (const Agent *agent : agents)
+                  stats.waits += agent->v_next == agent->v_now && agent->v_now != agent->goal;
+              stats_history.push_back(stats));
+    ++timesteps;
+}
 
-        timesteps++;
+// One planning phase from an arbitrary joint state, for searches that use PIBT to generate
+// successors (see LaCAM). Agents are placed at `vertices` with `headings` and planned in `order`,
+// agent ids highest priority first, with the moves in `fixed` taken as given. Writes the state
+// after the timestep and returns false when the fixed moves leave no collision-free plan; a
+// yielding one waits instead when the agent it pushes stays. If given, `roots` receives for each
+// agent the one whose priority-inheritance chain planned it; agents with a fixed move are their
+// own. Goals, priorities and recorded paths are not touched.
+bool PIBT::PlanFrom(Span<const int32_t> vertices, Span<const Direction> headings, Span<const int> order,
+                    Span<const FixedMove> fixed, Span<int32_t> next_vertices, Span<Direction> next_headings,
+                    Span<int32_t> roots)
+{
+    for (Agent &agent : agent_arena)
+    {
+        if (occupied_now[agent.v_now->id] == &agent)
+            occupied_now[agent.v_now->id] = nullptr;
+        SetNext(&agent, nullptr);
+    }
+    for (Agent &agent : agent_arena)
+    {
+        agent.v_now = &graph.vertices[vertices[agent.id]];
+        agent.current_direction = headings[agent.id];
+        agent.turn_wait = 0;
+        occupied_now[agent.v_now->id] = &agent;
+    }
 
-        if (timesteps > (agents.size() * std::max(graph.width, graph.height) * 10))
+    for (const FixedMove &move : fixed)
+    {
+        Agent *agent = GetAgent(move.agent);
+        if (occupied_next[move.vertex] != nullptr)
+            return false;
+        SetNext(agent, &graph.vertices[move.vertex]);
+        agent->current_direction = move.heading;
+    }
+    if (batched_candidates)
+        ScoreAllCandidates();
+
+    // Plans every agent, whatever the Step budget
+    workspaces[0].deadline = std::chrono::steady_clock::time_point::max();
+    workspaces[0].out_of_time = false;
+    if (roots.empty())
+    {
+        for (int id : order)
+        {
+            if (agent_arena[id].v_next == nullptr)
+                PlanAgent(workspaces[0], &agent_arena[id]);
+        }
+    }
+    else
+    {
+        for (const Agent &agent : agent_arena)
+            roots[agent.id] = agent.v_next != nullptr ? agent.id : -1;
+        // A chain only reaches agents next to its own, so the agents it planned are found from its root
+        std::vector<Agent *> chain;
+        for (int id : order)
+        {
+            if (agent_arena[id].v_next != nullptr)
+                continue;
+            PlanAgent(workspaces[0], &agent_arena[id]);
+            roots[id] = id;
+            chain.assign(1, &agent_arena[id]);
+            while (!chain.empty())
+            {
+                const Agent *ai = chain.back();
+                chain.pop_back();
+                for (const Neighbor &n : graph.GetNeighbors(ai->v_now))
+                {
+                    Agent *ak = occupied_now[n.id];
+                    if (ak != nullptr && ak->v_next != nullptr && roots[ak->id] < 0)
+                    {
+                        roots[ak->id] = id;
+                        chain.push_back(ak);
+                    }
+                }
+            }
+        }
+    }
+
+    // A yielding agent gives way to the occupant that stayed, as a pusher waits for the agent it pushed
+    for (const FixedMove &move : fixed)
+    {
+        Agent *agent = GetAgent(move.agent);
+        if (move.yield && occupied_next[move.vertex] != agent)
+        {
+            SetNext(agent, agent->v_now);
+            agent->current_direction = headings[agent->id];
+        }
+    }
+
+    // A fallback wait can take a vertex already claimed by a fixed move, and fixed moves can swap
+    for (const Agent &agent : agent_arena)
+    {
+        const Agent *occupant = occupied_now[agent.v_next->id];
+        if (occupied_next[agent.v_next->id] != &agent ||
+            (occupant != nullptr && occupant != &agent && occupant->v_next == agent.v_now))
+            return false;
+        next_vertices[agent.id] = agent.v_next->id;
+        next_headings[agent.id] = agent.current_direction;
+    }
+    return true;
+}
+
+void PIBT::RunPibt()
+{
+    while (!AllReached())
+    {
+        Step();
+
+        const std::size_t limit = options.max_timesteps > 0 ? (std::size_t)options.max_timesteps
+                                                            : agents.size() * std::max(graph.width, graph.height) * 10;
+        if ((std::size_t)timesteps > limit)
         {
             failed = true;
             timesteps = 0;
             return;
         }
     }
-}
\ No newline at end of file
+}
+
+// Gives an agent a new goal between steps; it keeps its position, heading and priority.
+// The move already planned for the next timestep still executes.
+void PIBT::SetGoal(int agent_id, int x, int y)
+{
+    if (agent_id < 0 || agent_id >= (int)agent_arena.size())
+    {
+        throw std::out_of_range("Invalid agent id.");
+    }
+
+    Vertex *goal_vertex = graph.GetVertex(x, y);
+    if (!goal_vertex || graph.IsBlocked(goal_vertex->id))
+    {
+        throw std::runtime_error("Invalid goal location.");
+    }
+
+    Agent *agent = GetAgent(agent_id);
+    agent->goal = goal_vertex;
+    if (agent->reached_goal)
+        ++num_travelling;
+    agent->reached_goal = false;
+    AssignDistances(agent);
+    if (batched_candidates)
+        ScoreCandidates(agent_id, agent_id + 1);
+}
+
+// Blocks or unblocks cell (x, y) between Steps, repairing the cached distance tables in place.
+// Returns false, changing nothing, when blocking a cell an agent stands on, moves into next or
+// has as its goal.
+bool PIBT::SetBlocked(int x, int y, bool blocked)
+{
+    Vertex *v = graph.GetVertex(x, y);
+    if (!v)
+    {
+        throw std::out_of_range("Invalid cell.");
+    }
+    if (hierarchy)
+    {
+        throw std::logic_error("Runtime obstacles are not supported with the cluster heuristic, which also serves agents beyond distance_cache_bytes.");
+    }
+
+    if (blocked)
+    {
+        if (occupied_now[v->id] != nullptr || occupied_next[v->id] != nullptr)
+            return false;
+        for (const Agent &agent : agent_arena)
+        {
+            if (agent.goal == v)
+                return false;
+        }
+    }
+
+    if (graph.SetBlocked(v->id, blocked))
+    {
+        distance_cache.Repair(v->id);
+        SyncWithGraph();
+    }
+    return true;
+}
+
+// Catches up with passability changes, made here or by another planner sharing the graph. Tables
+// the cache repaired are already current; others, and the precomputed store, which describes the
+// original map, are replaced by tables built for the graph as it is now.
+void PIBT::SyncWithGraph()
+{
+    if (graph_revision == graph.revision)
+        return;
+    graph_revision = graph.revision;
+    distance_store.reset();
+
+    for (Agent &agent : agent_arena)
+    {
+        if (!distance_tables[agent.id] || distance_tables[agent.id]->revision != graph.revision)
+            AssignDistances(&agent);
+    }
+
+    // Unblocking can raise the degree bound
+    for (PlannerWorkspace &ws : workspaces)
+        ws.candidates.resize((std::size_t)(graph.max_degree + 1) * (agent_arena.size() + 1));
+    if (batched_candidates && graph.max_degree >= (int)kScoredCandidates)
+        batched_candidates = false;
+    if (batched_candidates)
+        ScoreAllCandidates();
+}
@@ -0,0 +1,49 @@
+#include "stats.h"
+
+#include <algorithm>
+
+void AccumulatePlanningStats(StepStats &total, const StepStats &part)
+{
+    total.calls += part.calls;
+    total.max_depth = std::max(total.max_depth, part.max_depth);
+    total.chains += part.chains;
+    total.chain_agents += part.chain_agents;
+    total.max_chain = std::max(total.max_chain, part.max_chain);
+    total.candidates += part.candidates;
+    total.backtracks += part.backtracks;
+}
+
+void WriteStatsCsv(std::ostream &out, const std::vector<StepStats> &history)
+{
+    out << "timestep,calls,max_depth,chains,chain_agents,max_chain,candidates,backtracks,waits,"
+           "update_seconds,sort_seconds,plan_seconds\n";
+    for (const StepStats &s : history)
+    {
+        out << s.timestep << ',' << s.calls << ',' << s.max_depth << ',' << s.chains << ','
+            << s.chain_agents << ',' << s.max_chain << ',' << s.candidates << ',' << s.backtracks << ','
+            << s.waits << ',' << s.update_seconds << ',' << s.sort_seconds << ',' << s.plan_seconds << '\n';
+    }
+}
+
+void WriteStatsJson(std::ostream &out, const std::vector<StepStats> &history)
+{
+    out << "[\n";
+    for (std::size_t i = 0; i < history.size(); ++i)
+    {
+        const StepStats &s = history[i];
+        out << "  {\"timestep\": " << s.timestep
+            << ", \"calls\": " << s.calls
+            << ", \"max_depth\": " << s.max_depth
+            << ", \"chains\": " << s.chains
+            << ", \"chain_agents\": " << s.chain_agents
+            << ", \"max_chain\": " << s.max_chain
+            << ", \"candidates\": " << s.candidates
+            << ", \"backtracks\": " << s.backtracks
+            << ", \"waits\": " << s.waits
+            << ", \"update_seconds\": " << s.update_seconds
+            << ", \"sort_seconds\": " << s.sort_seconds
+            << ", \"plan_seconds\": " << s.plan_seconds
+            << (i + 1 < history.size() ? "},\n" : "}\n");
+    }
+    out << "]\n";
+}
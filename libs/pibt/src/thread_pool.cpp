@@ -0,0 +1,139 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace
+{
+    uint64_t Pack(uint64_t next, uint64_t end)
+    {
+        return (end << 32) | next;
+    }
+}
+
+ThreadPool::ThreadPool(std::size_t num_threads)
+    : num_workers(num_threads ? num_threads : std::max(1u, std::thread::hardware_concurrency())),
+      slices(new Slice[num_workers])
+{
+    threads.reserve(num_workers - 1);
+    for (std::size_t worker = 1; worker < num_workers; ++worker)
+    {
+        threads.emplace_back(&ThreadPool::WorkerLoop, this, worker);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+void ThreadPool::ParallelFor(std::size_t count, const std::function<void(std::size_t, std::size_t)> &_task)
+{
+    if (count == 0)
+        return;
+
+    for (std::size_t worker = 0; worker < num_workers; ++worker)
+    {
+        uint64_t begin = count * worker / num_workers;
+        uint64_t end = count * (worker + 1) / num_workers;
+        slices[worker].bounds.store(Pack(begin, end), std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &_task;
+        running = threads.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    Run(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this]
+                  { return running == 0; });
+    task = nullptr;
+}
+
+// Claims the next index from the front of the worker's own slice
+bool ThreadPool::TakeOwn(std::size_t worker, std::size_t &index)
+{
+    std::atomic<uint64_t> &bounds = slices[worker].bounds;
+    uint64_t value = bounds.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        uint64_t next = value & 0xFFFFFFFFu, end = value >> 32;
+        if (next >= end)
+            return false;
+        if (bounds.compare_exchange_weak(value, Pack(next + 1, end), std::memory_order_acq_rel))
+        {
+            index = next;
+            return true;
+        }
+    }
+}
+
+// Claims the last index of another worker's slice
+bool ThreadPool::Steal(std::size_t victim, std::size_t &index)
+{
+    std::atomic<uint64_t> &bounds = slices[victim].bounds;
+    uint64_t value = bounds.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        uint64_t next = value & 0xFFFFFFFFu, end = value >> 32;
+        if (next >= end)
+            return false;
+        if (bounds.compare_exchange_weak(value, Pack(next, end - 1), std::memory_order_acq_rel))
+        {
+            index = end - 1;
+            return true;
+        }
+    }
+}
+
+void ThreadPool::Run(std::size_t worker)
+{
+    std::size_t index;
+    for (;;)
+    {
+        if (TakeOwn(worker, index))
+        {
+            (*task)(index, worker);
+            continue;
+        }
+
+        bool stolen = false;
+        for (std::size_t i = 1; i < num_workers && !stolen; ++i)
+            stolen = Steal((worker + i) % num_workers, index);
+        if (!stolen)
+            return;
+        (*task)(index, worker);
+    }
+}
+
+void ThreadPool::WorkerLoop(std::size_t worker)
+{
+    std::size_t seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]
+                      { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        Run(worker);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--running == 0)
+            finished.notify_one();
+    }
+}
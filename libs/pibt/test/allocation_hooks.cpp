@@ -0,0 +1,25 @@
+#include "allocation_hooks.h"
+#include <cstdlib>
+#include <new>
+
+bool counting_allocations = false;
+std::size_t allocation_count = 0;
+
+void *operator new(std::size_t size) {
+    if (counting_allocations) {
+        ++allocation_count;
+    }
+    void *p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
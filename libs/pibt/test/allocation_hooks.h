@@ -0,0 +1,7 @@
+#pragma once
+#include <cstddef>
+
+// Counts heap allocations made while counting_allocations is set. The replacement operator new and
+// delete live in their own translation unit, so the compiler never pairs free() with an inlined new.
+extern bool counting_allocations;
+extern std::size_t allocation_count;
@@ -4,8 +4,14 @@
 #include <chrono>
 #include <iomanip> 
 #include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <sstream>
 #include "pibt.h"
 #include "graph.h"
+#include "allocation_hooks.h"
 
 // A utility function to set up a simple 3x3 grid for testing
 std::vector<std::vector<int>> createStartGoalData() {
@@ -50,8 +56,8 @@ TEST(PIBTTest, HeuristicDistance) {
     PIBT pibt(3, 3, starts, goals);
 
     // Check the heuristic distance from (0, 0) to (2, 2)
-    Vertex* start = new Vertex(0, 0, (Direction) 0);
-    Vertex* goal = new Vertex(2, 2, (Direction) 0);
+    Vertex* start = new Vertex(0, 0);
+    Vertex* goal = new Vertex(2, 2);
 
     int heuristic = pibt.HeuristicDistance(start, goal);
     ASSERT_EQ(heuristic, 4);  // Manhattan distance between (0, 0) and (2, 2) is 4
@@ -107,6 +113,924 @@ TEST(PIBTTest, GoalReachingCondition) {
     ASSERT_EQ(agent1->v_now->y, 2);
 }
 
+// Test case 6: Verify the occupancy tables follow the agents
+TEST(PIBTTest, OccupancyTables) {
+    std::vector<std::vector<int>> starts = {{0, 0, 0}, {4, 0, 1}, {2, 2, 2}};
+    std::vector<std::vector<int>> goals = {{4, 4, 0}, {0, 4, 1}, {2, 0, 2}};
+    PIBT pibt(5, 5, starts, goals);
+
+    pibt.RunPibt();
+    ASSERT_FALSE(pibt.failed);
+
+    int occupied = 0;
+    for (Agent *agent : pibt.occupied_now) {
+        occupied += agent != nullptr;
+    }
+    ASSERT_EQ(occupied, 3);
+
+    for (Agent *agent : pibt.agents) {
+        ASSERT_EQ(pibt.occupied_now[agent->v_now->id], agent);
+        ASSERT_EQ(pibt.occupied_next[agent->v_next->id], agent);
+    }
+}
+
+// Test case 7: Verify agents route around obstacles
+TEST(PIBTTest, ObstacleMap) {
+    // Obstacles along the diagonal
+    std::vector<uint8_t> obstacles(25, 0);
+    for (int i = 1; i < 4; ++i) {
+        obstacles[i * 5 + i] = 1;
+    }
+    std::vector<std::vector<int>> starts = {{0, 0, 1}};
+    std::vector<std::vector<int>> goals = {{4, 4, 1}};
+    PIBT pibt(Graph(5, 5, obstacles), starts, goals);
+
+    pibt.RunPibt();
+    ASSERT_FALSE(pibt.failed);
+    for (PathEntry step : pibt.GetPath(0)) {
+        ASSERT_FALSE(pibt.graph.IsBlocked(step.vertex));
+    }
+
+    // Starts and goals on obstacles are rejected
+    std::vector<std::vector<int>> blocked_goal = {{2, 2, 0}};
+    EXPECT_THROW(PIBT(Graph(5, 5, obstacles), starts, blocked_goal), std::runtime_error);
+}
+
+// Test case 8: Verify BFS distance tables follow the obstacles
+TEST(PIBTTest, DistanceTable) {
+    // Wall across the middle row with a gap at x = 4
+    std::vector<uint8_t> obstacles(25, 0);
+    for (int x = 0; x < 4; ++x) {
+        obstacles[2 * 5 + x] = 1;
+    }
+    Graph graph(5, 5, obstacles);
+
+    DistanceTable table(graph, graph.GetId(0, 4));
+    EXPECT_EQ(table.distances[graph.GetId(0, 4)], 0);
+    EXPECT_EQ(table.distances[graph.GetId(4, 4)], 4);
+    EXPECT_EQ(table.distances[graph.GetId(0, 0)], 12);
+    EXPECT_EQ(table.distances[graph.GetId(1, 2)], DistanceTable::kUnreachable);
+}
+
+// Test case 9: Verify distance tables are shared per goal and evicted least recently used first
+TEST(PIBTTest, DistanceCacheEviction) {
+    Graph graph(10, 10);
+    const std::size_t table_bytes = graph.Size() * sizeof(uint16_t);
+    DistanceCache cache(graph, 2 * table_bytes);
+
+    auto first = cache.Get(0);
+    EXPECT_EQ(cache.Get(0), first);
+    cache.Get(1);
+    cache.Get(0); // 1 is now the least recently used
+    cache.Get(2);
+
+    EXPECT_EQ(cache.Size(), 2);
+    EXPECT_EQ(cache.MemoryUsage(), 2 * table_bytes);
+    EXPECT_EQ(cache.evictions, 1);
+    EXPECT_EQ(cache.Get(0), first);
+    EXPECT_EQ(cache.misses, 3);
+
+    cache.Get(1); // rebuilt after eviction
+    EXPECT_EQ(cache.misses, 4);
+}
+
+// Test case 10: Verify agents find their way out of dead ends around obstacles
+TEST(PIBTTest, ObstacleDetour) {
+    // Wall across the middle row with a gap at x = 4
+    std::vector<uint8_t> obstacles(25, 0);
+    for (int x = 0; x < 4; ++x) {
+        obstacles[2 * 5 + x] = 1;
+    }
+    std::vector<std::vector<int>> starts = {{0, 0, 1}, {1, 4, 0}};
+    std::vector<std::vector<int>> goals = {{0, 4, 1}, {1, 0, 0}};
+    PIBT pibt(Graph(5, 5, obstacles), starts, goals);
+
+    // Both agents share the distance table of their goal with any other agent heading there
+    EXPECT_EQ(pibt.distance_cache.Size(), 2);
+
+    pibt.RunPibt();
+    ASSERT_FALSE(pibt.failed);
+    for (Agent *agent : pibt.agents) {
+        ASSERT_EQ(agent->v_now, agent->goal);
+    }
+}
+
+// Test case 11: Verify the on-disk distance store matches the BFS tables and is used by the planner
+TEST(PIBTTest, DistanceStore) {
+    std::vector<uint8_t> obstacles(25, 0);
+    for (int x = 0; x < 4; ++x) {
+        obstacles[2 * 5 + x] = 1;
+    }
+    Graph graph(5, 5, obstacles);
+    std::string path = testing::TempDir() + "pibt_test.dist";
+
+    // Every free cell, built on several threads
+    BuildDistanceStore(graph, {}, path, 3);
+    {
+        DistanceStore store(path, graph);
+        EXPECT_EQ(store.NumGoals(), 21);
+        EXPECT_EQ(store.Find(graph.GetId(1, 2)), nullptr);
+        for (const Vertex &goal : graph.vertices) {
+            if (graph.IsBlocked(goal.id)) {
+                continue;
+            }
+            DistanceTable table(graph, goal.id);
+            const uint16_t *stored = store.Find(goal.id);
+            ASSERT_NE(stored, nullptr);
+            ASSERT_TRUE(std::equal(table.distances.begin(), table.distances.end(), stored));
+        }
+
+        // A store is tied to the map it was built for
+        EXPECT_THROW(DistanceStore(path, Graph(5, 5)), std::runtime_error);
+    }
+
+    // Only some goals: agents whose goal is stored skip the cache
+    BuildDistanceStore(graph, {graph.GetId(0, 4)}, path);
+    PibtOptions options;
+    options.distance_store_path = path;
+    std::vector<std::vector<int>> starts = {{0, 0, 1}, {1, 4, 0}};
+    std::vector<std::vector<int>> goals = {{0, 4, 1}, {1, 0, 0}};
+    PIBT pibt(graph, starts, goals, options);
+    EXPECT_EQ(pibt.distance_cache.Size(), 1);
+
+    pibt.RunPibt();
+    ASSERT_FALSE(pibt.failed);
+    std::remove(path.c_str());
+}
+
+// Test case 12: Verify lifelong stepping with goal reassignment
+TEST(PIBTTest, LifelongStep) {
+    std::vector<std::vector<int>> starts = {{0, 0, 1}, {4, 4, 0}};
+    std::vector<std::vector<int>> goals = {{0, 2, 1}, {4, 0, 0}};
+    PIBT pibt(5, 5, starts, goals);
+    Agent *agent = pibt.GetAgent(0);
+
+    // Each Step executes the previous plan and plans the next move
+    pibt.Step();
+    EXPECT_EQ(pibt.timesteps, 1);
+    EXPECT_EQ(agent->v_now, agent->start);
+    ASSERT_NE(agent->v_next, nullptr);
+
+    int steps = 1;
+    while (pibt.arrived.empty() || pibt.arrived[0] != agent) {
+        pibt.Step();
+        ASSERT_LT(++steps, 100);
+    }
+    EXPECT_EQ(agent->v_now->x, 0);
+    EXPECT_EQ(agent->v_now->y, 2);
+    EXPECT_GE(pibt.tasks_completed, 1);
+
+    // A new goal keeps position, heading and priority
+    float priority = agent->priority;
+    Direction heading = agent->current_direction;
+    Vertex *position = agent->v_now;
+    pibt.SetGoal(0, 4, 2);
+    EXPECT_FALSE(agent->reached_goal);
+    EXPECT_EQ(agent->priority, priority);
+    EXPECT_EQ(agent->current_direction, heading);
+    EXPECT_EQ(agent->v_now, position);
+
+    std::size_t completed = pibt.tasks_completed;
+    while (!agent->reached_goal) {
+        pibt.Step();
+        ASSERT_LT(++steps, 200);
+    }
+    EXPECT_EQ(agent->v_now, pibt.graph.GetVertex(4, 2));
+    EXPECT_GT(pibt.tasks_completed, completed);
+
+    EXPECT_THROW(pibt.SetGoal(2, 0, 0), std::out_of_range);
+    EXPECT_THROW(pibt.SetGoal(0, 5, 0), std::runtime_error);
+}
+
+// Test case 13: Verify the recorded paths line up with the timesteps
+TEST(PIBTTest, PathStore) {
+    std::vector<std::vector<int>> starts = {{0, 0, 1}, {4, 0, 1}};
+    std::vector<std::vector<int>> goals = {{0, 4, 1}, {4, 4, 1}};
+    PibtOptions options;
+    options.path_chunk_timesteps = 3; // force several chunks
+    PIBT pibt(5, 5, starts, goals, options);
+
+    pibt.RunPibt();
+    ASSERT_FALSE(pibt.failed);
+    ASSERT_EQ(pibt.paths.NumTimesteps(), (std::size_t)pibt.timesteps + 1);
+
+    for (Agent *agent : pibt.agents) {
+        PathView path = pibt.GetPath(agent->id);
+        EXPECT_EQ(path.front().vertex, agent->start->id);
+        EXPECT_EQ(path.front().heading, Direction::Down);
+        EXPECT_EQ(path.back().vertex, agent->v_now->id);
+        EXPECT_EQ(path.back().heading, agent->current_direction);
+
+        // Consecutive states are the same or adjacent vertices
+        for (std::size_t t = 1; t < path.size(); ++t) {
+            int from = path[t - 1].vertex, to = path[t].vertex;
+            bool adjacent = from == to;
+            for (const Neighbor &n : pibt.graph.GetNeighbors(from)) {
+                adjacent |= n.id == to;
+            }
+            ASSERT_TRUE(adjacent);
+        }
+    }
+
+    // Rows hold every agent's vertex at one timestep
+    Span<const int32_t> last = pibt.paths.Vertices(pibt.timesteps);
+    EXPECT_EQ(last[0], pibt.graph.GetId(0, 4));
+    EXPECT_EQ(last[1], pibt.graph.GetId(4, 4));
+
+    // A bounded history reuses a fixed ring of chunks for the latest rows
+    PathStore ring(2, 4, 6);
+    for (int t = 0; t < 50; ++t) {
+        std::size_t row = ring.AppendRow();
+        ring.Vertices(row)[0] = t;
+        ring.Vertices(row)[1] = -t;
+        ring.Headings(row)[0] = ring.Headings(row)[1] = Direction::Up;
+    }
+    EXPECT_EQ(ring.NumTimesteps(), 50);
+    EXPECT_EQ(ring.FirstTimestep(), 40);
+    EXPECT_EQ(ring.MemoryUsage(), 3 * 4 * 2 * (sizeof(int32_t) + sizeof(Direction)));
+    PathView view = ring.Path(1);
+    EXPECT_EQ(view.size(), 10);
+    EXPECT_EQ(view.front().vertex, -40);
+    EXPECT_EQ(view.back().vertex, -49);
+}
+
+// Test case 14: Verify a steady-state timestep does not touch the heap
+TEST(PIBTTest, ZeroAllocationStep) {
+    std::vector<std::vector<int>> starts, goals;
+    for (int i = 0; i < 10; ++i) {
+        starts.push_back({i, 0, 1});
+        goals.push_back({9 - i, 9, 1});
+    }
+    PibtOptions options;
+    options.path_chunk_timesteps = 1024;
+    PIBT pibt(10, 10, starts, goals, options);
+
+    pibt.Step(); // plans the first moves
+    pibt.stats_history.reserve(64); // only grows in PIBT_ENABLE_STATS builds
+    allocation_count = 0;
+    counting_allocations = true;
+    for (int t = 0; t < 20; ++t) {
+        pibt.Step();
+    }
+    counting_allocations = false;
+    EXPECT_EQ(allocation_count, 0);
+}
+
+// Test case 15: Verify the per-timestep counters and their exports
+TEST(PIBTTest, StepStats) {
+    std::vector<std::vector<int>> starts = {{0, 0, 1}, {0, 1, 1}, {0, 2, 1}};
+    std::vector<std::vector<int>> goals = {{0, 4, 1}, {0, 3, 1}, {0, 2, 1}};
+    PIBT pibt(5, 5, starts, goals);
+    pibt.RunPibt();
+    ASSERT_FALSE(pibt.failed);
+
+    if (kPibtStatsEnabled) {
+        ASSERT_EQ(pibt.stats_history.size(), (std::size_t)pibt.timesteps);
+        std::size_t calls = 0;
+        for (const StepStats &s : pibt.stats_history) {
+            EXPECT_EQ(s.chain_agents, s.calls);
+            EXPECT_LE(s.max_chain, 3);
+            EXPECT_GE(s.candidates, s.calls);
+            calls += s.calls;
+        }
+        // The first timestep plans all three agents
+        EXPECT_EQ(pibt.stats_history[0].calls, 3);
+        EXPECT_GT(calls, 0);
+    } else {
+        EXPECT_TRUE(pibt.stats_history.empty());
+    }
+
+    std::vector<StepStats> history(2);
+    history[1].timestep = 1;
+    history[1].backtracks = 7;
+    std::ostringstream csv, json;
+    WriteStatsCsv(csv, history);
+    WriteStatsJson(json, history);
+    EXPECT_EQ(csv.str().substr(0, 15), "timestep,calls,");
+    EXPECT_NE(csv.str().find("\n1,0,0,0,0,0,0,7,"), std::string::npos);
+    EXPECT_NE(json.str().find("\"backtracks\": 7"), std::string::npos);
+}
+
+// Test case 16: Verify the incrementally kept planning order matches a full sort
+TEST(PIBTTest, IncrementalOrder) {
+    std::vector<std::vector<int>> starts, goals;
+    for (int i = 0; i < 40; ++i) {
+        starts.push_back({i % 10, i / 10, 0});
+        goals.push_back({9 - i % 10, 9 - i / 10, 0});
+    }
+    PibtOptions options;
+    options.seed = 3;
+    PIBT pibt(10, 10, starts, goals, options);
+
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> coordinate(0, 9);
+    for (int t = 0; t < 200; ++t) {
+        pibt.Step();
+        ASSERT_EQ(pibt.agents.size(), starts.size());
+
+        std::vector<Agent *> expected = pibt.agents;
+        std::sort(expected.begin(), expected.end(), [](const Agent *a, const Agent *b)
+                  { return a->priority > b->priority; });
+        ASSERT_EQ(pibt.agents, expected) << "timestep " << t;
+
+        std::size_t travelling = 0;
+        Span<const int32_t> row = pibt.paths.Vertices(pibt.paths.NumTimesteps() - 1);
+        for (const Agent &agent : pibt.agent_arena) {
+            ASSERT_EQ(row[agent.id], agent.v_now->id);
+            travelling += !agent.reached_goal;
+            EXPECT_EQ(agent.priority < 1.0f, agent.v_now == agent.goal);
+        }
+        ASSERT_EQ(pibt.num_travelling, travelling);
+
+        // Keep some agents busy, and disturb the order once
+        if (t < 150 && !pibt.arrived.empty())
+            pibt.SetGoal(pibt.arrived[0]->id, coordinate(rng), coordinate(rng));
+        if (t == 50)
+            pibt.SortAgentsById();
+    }
+}
+
+// Test case 17: Verify the iterative engine makes the same moves as the recursive one
+TEST(PIBTTest, IterativeEngine) {
+    auto run = [](PibtEngine engine, const std::vector<std::vector<int>> &starts,
+                  const std::vector<std::vector<int>> &goals, int w, int h, int steps) {
+        PibtOptions options;
+        options.seed = 7;
+        options.engine = engine;
+        PIBT pibt(w, h, starts, goals, options);
+        std::mt19937 rng(11);
+        std::vector<int> moves;
+        for (int t = 0; t < steps; ++t) {
+            pibt.Step();
+            for (const Agent &agent : pibt.agent_arena) {
+                moves.push_back(agent.v_next->id);
+                moves.push_back(agent.current_direction);
+            }
+            for (Agent *agent : pibt.arrived)
+                pibt.SetGoal(agent->id, rng() % w, rng() % h);
+        }
+        return moves;
+    };
+
+    // Dense lifelong traffic
+    std::vector<std::vector<int>> starts, goals;
+    for (int i = 0; i < 60; ++i) {
+        starts.push_back({i % 10, i / 10, i % 4});
+        goals.push_back({(i * 7) % 10, (i * 3) % 10, 0});
+    }
+    EXPECT_EQ(run(PibtEngine::Recursive, starts, goals, 10, 10, 150),
+              run(PibtEngine::Iterative, starts, goals, 10, 10, 150));
+
+    // A corridor where one agent pushes a chain of 2000
+    starts.clear();
+    goals.clear();
+    for (int i = 0; i < 2000; ++i) {
+        starts.push_back({i, 0, (int)Direction::Right});
+        goals.push_back({i + 1, 0, (int)Direction::Right});
+    }
+    EXPECT_EQ(run(PibtEngine::Recursive, starts, goals, 2001, 1, 5),
+              run(PibtEngine::Iterative, starts, goals, 2001, 1, 5));
+}
+
+// Test case 18: Verify cluster-parallel planning matches planning on one thread
+TEST(PIBTTest, ParallelPlanning) {
+    // Sparse agents on an open map, so there are many clusters
+    std::vector<std::vector<int>> starts, goals;
+    for (int i = 0; i < 300; ++i) {
+        starts.push_back({(i * 7) % 60, (i * 13) % 60, i % 4});
+        goals.push_back({(i * 11) % 60, (i * 17 + 5) % 60, 0});
+    }
+    auto run = [&](std::size_t num_threads) {
+        PibtOptions options;
+        options.seed = 2;
+        options.num_threads = num_threads;
+        PIBT pibt(60, 60, starts, goals, options);
+        std::mt19937 rng(4);
+        std::vector<int> moves;
+        for (int t = 0; t < 120; ++t) {
+            pibt.Step();
+            if (num_threads != 1 && t == 0) {
+                EXPECT_GT(pibt.num_clusters, 1);
+            }
+            for (const Agent &agent : pibt.agent_arena) {
+                moves.push_back(agent.v_next->id);
+                moves.push_back(agent.current_direction);
+            }
+            for (Agent *agent : pibt.arrived)
+                pibt.SetGoal(agent->id, rng() % 60, rng() % 60);
+        }
+        return moves;
+    };
+    std::vector<int> serial = run(1);
+    EXPECT_EQ(serial, run(2));
+    EXPECT_EQ(serial, run(4));
+
+    // Every index runs exactly once, whichever worker claims it
+    ThreadPool pool(3);
+    std::vector<int> visits(1000, 0);
+    pool.ParallelFor(visits.size(), [&](std::size_t index, std::size_t worker) {
+        ASSERT_LT(worker, pool.Size());
+        ++visits[index];
+    });
+    EXPECT_EQ(std::count(visits.begin(), visits.end(), 1), 1000);
+}
+
+// Test case 19: Verify planners can share a graph and distance cache
+TEST(PIBTTest, SharedGraph) {
+    auto graph = std::make_shared<Graph>(5, 5);
+    auto cache = std::make_shared<DistanceCache>(*graph);
+    std::vector<std::vector<int>> starts = {{0, 0, 1}, {4, 4, 0}};
+    std::vector<std::vector<int>> goals = {{0, 2, 1}, {4, 0, 0}};
+
+    PIBT first(graph, starts, goals, PibtOptions(), cache);
+    PIBT second(graph, starts, goals, PibtOptions(), cache);
+    EXPECT_EQ(&first.graph, &second.graph);
+    EXPECT_EQ(&first.distance_cache, &second.distance_cache);
+    EXPECT_EQ(cache->misses, 2);
+    EXPECT_EQ(cache->hits, 2);
+
+    // Each agent waits one pipelined timestep, then walks its four or two cells
+    first.RunPibt();
+    ASSERT_FALSE(first.failed);
+    EXPECT_EQ(first.SumOfCosts(), 3 + 5);
+    EXPECT_GT(first.MemoryUsage(), first.paths.MemoryUsage());
+
+    Graph other(5, 5);
+    EXPECT_THROW(PIBT(graph, starts, goals, PibtOptions(), std::make_shared<DistanceCache>(other)),
+                 std::invalid_argument);
+}
+
+// Test case 20: Verify the motion models' turning rules and rotation cost
+TEST(PIBTTest, MotionModels) {
+    // Facing Up, the agent backs down to (0, 3) and must turn once to head right to (3, 3)
+    std::vector<std::vector<int>> starts = {{0, 0, (int)Direction::Up}};
+    std::vector<std::vector<int>> goals = {{3, 3, 0}};
+    auto run = [&](MotionModel model, int rotation_steps) {
+        PibtOptions options;
+        options.motion_model = model;
+        options.rotation_steps = rotation_steps;
+        PIBT pibt(4, 4, starts, goals, options);
+        pibt.RunPibt();
+        EXPECT_FALSE(pibt.failed);
+        return pibt.timesteps;
+    };
+    const int holonomic = run(MotionModel::Holonomic, 1);
+    EXPECT_EQ(run(MotionModel::RotateThenMove, 1), holonomic + 1);
+    EXPECT_EQ(run(MotionModel::RotateThenMove, 3), holonomic + 3);
+    EXPECT_THROW(run(MotionModel::RotateThenMove, 0), std::invalid_argument);
+
+    // Holonomic agents never turn in place and face the way they last moved
+    std::vector<std::vector<int>> many_starts, many_goals;
+    for (int i = 0; i < 40; ++i) {
+        many_starts.push_back({i % 10, i / 10, i % 4});
+        many_goals.push_back({(i * 7) % 10, 9 - (i * 3) % 10, 0});
+    }
+    for (PibtEngine engine : {PibtEngine::Recursive, PibtEngine::Iterative}) {
+        PibtOptions options;
+        options.seed = 3;
+        options.engine = engine;
+        options.motion_model = MotionModel::Holonomic;
+        PIBT pibt(10, 10, many_starts, many_goals, options);
+        pibt.RunPibt();
+        ASSERT_FALSE(pibt.failed);
+        for (int id = 0; id < 40; ++id) {
+            PathView path = pibt.GetPath(id);
+            for (std::size_t t = 1; t < path.size(); ++t) {
+                if (path[t].vertex == path[t - 1].vertex) {
+                    EXPECT_EQ(path[t].heading, path[t - 1].heading);
+                    continue;
+                }
+                bool adjacent = false;
+                for (const Neighbor &n : pibt.graph.GetNeighbors(path[t - 1].vertex))
+                    adjacent |= n.id == path[t].vertex && n.direction == path[t].heading;
+                EXPECT_TRUE(adjacent) << "agent " << id << " at t=" << t;
+            }
+        }
+    }
+}
+
+// Test case 21: Verify the per-Step time budget and its wait-in-place fallback
+TEST(PIBTTest, StepBudget) {
+    std::vector<std::vector<int>> starts, goals;
+    for (int i = 0; i < 40; ++i) {
+        starts.push_back({i % 10, i / 10, i % 4});
+        goals.push_back({(i * 7) % 10, 9 - (i * 3) % 10, 0});
+    }
+    auto run = [&](double budget) {
+        PibtOptions options;
+        options.seed = 5;
+        options.step_budget_seconds = budget;
+        PIBT pibt(10, 10, starts, goals, options);
+        std::vector<int> moves;
+        for (int t = 0; t < 30; ++t) {
+            pibt.Step();
+            for (const Agent &agent : pibt.agent_arena)
+                moves.push_back(agent.v_next->id);
+        }
+        EXPECT_EQ(pibt.degraded_steps, budget > 0.0 && budget < 1e-6 ? 30u : 0u);
+        return moves;
+    };
+    // A generous budget changes nothing; an exhausted one leaves every agent where it started
+    EXPECT_EQ(run(0.0), run(10.0));
+    std::vector<int> frozen = run(1e-9);
+    for (std::size_t i = 0; i < frozen.size(); ++i)
+        EXPECT_EQ(frozen[i], starts[i % 40][1] * 10 + starts[i % 40][0]);
+
+    // A chain cut short mid-way leaves all of its agents unplanned and no reservation behind
+    std::vector<std::vector<int>> corridor_starts, corridor_goals;
+    for (int i = 0; i < 50; ++i) {
+        corridor_starts.push_back({i, 0, (int)Direction::Right});
+        corridor_goals.push_back({i + 1, 0, (int)Direction::Right});
+    }
+    for (PibtEngine engine : {PibtEngine::Recursive, PibtEngine::Iterative}) {
+        PibtOptions options;
+        options.engine = engine;
+        PIBT pibt(51, 1, corridor_starts, corridor_goals, options);
+        PlannerWorkspace &ws = pibt.workspaces[0];
+        ws.deadline = std::chrono::steady_clock::now();
+        ws.clock_countdown = 10; // the clock is first read ten agents into the chain
+        pibt.PlanAgent(ws, pibt.GetAgent(0));
+        EXPECT_TRUE(ws.out_of_time);
+        EXPECT_EQ(ws.top, 0u);
+        for (const Agent &agent : pibt.agent_arena)
+            EXPECT_EQ(agent.v_next, nullptr) << "agent " << agent.id;
+        EXPECT_EQ(std::count(pibt.occupied_next.begin(), pibt.occupied_next.end(), nullptr),
+                  (long)pibt.occupied_next.size());
+    }
+}
+
+// Test case 22: Verify batched candidate ordering matches a stable per-agent sort
+TEST(PIBTTest, CandidateOrdering) {
+    // Lanes with few distinct distances, so ties are common, and some missing neighbours
+    const std::size_t lanes = 1000;
+    std::mt19937 rng(9);
+    std::vector<uint32_t> keys(kScoredCandidates * lanes), orders(lanes);
+    std::vector<std::vector<uint32_t>> expected(lanes);
+    for (std::size_t i = 0; i < lanes; ++i) {
+        for (uint32_t slot = 0; slot < kScoredCandidates; ++slot) {
+            uint32_t key = slot != kWaitSlot && rng() % 6 == 0 ? kNoCandidate : CandidateKey(rng() % 3, slot);
+            keys[slot * lanes + i] = key;
+            if (key != kNoCandidate)
+                expected[i].push_back(slot);
+        }
+        std::stable_sort(expected[i].begin(), expected[i].end(), [&](uint32_t a, uint32_t b) {
+            return keys[a * lanes + i] >> 3 < keys[b * lanes + i] >> 3;
+        });
+    }
+    SortCandidates(keys.data(), lanes, 3, lanes, orders.data()); // a ragged start exercises the tail loop
+    for (std::size_t i = 3; i < lanes; ++i) {
+        std::vector<uint32_t> slots;
+        for (uint32_t order = orders[i]; (order & 7) != kOrderEnd; order >>= 3)
+            slots.push_back(order & 7);
+        EXPECT_EQ(slots, expected[i]) << "lane " << i;
+    }
+
+    // The planner makes the same moves with the per-agent sort
+    std::vector<std::vector<int>> starts, goals;
+    for (int i = 0; i < 60; ++i) {
+        starts.push_back({i % 10, i / 10, i % 4});
+        goals.push_back({(i * 7) % 10, (i * 3) % 10, 0});
+    }
+    auto run = [&](bool batched) {
+        PibtOptions options;
+        options.seed = 7;
+        PIBT pibt(10, 10, starts, goals, options);
+        EXPECT_TRUE(pibt.batched_candidates);
+        pibt.batched_candidates = batched;
+        std::vector<int> moves;
+        for (int t = 0; t < 100; ++t) {
+            pibt.Step();
+            for (const Agent &agent : pibt.agent_arena)
+                moves.push_back(agent.v_next->id * 8 + agent.current_direction);
+            for (Agent *agent : pibt.arrived)
+                pibt.SetGoal(agent->id, rng() % 10, rng() % 10);
+        }
+        return moves;
+    };
+    std::mt19937 saved = rng;
+    std::vector<int> batched = run(true);
+    rng = saved;
+    EXPECT_EQ(batched, run(false));
+}
+
+// Test case 23: Verify runtime obstacles and the incremental distance repair
+TEST(PIBTTest, DynamicObstacles) {
+    // Repaired tables match a BFS from scratch after every change
+    std::mt19937 rng(12);
+    std::vector<uint8_t> obstacles(24 * 20, 0);
+    for (auto &cell : obstacles)
+        cell = rng() % 4 == 0;
+    Graph graph(24, 20, obstacles);
+    std::vector<int> goals;
+    while (goals.size() < 6) {
+        int goal = rng() % graph.Size();
+        if (!graph.IsBlocked(goal))
+            goals.push_back(goal);
+    }
+    std::vector<std::vector<uint16_t>> tables;
+    for (int goal : goals)
+        tables.push_back(DistanceTable(graph, goal).distances);
+    DistanceRepair repair;
+    for (int i = 0; i < 300; ++i) {
+        int cell = rng() % graph.Size();
+        if (std::find(goals.begin(), goals.end(), cell) != goals.end())
+            continue;
+        ASSERT_TRUE(graph.SetBlocked(cell, !graph.IsBlocked(cell)));
+        for (std::size_t g = 0; g < goals.size(); ++g) {
+            RepairDistances(graph, goals[g], cell, tables[g].data(), repair);
+            ASSERT_EQ(tables[g], DistanceTable(graph, goals[g]).distances) << "change " << i << " goal " << g;
+        }
+    }
+
+    // A single obstacle in an open room only changes the cells in its shadow
+    Graph open(50, 50);
+    std::vector<uint16_t> distances = DistanceTable(open, open.GetId(0, 25)).distances;
+    open.SetBlocked(open.GetId(10, 25), true);
+    EXPECT_LT(RepairDistances(open, open.GetId(0, 25), open.GetId(10, 25), distances.data(), repair), 100u);
+    EXPECT_EQ(distances[open.GetId(11, 25)], 13);
+
+    // The planner refuses cells in use, and its agents route around new walls
+    std::vector<std::vector<int>> starts = {{0, 0, 1}, {9, 0, 1}};
+    std::vector<std::vector<int>> agent_goals = {{0, 9, 1}, {9, 9, 1}};
+    PIBT pibt(10, 10, starts, agent_goals);
+    EXPECT_FALSE(pibt.SetBlocked(0, 0, true));
+    EXPECT_FALSE(pibt.SetBlocked(9, 9, true));
+    EXPECT_THROW(pibt.SetBlocked(10, 0, true), std::out_of_range);
+    const std::size_t misses = pibt.distance_cache.misses;
+    for (int x = 0; x < 9; ++x)
+        EXPECT_TRUE(pibt.SetBlocked(x, 5, true));
+    EXPECT_EQ(pibt.distance_cache.misses, misses); // repaired, not rebuilt
+    EXPECT_EQ(pibt.GetAgent(0)->distances[pibt.graph.GetId(0, 0)], 9 + 9 + 9);
+    pibt.RunPibt();
+    ASSERT_FALSE(pibt.failed);
+    for (int id = 0; id < 2; ++id) {
+        for (const PathEntry &state : pibt.GetPath(id))
+            EXPECT_FALSE(pibt.graph.IsBlocked(state.vertex));
+    }
+    EXPECT_TRUE(pibt.SetBlocked(4, 5, false));
+    EXPECT_EQ(pibt.GetAgent(0)->distances[pibt.graph.GetId(0, 0)], 4 + 4 + 9);
+}
+
+// Test case 24: Verify the cluster hierarchy heuristic
+TEST(PIBTTest, ClusterHierarchy) {
+    // Never below the true distance, exact near the goal, and reachability preserved
+    std::mt19937 rng(24);
+    std::vector<uint8_t> obstacles(70 * 45, 0);
+    for (auto &cell : obstacles)
+        cell = rng() % 5 == 0;
+    Graph graph(70, 45, obstacles);
+    ClusterHierarchy hierarchy(graph, 8);
+    EXPECT_EQ(hierarchy.NumClusters(), 9u * 6u);
+    std::size_t exact = 0, open = 0;
+    for (int g = 0; g < 12; ++g) {
+        int goal = rng() % graph.Size();
+        if (graph.IsBlocked(goal))
+            continue;
+        DistanceTable table(graph, goal);
+        auto clusters = hierarchy.Get(goal);
+        for (int v = 0; v < (int)graph.Size(); ++v) {
+            if (graph.IsBlocked(v))
+                continue;
+            const uint16_t d = hierarchy.Distance(*clusters, v);
+            const uint16_t expected = table.distances[v];
+            ASSERT_EQ(d == DistanceTable::kUnreachable, expected == DistanceTable::kUnreachable) << "goal " << goal << " cell " << v;
+            ASSERT_GE(d, expected);
+            const Vertex &a = graph.vertices[v], &b = graph.vertices[goal];
+            if (a.x / 8 == b.x / 8 && a.y / 8 == b.y / 8 && d != DistanceTable::kUnreachable && expected < 8) {
+                EXPECT_EQ(d, expected);
+            }
+            exact += d == expected;
+            ++open;
+        }
+    }
+    EXPECT_GT(exact * 2, open);
+    EXPECT_EQ(hierarchy.Get(graph.GetId(0, 0)), hierarchy.Get(graph.GetId(0, 0)));
+    EXPECT_GT(hierarchy.hits, 0u);
+    EXPECT_THROW(ClusterHierarchy(graph, 12), std::invalid_argument);
+
+    // The planner runs on it, and rejects runtime obstacles with it
+    Graph room(40, 40);
+    std::vector<std::vector<int>> starts, goals;
+    for (int i = 0; i < 30; ++i) {
+        starts.push_back({i, 0, 1});
+        goals.push_back({39 - i, 39, 1});
+    }
+    PibtOptions options;
+    options.heuristic = DistanceHeuristic::Clusters;
+    options.cluster_size = 8;
+    options.seed = 1;
+    PIBT pibt(room, starts, goals, options);
+    ASSERT_NE(pibt.hierarchy, nullptr);
+    EXPECT_EQ(pibt.GetAgent(0)->distances, nullptr);
+    EXPECT_EQ(pibt.Distance(pibt.GetAgent(0), pibt.GetAgent(0)->v_now), 39 + 39);
+    pibt.RunPibt();
+    EXPECT_FALSE(pibt.failed);
+    EXPECT_TRUE(pibt.AllReached());
+    EXPECT_THROW(pibt.SetBlocked(5, 5, true), std::logic_error);
+}
+
+// Test case 25: Verify flat-array input and reusing a planner across queries
+TEST(PIBTTest, ResetReusesPlanner) {
+    std::mt19937 rng(25);
+    std::vector<uint8_t> obstacles(16 * 16, 0);
+    for (auto &cell : obstacles)
+        cell = rng() % 8 == 0;
+    auto graph = std::make_shared<Graph>(16, 16, obstacles);
+    std::vector<int32_t> free;
+    for (const Vertex &v : graph->vertices)
+        if (!graph->IsBlocked(v.id))
+            free.push_back(v.id);
+    std::shuffle(free.begin(), free.end(), rng);
+    const int n = 24;
+    std::vector<int32_t> starts_a(free.begin(), free.begin() + n), goals_a(free.begin() + n, free.begin() + 2 * n);
+    std::vector<int32_t> starts_b = goals_a, goals_b = starts_a, headings(n, Direction::Left);
+    auto span = [](const std::vector<int32_t> &v) { return Span<const int32_t>(v.data(), v.size()); };
+
+    PibtOptions options;
+    options.seed = 7;
+    PIBT fresh(graph, span(starts_a), span(goals_a), span(headings), options);
+    fresh.RunPibt();
+    ASSERT_FALSE(fresh.failed);
+
+    // The same query after another one plans exactly as a fresh planner
+    PIBT pibt(graph, span(starts_b), span(goals_b), span(headings), options, fresh.shared_distance_cache);
+    pibt.RunPibt();
+    pibt.Reset(span(starts_a), span(goals_a), span(headings), 7);
+    EXPECT_EQ(pibt.timesteps, 0);
+    pibt.RunPibt();
+    ASSERT_FALSE(pibt.failed);
+    EXPECT_EQ(pibt.timesteps, fresh.timesteps);
+    for (int id = 0; id < n; ++id) {
+        PathView a = pibt.GetPath(id), b = fresh.GetPath(id);
+        ASSERT_EQ(a.size(), b.size());
+        for (std::size_t t = 0; t < a.size(); ++t) {
+            ASSERT_EQ(a[t].vertex, b[t].vertex) << "agent " << id << " timestep " << t;
+            ASSERT_EQ(a[t].heading, b[t].heading) << "agent " << id << " timestep " << t;
+        }
+    }
+
+    // Matches the coordinate constructor, and a repeated query does not allocate
+    std::vector<std::vector<int>> starts, goals;
+    for (int i = 0; i < n; ++i) {
+        const Vertex &s = graph->vertices[starts_a[i]], &g = graph->vertices[goals_a[i]];
+        starts.push_back({s.x, s.y, Direction::Left});
+        goals.push_back({g.x, g.y, Direction::Left});
+    }
+    PIBT by_coordinates(graph, starts, goals, options);
+    by_coordinates.RunPibt();
+    EXPECT_EQ(by_coordinates.SumOfCosts(), fresh.SumOfCosts());
+
+    pibt.stats_history.reserve(4096);
+    allocation_count = 0;
+    counting_allocations = true;
+    pibt.Reset(span(starts_a), span(goals_a), span(headings), 7);
+    counting_allocations = false;
+    EXPECT_EQ(allocation_count, 0);
+
+    // Nor does a whole run with fewer agents, which reuses the path chunks
+    pibt.RunPibt();
+    auto half = [&](const std::vector<int32_t> &v) { return Span<const int32_t>(v.data(), n / 2); };
+    allocation_count = 0;
+    counting_allocations = true;
+    pibt.Reset(half(starts_a), half(goals_a), half(headings), 7);
+    pibt.RunPibt();
+    counting_allocations = false;
+    EXPECT_FALSE(pibt.failed);
+    EXPECT_EQ(pibt.agents.size(), (std::size_t)n / 2);
+    EXPECT_EQ(allocation_count, 0);
+
+    std::vector<int32_t> blocked = starts_a;
+    blocked[3] = (int32_t)std::distance(obstacles.begin(), std::find(obstacles.begin(), obstacles.end(), 1));
+    EXPECT_THROW(pibt.Reset(span(blocked), span(goals_a), span(headings), 7), std::runtime_error);
+    EXPECT_THROW(pibt.Reset(span(starts_a), Span<const int32_t>(goals_a.data(), n - 1), span(headings), 7), std::invalid_argument);
+}
+
+// Test case 26: Verify planning on a directed roadmap
+TEST(PIBTTest, DirectedRoadmap) {
+    // One-way ring clockwise around the border of a 4x4 square, and an elevator at its corner
+    std::vector<Vertex> points = {Vertex(0, 0), Vertex(1, 0), Vertex(2, 0), Vertex(3, 0), Vertex(3, 1), Vertex(3, 2),
+                                  Vertex(3, 3), Vertex(2, 3), Vertex(1, 3), Vertex(0, 3), Vertex(0, 2), Vertex(0, 1), Vertex(0, 0)};
+    std::vector<int32_t> sources, targets;
+    for (int32_t v = 0; v < 12; ++v) {
+        sources.push_back(v);
+        targets.push_back((v + 1) % 12);
+    }
+    sources.insert(sources.end(), {0, 12});
+    targets.insert(targets.end(), {12, 0});
+    auto span = [](const std::vector<int32_t> &v) { return Span<const int32_t>(v.data(), v.size()); };
+    auto graph = std::make_shared<Graph>(points, true, span(sources), span(targets));
+
+    // Distances follow the lanes: one step ahead of the goal is a lap away
+    DistanceTable table(*graph, 0);
+    EXPECT_EQ(table.distances[11], 1);
+    EXPECT_EQ(table.distances[1], 11);
+    EXPECT_EQ(table.distances[12], 1);
+
+    const std::vector<int32_t> starts = {0, 3, 6, 9, 12}, goals = {2, 5, 8, 11, 0};
+    const std::vector<int32_t> headings(starts.size(), Direction::Up);
+    for (MotionModel model : {MotionModel::RotateThenMove, MotionModel::Holonomic}) {
+        PibtOptions options;
+        options.motion_model = model;
+        PIBT pibt(graph, span(starts), span(goals), span(headings), options);
+        pibt.RunPibt();
+        ASSERT_FALSE(pibt.failed);
+        for (int id = 0; id < (int)starts.size(); ++id) {
+            PathView path = pibt.GetPath(id);
+            EXPECT_EQ(path[path.size() - 1].vertex, goals[id]);
+            for (std::size_t t = 1; t < path.size(); ++t) {
+                if (path[t].vertex == path[t - 1].vertex)
+                    continue;
+                Span<const Neighbor> row = graph->GetNeighbors(path[t - 1].vertex);
+                auto edge = std::find_if(row.begin(), row.end(), [&](const Neighbor &n) { return n.id == path[t].vertex; });
+                ASSERT_NE(edge, row.end()) << "agent " << id << " timestep " << t;
+                if (edge->direction == Direction::None) {
+                    EXPECT_EQ(path[t].heading, path[t - 1].heading);
+                }
+            }
+        }
+    }
+
+    PibtOptions clusters;
+    clusters.heuristic = DistanceHeuristic::Clusters;
+    EXPECT_THROW(PIBT(graph, span(starts), span(goals), span(headings), clusters), std::invalid_argument);
+}
+
+// Test case 27: Verify a failed push leaves the rest of a turn in progress
+TEST(PIBTTest, PushMidTurn) {
+    // A pushes B, which is turning, towards C at the dead end of a corridor; C cannot give way
+    std::vector<std::vector<int>> starts = {{0, 0, Direction::Right}, {1, 0, Direction::Up}, {2, 0, Direction::Right}};
+    std::vector<std::vector<int>> goals = {{1, 0, 0}, {0, 0, 0}, {2, 0, 0}};
+    for (PibtEngine engine : {PibtEngine::Recursive, PibtEngine::Iterative}) {
+        PibtOptions options;
+        options.engine = engine;
+        options.rotation_steps = 3;
+        PIBT pibt(3, 1, starts, goals, options);
+        Agent *a = pibt.GetAgent(0), *b = pibt.GetAgent(1);
+        a->priority = 10.0f; // plans first and pushes B
+        b->turn_wait = 2;    // one timestep into its turn
+
+        // Both wait, and B keeps the rest of its turn, which counts down as the waits are executed
+        pibt.Step();
+        EXPECT_EQ(a->v_next, a->v_now);
+        EXPECT_EQ(b->v_next, b->v_now);
+        EXPECT_EQ(b->current_direction, Direction::Up);
+        EXPECT_EQ(b->turn_wait, 2);
+        pibt.Step();
+        EXPECT_EQ(b->v_now->x, 1);
+        EXPECT_EQ(b->turn_wait, 1);
+    }
+}
+
+// Test case 28: Verify distance tables held by agents stay within distance_cache_bytes
+TEST(PIBTTest, DistanceMemoryLimit) {
+    // 40 distinct goals, room for the tables of 10; the other agents fall back to cluster goal tables
+    auto graph = std::make_shared<Graph>(32, 32);
+    const std::size_t table_bytes = graph->Size() * sizeof(uint16_t);
+    std::vector<int32_t> starts, goals, headings;
+    for (int i = 0; i < 40; ++i) {
+        starts.push_back(graph->GetId(i % 8, i / 8));
+        goals.push_back(graph->GetId(31 - i % 8, 31 - i / 8));
+        headings.push_back(Direction::Up);
+    }
+    auto span = [](const std::vector<int32_t> &v) { return Span<const int32_t>(v.data(), v.size()); };
+    PibtOptions options;
+    options.distance_cache_bytes = 10 * table_bytes;
+    options.cluster_size = 8;
+    PIBT pibt(graph, span(starts), span(goals), span(headings), options);
+
+    auto held_bytes = [&]() {
+        std::set<const DistanceTable *> held;
+        for (const auto &table : pibt.distance_tables)
+            held.insert(table.get());
+        held.erase(nullptr);
+        return held.size() * table_bytes;
+    };
+    EXPECT_EQ(held_bytes(), 10 * table_bytes);
+    EXPECT_EQ(pibt.distance_cache.MemoryUsage(), 10 * table_bytes);
+    EXPECT_EQ(pibt.distance_cache.refusals, 30);
+    ASSERT_NE(pibt.hierarchy, nullptr);
+
+    // New goals on arrival keep within the limit too
+    std::mt19937 rng(4);
+    for (int t = 0; t < 200; ++t) {
+        pibt.Step();
+        for (Agent *agent : pibt.arrived)
+            pibt.SetGoal(agent->id, (int)(rng() % 32), (int)(rng() % 32));
+        ASSERT_LE(held_bytes(), options.distance_cache_bytes) << "timestep " << t;
+        ASSERT_LE(pibt.distance_cache.MemoryUsage(), options.distance_cache_bytes) << "timestep " << t;
+    }
+    EXPECT_GT(pibt.tasks_completed, 40u);
+
+    // Roadmaps have no cluster hierarchy to fall back to
+    std::vector<Vertex> points = {Vertex(0, 0), Vertex(1, 0), Vertex(2, 0)};
+    std::vector<int32_t> sources = {0, 1, 1, 2}, targets = {1, 0, 2, 1};
+    auto roadmap = std::make_shared<Graph>(points, true, span(sources), span(targets));
+    std::vector<int32_t> line_starts = {0, 2}, line_goals = {1, 0}, line_headings = {0, 0};
+    PibtOptions small;
+    small.distance_cache_bytes = roadmap->Size() * sizeof(uint16_t);
+    EXPECT_THROW(PIBT(roadmap, span(line_starts), span(line_goals), span(line_headings), small), std::runtime_error);
+}
+
 TEST(PIBTTest, RunFor100Iterations) {
     // Optionally, set up some default values for the grid and agents
     int width = 5;
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <graph.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Memory shared by the coordinator and the worker processes of a ShardedPlanner: one anonymous
+// MAP_SHARED mapping made before forking, so every process sees the same pages. It holds the
+// agents' current states, and per shard the agents near its border, its cross-border move
+// requests and the moves its plan gives the other shards' agents. A barrier separates the phases
+// of a timestep; whoever writes a region in one phase is the only one touching it until the next
+// barrier.
+class ShardChannel
+{
+public:
+    // Agent near a shard's border, as the neighbouring shards see it
+    struct BorderAgent
+    {
+        int32_t vertex;
+        int32_t agent;
+        int32_t goal;
+        float priority;
+        float initial_priority;
+        Direction heading;
+    };
+
+    // Move of an agent into another shard's vertex, with what the receiver needs to take it over
+    struct Request
+    {
+        int32_t agent;
+        int32_t from;
+        int32_t to;
+        int32_t goal;
+        float priority;
+        float initial_priority;
+        float chain_priority;  // of the agent whose push chain planned the move
+        float chain_initial_priority;
+        Direction heading;     // after the move
+        uint8_t reached_goal;
+        uint8_t granted;       // set by the receiving shard
+    };
+
+    // Move the shard's plan gives another shard's agent near its border
+    struct GhostMove
+    {
+        int32_t agent;
+        int32_t to;
+        Direction heading; // after the move
+        float chain_priority; // of the agent whose push chain planned the move
+        float chain_initial_priority;
+    };
+
+    // Written by the shard alone
+    struct ShardCounters
+    {
+        uint32_t border_size;   // entries of its border list
+        uint32_t num_requests;
+        uint32_t num_ghost_moves;
+        uint64_t travelling;    // agents that have not reached their goal yet
+        uint64_t handoffs;      // agents handed to other shards, since the start
+        uint64_t denied;        // moves turned into waits for lack of a grant, since the start
+    };
+
+    // border_capacities: per shard, the most agents near its border; ghost_capacities: per shard,
+    // the most other shards' agents near it; parties: processes that meet at the barrier
+    ShardChannel(std::size_t _num_agents, const std::vector<std::size_t> &border_capacities,
+                 const std::vector<std::size_t> &ghost_capacities, uint32_t parties);
+    ~ShardChannel();
+
+    ShardChannel(const ShardChannel &) = delete;
+    ShardChannel &operator=(const ShardChannel &) = delete;
+
+    // Blocks until every party has arrived; false if the run was aborted meanwhile. poll, if
+    // given, runs every few milliseconds while waiting and aborts the run by returning false.
+    bool Wait(const std::function<bool()> &poll = nullptr);
+    // Releases every waiting party; the first message is kept
+    void Abort(const std::string &message);
+    bool Aborted() const;
+    std::string Error() const;
+
+    void SetStop(bool stop);
+    bool Stop() const;
+
+    std::size_t NumShards() const { return num_shards; }
+    // Agent states by agent id, each written by the shard owning the agent
+    Span<int32_t> Vertices();
+    Span<Direction> Headings();
+    ShardCounters &Counters(std::size_t shard);
+    // The shard's agents near its border, Counters(shard).border_size of them
+    Span<BorderAgent> Border(std::size_t shard);
+    Span<Request> Requests(std::size_t shard);
+    Span<GhostMove> GhostMoves(std::size_t shard);
+
+private:
+    struct Header;
+
+    Header &GetHeader() const;
+    template <typename T>
+    T *At(std::size_t offset) const { return reinterpret_cast<T *>(static_cast<char *>(mapping) + offset); }
+
+    void *mapping = nullptr;
+    std::size_t size = 0;
+    std::size_t num_agents;
+    std::size_t num_shards;
+    std::size_t vertices_offset, headings_offset, counters_offset;
+    std::vector<std::size_t> border_offsets, request_offsets, ghost_offsets;
+    std::vector<std::size_t> capacities, ghost_capacities;
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <graph.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "pibt.h"
+
+class ShardChannel;
+class TrajectoryWriter;
+
+// Split of a graph into vertical strips holding about the same number of free vertices,
+// shard 0 leftmost. Roadmaps are split by their vertices' x positions. Vertices within halo_depth
+// moves of another shard, either way, are near its border.
+class ShardLayout
+{
+public:
+    ShardLayout(const Graph &graph, int num_shards, int halo_depth = 1);
+
+    int NumShards() const { return num_shards; }
+    int Owner(int v) const { return shard_of_column[graph.vertices[v].x]; }
+    // Whether v is near another shard's border
+    bool IsBorder(int v) const { return reach_first[v] != Owner(v) || reach_last[v] != Owner(v); }
+    // Whether v is the shard's or near its border
+    bool Touches(int v, int shard) const { return reach_first[v] <= shard && shard <= reach_last[v]; }
+
+    std::vector<int> first_column;     // by shard, plus the width
+    std::vector<std::size_t> border_sizes; // vertices near another shard's border, by shard
+    std::vector<std::size_t> ghost_sizes;  // other shards' vertices near its border, by shard
+
+private:
+    const Graph &graph;
+    int num_shards;
+    std::vector<uint16_t> shard_of_column;
+    std::vector<uint16_t> reach_first, reach_last; // by vertex: lowest and highest shard within halo_depth moves
+};
+
+struct ShardOptions
+{
+    // Worker processes, one shard each
+    int num_shards = 2;
+    // Moves from a border within which a shard also plans the neighbouring shard's agents
+    int halo_depth = 8;
+};
+
+// PIBT split over worker processes on one host, for sites whose full planning state does not fit
+// one process. Each worker owns the agents standing in its shard and keeps the distance tables of
+// their goals only; the graph is loaded once and shared copy-on-write. A worker also plans the other
+// shards' agents within ShardOptions::halo_depth moves of its border ("ghosts"), and holds the
+// vertices just beyond them as if occupied. Every timestep, through a ShardChannel:
+//   1. each worker plans its agents and ghosts together with PIBT::PlanFrom, so pushes cross the
+//      border as in a single PIBT, and publishes the moves its push chains give the ghosts;
+//   2. each worker makes the moves the other shards' chains give its agents where those chains
+//      have the higher priority, replans around them, and publishes the moves that leave the shard
+//      as requests;
+//   3. each worker grants per vertex the request of the highest-priority chain, which takes the
+//      vertex from its own agents moving in for a lower-priority one; a move into an occupied
+//      vertex only stands while its occupant leaves;
+//   4. refused moves become waits, and so does every move into a vertex whose agent now waits;
+//      granted agents are handed over to the receiving shard with their goal and priority.
+// The joint plan stays free of vertex and swap conflicts across borders, but it is not the plan of
+// a single PIBT: a push chain longer than the halo ends at its edge, so traffic near the borders
+// takes other turns and can stall where a single planner would not.
+class ShardedPlanner
+{
+public:
+    // Flat arrays as for the PIBT constructor. pibt_options apply to every shard; its seed draws
+    // the agents' tie-breaking priorities, and rotation_steps must be 1.
+    ShardedPlanner(std::shared_ptr<Graph> _graph,
+                   Span<const int32_t> start_vertices,
+                   Span<const int32_t> goal_vertices,
+                   Span<const int32_t> headings,
+                   const PibtOptions &pibt_options = PibtOptions(),
+                   const ShardOptions &_options = ShardOptions());
+
+    // Forks the workers and runs until every agent has reached its goal or pibt_options.max_timesteps pass,
+    // recording every timestep in `paths` and, if given, the trajectory. Returns whether every
+    // agent reached its goal; throws std::runtime_error when a worker fails.
+    bool Run(TrajectoryWriter *trajectory = nullptr);
+    std::size_t SumOfCosts() const;
+
+    bool failed = false; // the run hit the timestep limit
+    int timesteps = 0;   // timesteps simulated, also when the run failed
+    std::size_t handoffs = 0;     // agents handed to another shard
+    std::size_t denied_moves = 0; // planned moves turned into waits at the borders
+    PathStore paths;
+    std::shared_ptr<Graph> graph;
+    ShardLayout layout;
+
+private:
+    void RunWorker(int shard, ShardChannel &channel) const;
+
+    PibtOptions pibt_options;
+    ShardOptions options;
+    std::vector<int32_t> starts, goals;
+    std::vector<Direction> initial_headings;
+    std::vector<float> initial_priorities;
+};
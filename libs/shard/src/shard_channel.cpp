@@ -0,0 +1,194 @@
+#include "shard_channel.h"
+
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <linux/futex.h>
+#include <new>
+#include <sched.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "The barrier waits on its generation counter with futex");
+
+namespace
+{
+    constexpr std::size_t kAlignment = 64;
+    // Yields before sleeping on the futex; the other parties usually arrive within a few
+    constexpr int kSpins = 64;
+    constexpr long kPollNanoseconds = 10 * 1000 * 1000;
+
+    std::size_t Align(std::size_t offset)
+    {
+        return (offset + kAlignment - 1) / kAlignment * kAlignment;
+    }
+
+    // Shared futex: the mapping is MAP_SHARED, so no FUTEX_PRIVATE_FLAG
+    void FutexWait(std::atomic<uint32_t> &word, uint32_t expected, long nanoseconds)
+    {
+        timespec timeout = {0, nanoseconds};
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+    }
+
+    void FutexWakeAll(std::atomic<uint32_t> &word)
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
+
+struct ShardChannel::Header
+{
+    std::atomic<uint32_t> arrived;
+    std::atomic<uint32_t> generation; // bumped each time the barrier opens
+    std::atomic<uint32_t> aborted;
+    uint32_t parties;
+    uint32_t stop;
+    char error[256];
+};
+
+ShardChannel::ShardChannel(std::size_t _num_agents, const std::vector<std::size_t> &border_capacities,
+                           const std::vector<std::size_t> &_ghost_capacities, uint32_t parties)
+    : num_agents(_num_agents),
+      num_shards(border_capacities.size()),
+      capacities(border_capacities),
+      ghost_capacities(_ghost_capacities)
+{
+    std::size_t offset = Align(sizeof(Header));
+    vertices_offset = offset;
+    offset = Align(offset + num_agents * sizeof(int32_t));
+    headings_offset = offset;
+    offset = Align(offset + num_agents * sizeof(Direction));
+    counters_offset = offset;
+    offset = Align(offset + num_shards * sizeof(ShardCounters));
+    for (std::size_t shard = 0; shard < num_shards; ++shard)
+    {
+        border_offsets.push_back(offset);
+        offset = Align(offset + capacities[shard] * sizeof(BorderAgent));
+        request_offsets.push_back(offset);
+        offset = Align(offset + capacities[shard] * sizeof(Request));
+        ghost_offsets.push_back(offset);
+        offset = Align(offset + ghost_capacities[shard] * sizeof(GhostMove));
+    }
+    size = offset;
+
+    // Anonymous pages come zeroed
+    mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        mapping = nullptr;
+        throw std::runtime_error("Cannot map " + std::to_string(size) + " bytes of shared memory.");
+    }
+    Header *header = new (mapping) Header();
+    header->parties = parties;
+}
+
+ShardChannel::~ShardChannel()
+{
+    if (mapping)
+        munmap(mapping, size);
+}
+
+ShardChannel::Header &ShardChannel::GetHeader() const
+{
+    return *static_cast<Header *>(mapping);
+}
+
+// Generation-counting barrier: the last party to arrive resets the count and opens the next
+// generation; the others yield for a while, then sleep on the generation word
+bool ShardChannel::Wait(const std::function<bool()> &poll)
+{
+    Header &header = GetHeader();
+    const uint32_t generation = header.generation.load(std::memory_order_acquire);
+    if (header.arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == header.parties)
+    {
+        header.arrived.store(0, std::memory_order_relaxed);
+        header.generation.fetch_add(1, std::memory_order_acq_rel);
+        FutexWakeAll(header.generation);
+        return !Aborted();
+    }
+
+    for (int spin = 0; header.generation.load(std::memory_order_acquire) == generation; ++spin)
+    {
+        if (Aborted())
+            return false;
+        if (spin < kSpins)
+        {
+            sched_yield();
+            continue;
+        }
+        FutexWait(header.generation, generation, kPollNanoseconds);
+        if (poll && !poll())
+        {
+            Abort("A shard worker stopped unexpectedly.");
+            return false;
+        }
+    }
+    return !Aborted();
+}
+
+void ShardChannel::Abort(const std::string &message)
+{
+    Header &header = GetHeader();
+    uint32_t expected = 0;
+    if (header.aborted.compare_exchange_strong(expected, 1))
+    {
+        std::strncpy(header.error, message.c_str(), sizeof(header.error) - 1);
+        header.aborted.store(2, std::memory_order_release);
+    }
+    header.generation.fetch_add(1, std::memory_order_acq_rel);
+    FutexWakeAll(header.generation);
+}
+
+bool ShardChannel::Aborted() const
+{
+    return GetHeader().aborted.load(std::memory_order_acquire) != 0;
+}
+
+std::string ShardChannel::Error() const
+{
+    const Header &header = GetHeader();
+    return header.aborted.load(std::memory_order_acquire) == 2 ? std::string(header.error) : std::string();
+}
+
+void ShardChannel::SetStop(bool stop)
+{
+    GetHeader().stop = stop;
+}
+
+bool ShardChannel::Stop() const
+{
+    return GetHeader().stop != 0;
+}
+
+Span<int32_t> ShardChannel::Vertices()
+{
+    return Span<int32_t>(At<int32_t>(vertices_offset), num_agents);
+}
+
+Span<Direction> ShardChannel::Headings()
+{
+    return Span<Direction>(At<Direction>(headings_offset), num_agents);
+}
+
+ShardChannel::ShardCounters &ShardChannel::Counters(std::size_t shard)
+{
+    return At<ShardCounters>(counters_offset)[shard];
+}
+
+Span<ShardChannel::BorderAgent> ShardChannel::Border(std::size_t shard)
+{
+    return Span<BorderAgent>(At<BorderAgent>(border_offsets[shard]), capacities[shard]);
+}
+
+Span<ShardChannel::Request> ShardChannel::Requests(std::size_t shard)
+{
+    return Span<Request>(At<Request>(request_offsets[shard]), capacities[shard]);
+}
+
+Span<ShardChannel::GhostMove> ShardChannel::GhostMoves(std::size_t shard)
+{
+    return Span<GhostMove>(At<GhostMove>(ghost_offsets[shard]), ghost_capacities[shard]);
+}
@@ -0,0 +1,768 @@
+#include "sharded_planner.h"
+#include "shard_channel.h"
+#include "trajectory.h"
+
+#include <algorithm>
+#include <csignal>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_map>
+
+ShardLayout::ShardLayout(const Graph &_graph, int _num_shards, int halo_depth)
+    : graph(_graph),
+      num_shards(_num_shards)
+{
+    if (num_shards < 1 || num_shards > graph.width || num_shards > UINT16_MAX)
+    {
+        throw std::invalid_argument("num_shards must be between 1 and the map width.");
+    }
+    if (halo_depth < 1)
+    {
+        throw std::invalid_argument("halo_depth must be at least 1.");
+    }
+
+    std::vector<std::size_t> column_sizes(graph.width, 0);
+    std::size_t total = 0;
+    for (const Vertex &v : graph.vertices)
+    {
+        if (!graph.IsBlocked(v.id))
+        {
+            ++column_sizes[v.x];
+            ++total;
+        }
+    }
+
+    // Start the next shard once this one holds its share, leaving a column for each shard after it
+    shard_of_column.resize(graph.width);
+    first_column.assign(1, 0);
+    std::size_t seen = 0;
+    int shard = 0;
+    for (int x = 0; x < graph.width; ++x)
+    {
+        const int remaining = num_shards - 1 - shard;
+        if (remaining > 0 && x > first_column[shard] &&
+            (seen * num_shards >= (std::size_t)(shard + 1) * total || graph.width - x <= remaining))
+        {
+            ++shard;
+            first_column.push_back(x);
+        }
+        shard_of_column[x] = (uint16_t)shard;
+        seen += column_sizes[x];
+    }
+    first_column.push_back(graph.width);
+
+    // Widen each vertex's range of shards by one move at a time, along edges either way
+    const std::size_t num_vertices = graph.Size();
+    reach_first.resize(num_vertices);
+    for (std::size_t v = 0; v < num_vertices; ++v)
+        reach_first[v] = (uint16_t)Owner((int)v);
+    reach_last = reach_first;
+    std::vector<uint16_t> first, last;
+    for (int depth = 0; depth < halo_depth; ++depth)
+    {
+        first = reach_first;
+        last = reach_last;
+        for (std::size_t v = 0; v < num_vertices; ++v)
+        {
+            for (const Neighbor &n : graph.GetNeighbors((int)v))
+            {
+                reach_first[v] = std::min(reach_first[v], first[n.id]);
+                reach_last[v] = std::max(reach_last[v], last[n.id]);
+            }
+            for (const Neighbor &n : graph.GetPredecessors((int)v))
+            {
+                reach_first[v] = std::min(reach_first[v], first[n.id]);
+                reach_last[v] = std::max(reach_last[v], last[n.id]);
+            }
+        }
+    }
+
+    border_sizes.assign(num_shards, 0);
+    ghost_sizes.assign(num_shards, 0);
+    for (const Vertex &v : graph.vertices)
+    {
+        if (graph.IsBlocked(v.id) || !IsBorder(v.id))
+            continue;
+        ++border_sizes[Owner(v.id)];
+        for (int other = reach_first[v.id]; other <= reach_last[v.id]; ++other)
+            ghost_sizes[other] += other != Owner(v.id);
+    }
+}
+
+namespace
+{
+    using BorderAgent = ShardChannel::BorderAgent;
+    using GhostMove = ShardChannel::GhostMove;
+    using Request = ShardChannel::Request;
+
+    struct LocalAgent
+    {
+        int32_t agent;
+        int32_t vertex;
+        int32_t goal;
+        float priority;
+        float initial_priority;
+        Direction heading;
+        bool reached_goal;
+    };
+
+    // Planning order of PIBT::Step: priority, then the tie-breaker
+    bool Before(float priority_a, float initial_a, float priority_b, float initial_b)
+    {
+        return priority_a != priority_b ? priority_a > priority_b : initial_a > initial_b;
+    }
+
+    // Priority after a timestep, as PIBT::Step updates it
+    void UpdatePriority(LocalAgent &agent)
+    {
+        if (agent.vertex == agent.goal)
+        {
+            agent.priority = agent.initial_priority;
+            agent.reached_goal = true;
+        }
+        else
+        {
+            agent.priority += 1.0f;
+        }
+    }
+
+    // One shard's side of a ShardedPlanner run, see there for the protocol. The local planner's
+    // agents are the shard's own, then the other shards' agents near its border ("ghosts"), then
+    // the fence. It is only Reset when that list of goals changes.
+    class ShardWorker
+    {
+    public:
+        ShardWorker(int _shard, std::shared_ptr<Graph> _graph, const ShardLayout &_layout, ShardChannel &_channel,
+                    const PibtOptions &_options, std::vector<LocalAgent> _locals)
+            : shard(_shard),
+              graph(std::move(_graph)),
+              layout(_layout),
+              channel(_channel),
+              options(_options),
+              locals(std::move(_locals))
+        {
+            options.record_paths = false;
+            options.num_threads = 1; // PlanFrom plans on one thread
+            for (int v = 0; v < (int)graph->Size(); ++v)
+            {
+                if (graph->IsBlocked(v) || layout.Touches(v, shard))
+                    continue;
+                for (const Neighbor &n : graph->GetPredecessors(v))
+                {
+                    if (layout.Touches(n.id, shard))
+                    {
+                        fence.push_back(v);
+                        break;
+                    }
+                }
+            }
+        }
+
+        void Run()
+        {
+            Publish();
+            while (true)
+            {
+                if (!channel.Wait())
+                    return;
+                Plan();
+                if (!channel.Wait() || channel.Stop())
+                    return;
+                Settle();
+                if (!channel.Wait())
+                    return;
+                Grant();
+                if (!channel.Wait())
+                    return;
+                Commit();
+                Publish();
+            }
+        }
+
+    private:
+        bool Waits(std::size_t i) const
+        {
+            return next_vertices[i] == vertices[i] && next_headings[i] == headings[i];
+        }
+
+        // States of the shard's agents, and those near its border for the neighbouring shards
+        void Publish()
+        {
+            Span<int32_t> vertices = channel.Vertices();
+            Span<Direction> headings = channel.Headings();
+            Span<BorderAgent> border = channel.Border(shard);
+            ShardChannel::ShardCounters &counters = channel.Counters(shard);
+            uint32_t border_size = 0;
+            uint64_t travelling = 0;
+            for (const LocalAgent &a : locals)
+            {
+                vertices[a.agent] = a.vertex;
+                headings[a.agent] = a.heading;
+                if (layout.IsBorder(a.vertex))
+                    border[border_size++] = {a.vertex, a.agent, a.goal, a.priority, a.initial_priority, a.heading};
+                travelling += !a.reached_goal;
+            }
+            counters.border_size = border_size;
+            counters.travelling = travelling;
+            counters.handoffs = handoffs;
+            counters.denied = denied;
+        }
+
+        // Plans the shard's agents and the ghosts, and notes for each the priority of the agent
+        // whose push chain planned it
+        bool PlanAgents()
+        {
+            const std::size_t num_agents = vertices.size();
+            auto span = [](const std::vector<int32_t> &v) { return Span<const int32_t>(v.data(), v.size()); };
+            if (!pibt->PlanFrom(span(vertices), Span<const Direction>(headings.data(), num_agents), Span<const int>(order.data(), num_agents),
+                                Span<const FixedMove>(fixed.data(), fixed.size()), Span<int32_t>(next_vertices.data(), num_agents),
+                                Span<Direction>(next_headings.data(), num_agents), Span<int32_t>(roots.data(), num_agents)))
+                return false;
+            for (std::size_t i = 0; i < num_agents; ++i)
+                chains[i] = ranks[roots[i]];
+            for (std::size_t k = 0; k < fixed.size(); ++k)
+                chains[fixed[k].agent] = fixed_chains[k];
+            return true;
+        }
+
+        bool Outranks(const std::pair<float, float> &chain, int i) const
+        {
+            return Before(chain.first, chain.second, chains[i].first, chains[i].second);
+        }
+
+        // Plans the shard's agents and the ghosts together in priority order, so an agent on
+        // either side of a border pushes the other as in a single PIBT, and publishes the moves
+        // the push chains give the ghosts for their shards
+        void Plan()
+        {
+            ShardChannel::ShardCounters &counters = channel.Counters(shard);
+            counters.num_requests = 0;
+            counters.num_ghost_moves = 0;
+            planned = !locals.empty();
+            if (!planned)
+                return;
+
+            const std::size_t num_locals = locals.size();
+            ghosts.clear();
+            for (int other = 0; other < layout.NumShards(); ++other)
+            {
+                if (other == shard)
+                    continue;
+                Span<BorderAgent> border = channel.Border(other);
+                for (uint32_t i = 0; i < channel.Counters(other).border_size; ++i)
+                {
+                    if (layout.Touches(border[i].vertex, shard))
+                        ghosts.push_back(border[i]);
+                }
+            }
+
+            const std::size_t num_planned = num_locals + ghosts.size();
+            const std::size_t num_agents = num_planned + fence.size();
+            vertices.resize(num_agents);
+            goals.resize(num_agents);
+            headings.resize(num_agents);
+            int_headings.resize(num_agents);
+            order.resize(num_agents);
+            ranks.resize(num_agents);
+            for (std::size_t i = 0; i < num_agents; ++i)
+            {
+                if (i < num_locals)
+                {
+                    const LocalAgent &a = locals[i];
+                    vertices[i] = a.vertex;
+                    goals[i] = a.goal;
+                    headings[i] = a.heading;
+                    ranks[i] = {a.priority, a.initial_priority};
+                }
+                else if (i < num_planned)
+                {
+                    const BorderAgent &a = ghosts[i - num_locals];
+                    vertices[i] = a.vertex;
+                    goals[i] = a.goal;
+                    headings[i] = a.heading;
+                    ranks[i] = {a.priority, a.initial_priority};
+                }
+                else
+                {
+                    vertices[i] = goals[i] = fence[i - num_planned];
+                    headings[i] = Direction::Up;
+                    ranks[i] = {0.0f, 0.0f};
+                }
+                int_headings[i] = headings[i];
+                order[i] = (int)i;
+            }
+            std::sort(order.begin(), order.end(), [this](int a, int b)
+                      { return Before(ranks[a].first, ranks[a].second, ranks[b].first, ranks[b].second); });
+
+            auto span = [](const std::vector<int32_t> &v) { return Span<const int32_t>(v.data(), v.size()); };
+            if (!pibt)
+            {
+                pibt = std::make_unique<PIBT>(graph, span(vertices), span(goals), span(int_headings), options);
+                planner_goals = goals;
+            }
+            else if (goals != planner_goals)
+            {
+                pibt->Reset(span(vertices), span(goals), span(int_headings), options.seed);
+                planner_goals = goals;
+            }
+
+            next_vertices.resize(num_agents);
+            next_headings.resize(num_agents);
+            roots.resize(num_agents);
+            chains.resize(num_agents);
+            fixed.clear();
+            fixed_chains.clear();
+            for (std::size_t i = num_planned; i < num_agents; ++i)
+            {
+                fixed.push_back({(int)i, vertices[i], headings[i]});
+                fixed_chains.push_back(ranks[i]);
+            }
+            if (!PlanAgents())
+                throw std::logic_error("PIBT found no plan around the border agents.");
+
+            Span<GhostMove> out_moves = channel.GhostMoves(shard);
+            uint32_t num_moves = 0;
+            for (std::size_t i = num_locals; i < num_planned; ++i)
+            {
+                if (roots[i] != (int)i && !Waits(i))
+                {
+                    out_moves[num_moves++] = {ghosts[i - num_locals].agent, next_vertices[i], next_headings[i], chains[i].first,
+                                              chains[i].second};
+                }
+            }
+            counters.num_ghost_moves = num_moves;
+        }
+
+        // The shards on either side of a border see different parts of a push chain, so they can
+        // plan an agent near it differently. As in PIBT, the chain of the higher-priority agent
+        // wins: the shard's agents make the moves the other shards' chains give them when those
+        // outrank the chains that planned them here, and the vertex is free. Falls back to the
+        // plan without those moves if they do not fit. Then publishes the moves that leave the
+        // shard as requests.
+        void Settle()
+        {
+            ShardChannel::ShardCounters &counters = channel.Counters(shard);
+            if (!planned)
+                return;
+
+            const std::size_t num_locals = locals.size();
+            index_of.clear();
+            for (std::size_t i = 0; i < num_locals; ++i)
+                index_of[locals[i].agent] = (int)i;
+            for (int other = 0; other < layout.NumShards(); ++other)
+            {
+                if (other == shard)
+                    continue;
+                Span<GhostMove> moves = channel.GhostMoves(other);
+                for (uint32_t k = 0; k < channel.Counters(other).num_ghost_moves; ++k)
+                {
+                    const GhostMove &m = moves[k];
+                    auto local = index_of.find(m.agent);
+                    if (local == index_of.end())
+                        continue;
+                    const int i = local->second;
+                    const std::pair<float, float> chain(m.chain_priority, m.chain_initial_priority);
+                    if (!Outranks(chain, i))
+                        continue;
+                    const Agent *claimant = pibt->occupied_next[m.to];
+                    if (m.to != vertices[i] &&
+                        (pibt->occupied_now[m.to] != nullptr || (claimant != nullptr && !Outranks(chain, claimant->id))))
+                        continue;
+                    fixed.push_back({i, m.to, m.heading, m.to != vertices[i]});
+                    fixed_chains.push_back(chain);
+                }
+            }
+            if (fixed.size() > fence.size() && !PlanAgents())
+            {
+                fixed.resize(fence.size());
+                fixed_chains.resize(fence.size());
+                PlanAgents();
+            }
+
+            Span<Request> requests = channel.Requests(shard);
+            request_locals.clear();
+            for (std::size_t i = 0; i < num_locals; ++i)
+            {
+                const LocalAgent &a = locals[i];
+                if (next_vertices[i] != a.vertex && layout.Owner(next_vertices[i]) != shard)
+                {
+                    requests[request_locals.size()] = {a.agent, a.vertex, next_vertices[i], a.goal, a.priority, a.initial_priority,
+                                                       chains[i].first, chains[i].second, next_headings[i], a.reached_goal, 0};
+                    request_locals.push_back((int)i);
+                }
+            }
+            counters.num_requests = (uint32_t)request_locals.size();
+        }
+
+        // Whether whoever stands on the shard's vertex v leaves it whatever the other shards
+        // grant: the agents ahead of it only move within the shard, into a vertex that empties
+        bool Vacates(int32_t v) const
+        {
+            const std::size_t num_locals = locals.size();
+            for (std::size_t steps = 0; steps <= num_locals; ++steps)
+            {
+                const Agent *occupant = pibt->occupied_now[v];
+                if (occupant == nullptr)
+                    return true;
+                if (occupant->id >= (int)num_locals || next_vertices[occupant->id] == v ||
+                    layout.Owner(next_vertices[occupant->id]) != shard)
+                    return false;
+                v = next_vertices[occupant->id];
+            }
+            return false;
+        }
+
+        // Makes the shard's agents in `waiting` wait, and every agent moving into the vertex of one
+        // that waits
+        void Hold()
+        {
+            if (waiting.empty())
+                return;
+            moving_into.clear();
+            for (std::size_t i = 0; i < locals.size(); ++i)
+            {
+                if (next_vertices[i] != locals[i].vertex)
+                    moving_into[next_vertices[i]] = (int)i;
+            }
+            while (!waiting.empty())
+            {
+                const int i = waiting.back();
+                waiting.pop_back();
+                if (next_vertices[i] == locals[i].vertex)
+                    continue;
+                next_vertices[i] = locals[i].vertex;
+                next_headings[i] = locals[i].heading;
+                ++denied;
+                auto follower = moving_into.find(locals[i].vertex);
+                if (follower != moving_into.end())
+                    waiting.push_back(follower->second);
+            }
+        }
+
+        // Requests into the shard's vertices, one per vertex: the one whose push chain has the
+        // highest priority, as that chain plans first in PIBT. It takes the vertex from a shard's
+        // agent moving in for a lower-priority chain, which waits instead. It stands where this
+        // shard's plan moves that ghost there too, or where the plan leaves the vertex to nobody
+        // else; an agent standing there has to be sure to leave.
+        void Grant()
+        {
+            const std::size_t num_locals = locals.size();
+            granted.clear();
+            for (int other = 0; other < layout.NumShards(); ++other)
+            {
+                if (other == shard)
+                    continue;
+                Span<Request> requests = channel.Requests(other);
+                for (uint32_t i = 0; i < channel.Counters(other).num_requests; ++i)
+                {
+                    Request &request = requests[i];
+                    if (layout.Owner(request.to) != shard)
+                        continue;
+                    Request *&winner = granted[request.to];
+                    if (!winner || Before(request.chain_priority, request.chain_initial_priority, winner->chain_priority,
+                                          winner->chain_initial_priority))
+                        winner = &request;
+                }
+            }
+
+            if (planned)
+            {
+                waiting.clear();
+                for (const auto &entry : granted)
+                {
+                    const Agent *claimant = pibt->occupied_next[entry.first];
+                    const std::pair<float, float> chain(entry.second->chain_priority, entry.second->chain_initial_priority);
+                    if (claimant != nullptr && claimant->id < (int)num_locals && vertices[claimant->id] != entry.first &&
+                        Outranks(chain, claimant->id))
+                        waiting.push_back(claimant->id);
+                }
+                Hold();
+                for (auto entry = granted.begin(); entry != granted.end();)
+                {
+                    const Request &request = *entry->second;
+                    const Agent *claimant = pibt->occupied_next[request.to];
+                    const bool agreed = claimant != nullptr && claimant->id >= (int)num_locals &&
+                                        ghosts[claimant->id - num_locals].agent == request.agent;
+                    const bool claimed = claimant != nullptr && !agreed && next_vertices[claimant->id] == request.to;
+                    if (claimed || !Vacates(request.to))
+                        entry = granted.erase(entry);
+                    else
+                        ++entry;
+                }
+            }
+            for (auto &entry : granted)
+                entry.second->granted = 1;
+        }
+
+        void Commit()
+        {
+            // A refused move waits
+            Span<Request> requests = channel.Requests(shard);
+            waiting.clear();
+            for (std::size_t k = 0; k < request_locals.size(); ++k)
+            {
+                if (!requests[k].granted)
+                    waiting.push_back(request_locals[k]);
+            }
+            Hold();
+
+            std::size_t kept = 0;
+            for (std::size_t i = 0; planned && i < locals.size(); ++i)
+            {
+                LocalAgent a = locals[i];
+                if (next_vertices[i] != a.vertex && layout.Owner(next_vertices[i]) != shard)
+                {
+                    ++handoffs;
+                    continue;
+                }
+                a.vertex = next_vertices[i];
+                a.heading = next_headings[i];
+                UpdatePriority(a);
+                locals[kept++] = a;
+            }
+            locals.resize(kept);
+
+            for (int other = 0; other < layout.NumShards(); ++other)
+            {
+                if (other == shard)
+                    continue;
+                Span<Request> incoming = channel.Requests(other);
+                for (uint32_t i = 0; i < channel.Counters(other).num_requests; ++i)
+                {
+                    const Request &request = incoming[i];
+                    if (!request.granted || layout.Owner(request.to) != shard)
+                        continue;
+                    LocalAgent a = {request.agent, request.to, request.goal, request.priority, request.initial_priority,
+                                    request.heading, request.reached_goal != 0};
+                    UpdatePriority(a);
+                    locals.push_back(a);
+                }
+            }
+        }
+
+        const int shard;
+        std::shared_ptr<Graph> graph;
+        const ShardLayout &layout;
+        ShardChannel &channel;
+        PibtOptions options;
+        std::vector<LocalAgent> locals;
+        std::unique_ptr<PIBT> pibt;
+        std::vector<int32_t> planner_goals; // goals of pibt's agents
+        bool planned = false;               // pibt holds this timestep's plan
+        std::size_t handoffs = 0, denied = 0;
+        std::vector<BorderAgent> ghosts;    // this timestep's, after the local agents in pibt
+        // Vertices just beyond what the shard sees, held by waiting placeholders after the ghosts
+        // so no push chain ends where an agent may stand
+        std::vector<int32_t> fence;
+
+        // Scratch, reused every timestep
+        std::vector<int32_t> vertices, goals, int_headings, next_vertices;
+        std::vector<Direction> headings, next_headings;
+        std::vector<int> order, request_locals, waiting;
+        std::vector<FixedMove> fixed;
+        std::vector<int32_t> roots; // by planned agent: the one whose push chain planned it
+        std::vector<std::pair<float, float>> chains, fixed_chains; // priority of that agent, by planned agent and fixed move
+        std::unordered_map<int32_t, int> index_of; // planner index by agent id
+        std::unordered_map<int32_t, Request *> granted;
+        std::unordered_map<int32_t, int> moving_into;
+        std::vector<std::pair<float, float>> ranks; // priority and tie-breaker of each planned agent
+    };
+}
+
+
+ShardedPlanner::ShardedPlanner(std::shared_ptr<Graph> _graph,
+                               Span<const int32_t> start_vertices,
+                               Span<const int32_t> goal_vertices,
+                               Span<const int32_t> headings,
+                               const PibtOptions &_pibt_options,
+                               const ShardOptions &_options)
+    : graph(std::move(_graph)),
+      layout(*graph, _options.num_shards, _options.halo_depth),
+      pibt_options(_pibt_options),
+      options(_options)
+{
+    const std::size_t num_agents = start_vertices.size();
+    if (goal_vertices.size() != num_agents || headings.size() != num_agents)
+    {
+        throw std::invalid_argument("Every agent needs a start, a goal and a heading.");
+    }
+    if (pibt_options.rotation_steps != 1)
+    {
+        throw std::invalid_argument("Sharded planning needs rotation_steps == 1, a turn must fit in one timestep.");
+    }
+    const int32_t num_vertices = (int32_t)graph->Size();
+    for (std::size_t i = 0; i < num_agents; ++i)
+    {
+        if (start_vertices[i] < 0 || start_vertices[i] >= num_vertices || graph->IsBlocked(start_vertices[i]) ||
+            goal_vertices[i] < 0 || goal_vertices[i] >= num_vertices || graph->IsBlocked(goal_vertices[i]))
+        {
+            throw std::runtime_error("Invalid start or goal location.");
+        }
+        if (headings[i] < 0 || headings[i] > (int32_t)Direction::None)
+        {
+            throw std::invalid_argument("Invalid heading.");
+        }
+    }
+    starts.assign(start_vertices.begin(), start_vertices.end());
+    goals.assign(goal_vertices.begin(), goal_vertices.end());
+    for (int32_t heading : headings)
+        initial_headings.push_back((Direction)heading);
+
+    // The same tie-breakers as a single PIBT with this seed
+    initial_priorities.resize(num_agents);
+    for (std::size_t i = 0; i < num_agents; ++i)
+        initial_priorities[i] = (float)(i) / num_agents;
+    std::mt19937 g(pibt_options.seed >= 0 ? (std::mt19937::result_type)pibt_options.seed : std::random_device()());
+    std::shuffle(initial_priorities.begin(), initial_priorities.end(), g);
+    pibt_options.seed = g();
+}
+
+// Runs in the forked worker process
+void ShardedPlanner::RunWorker(int shard, ShardChannel &channel) const
+{
+    std::vector<LocalAgent> locals;
+    for (std::size_t i = 0; i < starts.size(); ++i)
+    {
+        if (layout.Owner(starts[i]) == shard)
+            locals.push_back({(int32_t)i, starts[i], goals[i], initial_priorities[i], initial_priorities[i], initial_headings[i], false});
+    }
+    ShardWorker(shard, graph, layout, channel, pibt_options, std::move(locals)).Run();
+}
+
+// The coordinator meets the workers at every barrier: it records timestep t once they have
+// published it, and decides before they grant whether the run stops there
+bool ShardedPlanner::Run(TrajectoryWriter *trajectory)
+{
+    const std::size_t num_agents = starts.size();
+    ShardChannel channel(num_agents, layout.border_sizes, layout.ghost_sizes, (uint32_t)layout.NumShards() + 1);
+    paths.Reset(num_agents, pibt_options.path_chunk_timesteps, pibt_options.path_history_timesteps);
+    failed = false;
+    timesteps = 0;
+
+    std::vector<pid_t> workers;
+    auto reap = [&workers](bool kill_first)
+    {
+        for (pid_t pid : workers)
+        {
+            if (kill_first)
+                kill(pid, SIGKILL);
+            int status;
+            waitpid(pid, &status, 0);
+        }
+        workers.clear();
+    };
+    // A worker that exits while the others wait, by a crash or otherwise, aborts the run
+    auto alive = [&workers]()
+    {
+        for (pid_t pid : workers)
+        {
+            int status;
+            if (waitpid(pid, &status, WNOHANG) != 0)
+                return false;
+        }
+        return true;
+    };
+
+    for (int shard = 0; shard < layout.NumShards(); ++shard)
+    {
+        const pid_t pid = fork();
+        if (pid < 0)
+        {
+            channel.Abort("Cannot fork a shard worker.");
+            reap(true);
+            throw std::runtime_error("Cannot fork a shard worker.");
+        }
+        if (pid == 0)
+        {
+            int status = 0;
+            try
+            {
+                RunWorker(shard, channel);
+            }
+            catch (const std::exception &e)
+            {
+                channel.Abort("Shard " + std::to_string(shard) + ": " + e.what());
+                status = 1;
+            }
+            _exit(status);
+        }
+        workers.push_back(pid);
+    }
+
+    const std::size_t limit = pibt_options.max_timesteps > 0 ? (std::size_t)pibt_options.max_timesteps
+                                                             : num_agents * std::max(graph->width, graph->height) * 10;
+    bool completed = false;
+    try
+    {
+        for (std::size_t t = 0; channel.Wait(alive); ++t)
+        {
+            const std::size_t row = paths.AppendRow();
+            Span<int32_t> vertices = channel.Vertices();
+            Span<Direction> headings = channel.Headings();
+            std::copy(vertices.begin(), vertices.end(), paths.Vertices(row).begin());
+            std::copy(headings.begin(), headings.end(), paths.Headings(row).begin());
+            if (trajectory)
+                trajectory->Append(paths.Vertices(row), paths.Headings(row));
+
+            std::size_t travelling = 0;
+            handoffs = 0;
+            denied_moves = 0;
+            for (int shard = 0; shard < layout.NumShards(); ++shard)
+            {
+                const ShardChannel::ShardCounters &counters = channel.Counters(shard);
+                travelling += counters.travelling;
+                handoffs += counters.handoffs;
+                denied_moves += counters.denied;
+            }
+            const bool stop = travelling == 0 || t >= limit;
+            channel.SetStop(stop);
+            if (!channel.Wait(alive))
+                break;
+            if (stop)
+            {
+                failed = travelling != 0;
+                timesteps = (int)t;
+                completed = true;
+                break;
+            }
+            if (!channel.Wait(alive) || !channel.Wait(alive))
+                break;
+        }
+    }
+    catch (...)
+    {
+        channel.Abort("The coordinator failed.");
+        reap(true);
+        throw;
+    }
+
+    reap(!completed);
+    if (!completed)
+    {
+        const std::string error = channel.Error();
+        throw std::runtime_error(error.empty() ? "Sharded planning was aborted." : error);
+    }
+    return !failed;
+}
+
+std::size_t ShardedPlanner::SumOfCosts() const
+{
+    std::vector<int> last_away(starts.size(), -1);
+    for (std::size_t t = paths.FirstTimestep(); t < paths.NumTimesteps(); ++t)
+    {
+        Span<const int32_t> vertices = paths.Vertices(t);
+        for (std::size_t i = 0; i < starts.size(); ++i)
+        {
+            if (vertices[i] != goals[i])
+                last_away[i] = (int)t;
+        }
+    }
+
+    std::size_t cost = 0;
+    for (int t : last_away)
+        cost += t + 1;
+    return cost;
+}
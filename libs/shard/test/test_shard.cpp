@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "generator.h"
+#include "sharded_planner.h"
+#include "validator.h"
+
+namespace {
+    struct Instance {
+        std::vector<int32_t> starts, goals, headings;
+    };
+
+    // Agents starting in the left half, with goals mirrored into the right half
+    Instance Crossing(const Graph &graph, int count) {
+        Instance agents;
+        for (int i = 0; i < count; ++i) {
+            const int x = i % (graph.width / 2), y = i / (graph.width / 2) * 2;
+            agents.starts.push_back(graph.GetId(x, y));
+            agents.goals.push_back(graph.GetId(graph.width - 1 - x, graph.height - 1 - y));
+            agents.headings.push_back(i % 4);
+        }
+        return agents;
+    }
+
+    bool ValidPaths(const ShardedPlanner &planner, std::size_t num_agents, MotionModel model) {
+        ValidatorOptions options;
+        options.motion_model = model;
+        options.num_threads = 1;
+        Validator validator(*planner.graph, num_agents, options);
+        validator.Check(planner.paths, 0, planner.paths.NumTimesteps());
+        return validator.Valid();
+    }
+
+    bool VisitedGoals(const ShardedPlanner &planner, const Instance &agents) {
+        for (std::size_t a = 0; a < agents.goals.size(); ++a) {
+            bool visited = false;
+            for (std::size_t t = 0; t < planner.paths.NumTimesteps() && !visited; ++t)
+                visited = planner.paths.Vertices(t)[a] == agents.goals[a];
+            if (!visited)
+                return false;
+        }
+        return true;
+    }
+
+    Span<const int32_t> View(const std::vector<int32_t> &v) {
+        return Span<const int32_t>(v.data(), v.size());
+    }
+}
+
+// Test case 1: Verify shards are contiguous column ranges of balanced size, and border vertices
+TEST(ShardTest, Layout) {
+    auto graph = std::make_shared<Graph>(12, 6);
+    for (int y = 0; y < 6; ++y) {
+        graph->SetBlocked(graph->GetId(0, y), true);
+        graph->SetBlocked(graph->GetId(1, y), true);
+    }
+    ShardLayout layout(*graph, 2);
+    ASSERT_EQ(layout.NumShards(), 2);
+    ASSERT_EQ(layout.first_column, (std::vector<int>{0, 7, 12}));
+    EXPECT_EQ(layout.Owner(graph->GetId(6, 3)), 0);
+    EXPECT_EQ(layout.Owner(graph->GetId(7, 3)), 1);
+    EXPECT_TRUE(layout.IsBorder(graph->GetId(6, 0)));
+    EXPECT_TRUE(layout.IsBorder(graph->GetId(7, 5)));
+    EXPECT_FALSE(layout.IsBorder(graph->GetId(5, 2)));
+    EXPECT_TRUE(layout.Touches(graph->GetId(6, 2), 1));
+    EXPECT_FALSE(layout.Touches(graph->GetId(5, 2), 1));
+    EXPECT_EQ(layout.border_sizes, (std::vector<std::size_t>{6, 6}));
+
+    ShardLayout halo(*graph, 2, 3);
+    EXPECT_TRUE(halo.Touches(graph->GetId(4, 2), 1));
+    EXPECT_FALSE(halo.Touches(graph->GetId(3, 2), 1));
+    EXPECT_TRUE(halo.Touches(graph->GetId(9, 2), 0));
+    EXPECT_FALSE(halo.Touches(graph->GetId(10, 2), 0));
+    EXPECT_EQ(halo.border_sizes, (std::vector<std::size_t>{18, 18}));
+
+    ShardLayout narrow(*graph, 12);
+    for (int s = 0; s < 12; ++s)
+        EXPECT_EQ(narrow.first_column[s], s);
+    EXPECT_THROW(ShardLayout(*graph, 0), std::invalid_argument);
+    EXPECT_THROW(ShardLayout(*graph, 13), std::invalid_argument);
+    EXPECT_THROW(ShardLayout(*graph, 2, 0), std::invalid_argument);
+}
+
+// Test case 2: Verify agents crossing every border reach their goals along conflict-free paths
+TEST(ShardTest, SolvesAcrossBorders) {
+    auto graph = std::make_shared<Graph>(24, 12);
+    graph->SetBlocked(graph->GetId(11, 5), true);
+    graph->SetBlocked(graph->GetId(12, 6), true);
+    const Instance agents = Crossing(*graph, 30);
+    for (int num_shards : {1, 2, 3}) {
+        PibtOptions options;
+        options.seed = 3;
+        ShardOptions shard_options;
+        shard_options.num_shards = num_shards;
+        ShardedPlanner planner(graph, View(agents.starts), View(agents.goals), View(agents.headings), options, shard_options);
+        ASSERT_TRUE(planner.Run()) << num_shards << " shards";
+        EXPECT_FALSE(planner.failed);
+        EXPECT_GT(planner.timesteps, 0);
+        EXPECT_TRUE(VisitedGoals(planner, agents));
+        EXPECT_TRUE(ValidPaths(planner, agents.starts.size(), MotionModel::RotateThenMove));
+        EXPECT_GE(planner.SumOfCosts(), agents.starts.size());
+        if (num_shards == 1)
+            EXPECT_EQ(planner.handoffs, 0u);
+        else
+            EXPECT_GE(planner.handoffs, agents.starts.size());
+    }
+}
+
+// Test case 3: Verify the holonomic motion model over many thin shards
+TEST(ShardTest, Holonomic) {
+    auto graph = std::make_shared<Graph>(16, 10);
+    const Instance agents = Crossing(*graph, 24);
+    PibtOptions options;
+    options.seed = 7;
+    options.motion_model = MotionModel::Holonomic;
+    ShardOptions shard_options;
+    shard_options.num_shards = 4;
+    ShardedPlanner planner(graph, View(agents.starts), View(agents.goals), View(agents.headings), options, shard_options);
+    ASSERT_TRUE(planner.Run());
+    EXPECT_TRUE(VisitedGoals(planner, agents));
+    EXPECT_TRUE(ValidPaths(planner, agents.starts.size(), MotionModel::Holonomic));
+    EXPECT_GT(planner.handoffs, 0u);
+}
+
+// Test case 4: Verify shelf aisles and room doors, where pushes run along corridors across the borders
+TEST(ShardTest, StructuredMaps) {
+    for (MapFamily family : {MapFamily::Warehouse, MapFamily::Rooms}) {
+        GeneratorOptions generator;
+        generator.family = family;
+        generator.width = generator.height = 64;
+        generator.num_agents = 100;
+        generator.seed = 1;
+        const GeneratedInstance instance = Generate(generator);
+        PibtOptions options;
+        options.seed = 1;
+        ShardOptions shard_options;
+        shard_options.num_shards = 4;
+        ShardedPlanner planner(instance.graph, View(instance.starts), View(instance.goals), View(instance.headings), options,
+                               shard_options);
+        ASSERT_TRUE(planner.Run()) << (int)family;
+        EXPECT_TRUE(ValidPaths(planner, instance.starts.size(), MotionModel::RotateThenMove));
+        EXPECT_GT(planner.handoffs, 0u);
+    }
+}
+
+// Test case 5: Verify a run that hits max_timesteps reports failure
+TEST(ShardTest, TimestepLimit) {
+    auto graph = std::make_shared<Graph>(16, 8);
+    const Instance agents = Crossing(*graph, 8);
+    PibtOptions options;
+    options.max_timesteps = 3;
+    ShardedPlanner planner(graph, View(agents.starts), View(agents.goals), View(agents.headings), options);
+    EXPECT_FALSE(planner.Run());
+    EXPECT_TRUE(planner.failed);
+    EXPECT_EQ(planner.timesteps, 3);
+    EXPECT_EQ(planner.paths.NumTimesteps(), 4u);
+    EXPECT_TRUE(ValidPaths(planner, agents.starts.size(), MotionModel::RotateThenMove));
+}
+
+// Test case 6: Verify invalid instances and options are rejected
+TEST(ShardTest, InvalidArguments) {
+    auto graph = std::make_shared<Graph>(8, 8);
+    const Instance agents = Crossing(*graph, 4);
+    PibtOptions options;
+    options.rotation_steps = 2;
+    EXPECT_THROW(ShardedPlanner(graph, View(agents.starts), View(agents.goals), View(agents.headings), options),
+                 std::invalid_argument);
+
+    std::vector<int32_t> short_goals(agents.goals.begin(), agents.goals.end() - 1);
+    EXPECT_THROW(ShardedPlanner(graph, View(agents.starts), View(short_goals), View(agents.headings)), std::invalid_argument);
+
+    ShardOptions shard_options;
+    shard_options.num_shards = 9;
+    EXPECT_THROW(ShardedPlanner(graph, View(agents.starts), View(agents.goals), View(agents.headings), PibtOptions(), shard_options),
+                 std::invalid_argument);
+    shard_options.num_shards = 2;
+    shard_options.halo_depth = 0;
+    EXPECT_THROW(ShardedPlanner(graph, View(agents.starts), View(agents.goals), View(agents.headings), PibtOptions(), shard_options),
+                 std::invalid_argument);
+}
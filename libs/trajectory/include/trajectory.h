@@ -0,0 +1,112 @@
+#pragma once
+
+#include <graph.h>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Binary record of agent states over a run, written one timestep at a time.
+//
+// Layout (little endian):
+//   TrajectoryHeader
+//   blocks, each covering up to block_timesteps timesteps:
+//     uint32 num_timesteps, uint32 raw_size, uint32 stored_size
+//     stored_size bytes: the raw payload, deflated with zlib when stored_size != raw_size
+//
+// A block's payload starts with a keyframe holding every agent, varint(vertex * 8 + heading),
+// so blocks decode independently. Each further timestep lists only the agents that moved or
+// turned: varint(count), then per agent varint(id gap from the previous listed agent) and one
+// byte, heading | move << 3, where move is 0 (turn), 1 (x + 1), 2 (x - 1), 3 (y + 1), 4 (y - 1)
+// or 5 (any other vertex, followed by a zigzag varint of the vertex id difference).
+struct TrajectoryHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    int32_t width;
+    int32_t height;
+    uint32_t num_agents;
+    uint32_t block_timesteps;
+    uint64_t num_timesteps; // filled in by Close; kUnknownTimesteps if the writer did not finish
+};
+
+class TrajectoryWriter
+{
+public:
+    static constexpr char kMagic[8] = {'P', 'I', 'B', 'T', 'T', 'R', 'A', 'J'};
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kCompressed = 1;
+    static constexpr uint64_t kUnknownTimesteps = ~uint64_t(0);
+    static constexpr std::size_t kDefaultBlockTimesteps = 256;
+
+    // Compression is skipped when the library was built without zlib
+    TrajectoryWriter(const std::string &path, int _width, int _height, std::size_t _num_agents,
+                     bool compress = true, std::size_t _block_timesteps = kDefaultBlockTimesteps);
+    ~TrajectoryWriter();
+
+    TrajectoryWriter(const TrajectoryWriter &) = delete;
+    TrajectoryWriter &operator=(const TrajectoryWriter &) = delete;
+
+    // Records the next timestep; both spans are indexed by agent id
+    void Append(Span<const int32_t> vertices, Span<const Direction> headings);
+    // Flushes the last block and records the timestep count; called by the destructor
+    void Close();
+
+    std::size_t NumTimesteps() const { return num_timesteps; }
+    std::size_t BytesWritten() const { return bytes_written; }
+
+private:
+    void FlushBlock();
+
+    std::ofstream out;
+    TrajectoryHeader header;
+    std::size_t num_agents;
+    std::size_t block_timesteps;
+    std::size_t num_timesteps = 0;
+    std::size_t block_rows = 0;
+    std::size_t bytes_written = 0;
+    std::vector<int32_t> last_vertices;
+    std::vector<Direction> last_headings;
+    std::vector<uint8_t> raw;
+    std::vector<uint8_t> packed;
+};
+
+class TrajectoryReader
+{
+public:
+    explicit TrajectoryReader(const std::string &path);
+
+    // Advances to the next timestep; false once every timestep has been read
+    bool Next();
+    // Positions the reader on timestep t, decoding only its block; false if t is past the end
+    bool Seek(std::size_t t);
+
+    int Width() const { return header.width; }
+    int Height() const { return header.height; }
+    std::size_t NumAgents() const { return header.num_agents; }
+    // kUnknownTimesteps when the file was not closed
+    uint64_t NumTimesteps() const { return header.num_timesteps; }
+
+    // State at the current timestep, indexed by agent id; valid after Next or Seek returned true
+    std::size_t Timestep() const { return timestep; }
+    Span<const int32_t> Vertices() const { return Span<const int32_t>(vertices.data(), vertices.size()); }
+    Span<const Direction> Headings() const { return Span<const Direction>(headings.data(), headings.size()); }
+
+private:
+    bool LoadBlock();
+    void DecodeTimestep();
+
+    std::ifstream in;
+    TrajectoryHeader header;
+    std::size_t timestep = 0;
+    std::size_t next_timestep = 0; // timestep the next Next() decodes
+    std::size_t block_remaining = 0;
+    bool block_start = false;
+    std::vector<uint8_t> raw;
+    std::vector<uint8_t> packed;
+    std::size_t cursor = 0;
+    std::vector<int32_t> vertices;
+    std::vector<Direction> headings;
+};
@@ -0,0 +1,339 @@
+#include "trajectory.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef PIBT_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+constexpr char TrajectoryWriter::kMagic[8];
+
+namespace
+{
+    enum Move : uint8_t
+    {
+        kTurn = 0,
+        kRight = 1,
+        kLeft = 2,
+        kDown = 3,
+        kUp = 4,
+        kJump = 5
+    };
+
+    void PutVarint(std::vector<uint8_t> &out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((uint8_t)value);
+    }
+
+    uint64_t GetVarint(const std::vector<uint8_t> &in, std::size_t &cursor)
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (cursor >= in.size())
+                throw std::runtime_error("Truncated trajectory block.");
+            uint8_t byte = in[cursor++];
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw std::runtime_error("Corrupt trajectory varint.");
+    }
+
+    uint64_t ZigZag(int64_t value)
+    {
+        return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    }
+
+    int64_t UnZigZag(uint64_t value)
+    {
+        return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    }
+
+    void PutU32(std::ofstream &out, uint32_t value)
+    {
+        out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+}
+
+TrajectoryWriter::TrajectoryWriter(const std::string &path, int _width, int _height, std::size_t _num_agents,
+                                   bool compress, std::size_t _block_timesteps)
+    : out(path, std::ios::binary | std::ios::trunc),
+      header(),
+      num_agents(_num_agents),
+      block_timesteps(_block_timesteps ? _block_timesteps : 1),
+      last_vertices(_num_agents),
+      last_headings(_num_agents)
+{
+    if (!out)
+    {
+        throw std::runtime_error("Cannot write trajectory: " + path);
+    }
+
+    std::memcpy(header.magic, kMagic, sizeof(header.magic));
+    header.version = kVersion;
+#ifdef PIBT_HAVE_ZLIB
+    header.flags = compress ? kCompressed : 0;
+#else
+    (void)compress;
+    header.flags = 0;
+#endif
+    header.width = _width;
+    header.height = _height;
+    header.num_agents = (uint32_t)num_agents;
+    header.block_timesteps = (uint32_t)block_timesteps;
+    header.num_timesteps = kUnknownTimesteps;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    bytes_written = sizeof(header);
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+    try
+    {
+        Close();
+    }
+    catch (...)
+    {
+    }
+}
+
+void TrajectoryWriter::Append(Span<const int32_t> vertices, Span<const Direction> headings)
+{
+    if (vertices.size() != num_agents || headings.size() != num_agents)
+    {
+        throw std::invalid_argument("Trajectory row does not match the agent count.");
+    }
+
+    if (block_rows == 0)
+    {
+        // Keyframe
+        for (std::size_t i = 0; i < num_agents; ++i)
+            PutVarint(raw, (uint64_t)vertices[i] * 8 + headings[i]);
+    }
+    else
+    {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < num_agents; ++i)
+            count += vertices[i] != last_vertices[i] || headings[i] != last_headings[i];
+        PutVarint(raw, count);
+
+        long long previous = -1;
+        for (std::size_t i = 0; i < num_agents; ++i)
+        {
+            if (vertices[i] == last_vertices[i] && headings[i] == last_headings[i])
+                continue;
+
+            PutVarint(raw, (uint64_t)((long long)i - previous - 1));
+            previous = (long long)i;
+
+            const int64_t delta = (int64_t)vertices[i] - last_vertices[i];
+            Move move = delta == 0 ? kTurn : delta == 1 ? kRight : delta == -1 ? kLeft
+                                         : delta == header.width ? kDown : delta == -header.width ? kUp : kJump;
+            raw.push_back((uint8_t)(headings[i] | move << 3));
+            if (move == kJump)
+                PutVarint(raw, ZigZag(delta));
+        }
+    }
+
+    std::memcpy(last_vertices.data(), vertices.data(), num_agents * sizeof(int32_t));
+    std::memcpy(last_headings.data(), headings.data(), num_agents * sizeof(Direction));
+    ++num_timesteps;
+    if (++block_rows == block_timesteps)
+        FlushBlock();
+}
+
+void TrajectoryWriter::FlushBlock()
+{
+    if (block_rows == 0)
+        return;
+
+    const uint8_t *stored = raw.data();
+    std::size_t stored_size = raw.size();
+#ifdef PIBT_HAVE_ZLIB
+    if (header.flags & kCompressed)
+    {
+        uLongf packed_size = compressBound(raw.size());
+        packed.resize(packed_size);
+        if (compress2(packed.data(), &packed_size, raw.data(), raw.size(), Z_BEST_SPEED) == Z_OK &&
+            packed_size < raw.size())
+        {
+            stored = packed.data();
+            stored_size = packed_size;
+        }
+    }
+#endif
+
+    PutU32(out, (uint32_t)block_rows);
+    PutU32(out, (uint32_t)raw.size());
+    PutU32(out, (uint32_t)stored_size);
+    out.write(reinterpret_cast<const char *>(stored), stored_size);
+    if (!out)
+    {
+        throw std::runtime_error("Failed writing trajectory block.");
+    }
+    bytes_written += 3 * sizeof(uint32_t) + stored_size;
+    raw.clear();
+    block_rows = 0;
+}
+
+void TrajectoryWriter::Close()
+{
+    if (!out.is_open())
+        return;
+
+    FlushBlock();
+    header.num_timesteps = num_timesteps;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.close();
+}
+
+TrajectoryReader::TrajectoryReader(const std::string &path)
+    : in(path, std::ios::binary),
+      header()
+{
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)))
+    {
+        throw std::runtime_error("Cannot read trajectory: " + path);
+    }
+    if (std::memcmp(header.magic, TrajectoryWriter::kMagic, sizeof(header.magic)) != 0)
+    {
+        throw std::runtime_error("Not a trajectory file: " + path);
+    }
+    if (header.version != TrajectoryWriter::kVersion)
+    {
+        throw std::runtime_error("Unsupported trajectory version: " + path);
+    }
+#ifndef PIBT_HAVE_ZLIB
+    if (header.flags & TrajectoryWriter::kCompressed)
+    {
+        throw std::runtime_error("Trajectory is compressed, but zlib support is not built in: " + path);
+    }
+#endif
+
+    vertices.resize(header.num_agents);
+    headings.resize(header.num_agents);
+}
+
+// Reads the next block into `raw`; false at the end of the file
+bool TrajectoryReader::LoadBlock()
+{
+    uint32_t sizes[3];
+    if (!in.read(reinterpret_cast<char *>(sizes), sizeof(sizes)))
+        return false;
+
+    const uint32_t num_rows = sizes[0], raw_size = sizes[1], stored_size = sizes[2];
+    raw.resize(raw_size);
+    if (stored_size == raw_size)
+    {
+        in.read(reinterpret_cast<char *>(raw.data()), raw_size);
+    }
+    else
+    {
+#ifdef PIBT_HAVE_ZLIB
+        packed.resize(stored_size);
+        in.read(reinterpret_cast<char *>(packed.data()), stored_size);
+        uLongf size = raw_size;
+        if (!in || uncompress(raw.data(), &size, packed.data(), stored_size) != Z_OK || size != raw_size)
+            throw std::runtime_error("Corrupt trajectory block.");
+#else
+        throw std::runtime_error("Trajectory block is compressed, but zlib support is not built in.");
+#endif
+    }
+    if (!in)
+        throw std::runtime_error("Truncated trajectory block.");
+
+    block_remaining = num_rows;
+    block_start = true;
+    cursor = 0;
+    return num_rows > 0;
+}
+
+void TrajectoryReader::DecodeTimestep()
+{
+    if (block_start)
+    {
+        for (uint32_t i = 0; i < header.num_agents; ++i)
+        {
+            uint64_t state = GetVarint(raw, cursor);
+            vertices[i] = (int32_t)(state >> 3);
+            headings[i] = (Direction)(state & 7);
+        }
+        block_start = false;
+        return;
+    }
+
+    const uint64_t count = GetVarint(raw, cursor);
+    uint64_t agent = ~uint64_t(0);
+    for (uint64_t k = 0; k < count; ++k)
+    {
+        agent += GetVarint(raw, cursor) + 1;
+        if (agent >= header.num_agents || cursor >= raw.size())
+            throw std::runtime_error("Corrupt trajectory timestep.");
+
+        const uint8_t code = raw[cursor++];
+        headings[agent] = (Direction)(code & 7);
+        switch (code >> 3)
+        {
+        case kTurn:
+            break;
+        case kRight:
+            vertices[agent] += 1;
+            break;
+        case kLeft:
+            vertices[agent] -= 1;
+            break;
+        case kDown:
+            vertices[agent] += header.width;
+            break;
+        case kUp:
+            vertices[agent] -= header.width;
+            break;
+        default:
+            vertices[agent] += (int32_t)UnZigZag(GetVarint(raw, cursor));
+            break;
+        }
+    }
+}
+
+bool TrajectoryReader::Next()
+{
+    if (block_remaining == 0 && !LoadBlock())
+        return false;
+
+    DecodeTimestep();
+    --block_remaining;
+    timestep = next_timestep++;
+    return true;
+}
+
+bool TrajectoryReader::Seek(std::size_t t)
+{
+    // Every block but the last holds block_timesteps rows, so whole blocks can be skipped by size
+    in.clear();
+    in.seekg(sizeof(header));
+    block_remaining = 0;
+    next_timestep = 0;
+    for (std::size_t first = 0; t >= first + header.block_timesteps; first += header.block_timesteps)
+    {
+        uint32_t sizes[3];
+        if (!in.read(reinterpret_cast<char *>(sizes), sizeof(sizes)))
+            return false;
+        in.seekg(sizes[2], std::ios::cur);
+        next_timestep += sizes[0];
+    }
+
+    while (next_timestep <= t)
+    {
+        if (!Next())
+            return false;
+    }
+    return true;
+}
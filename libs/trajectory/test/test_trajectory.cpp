@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "trajectory.h"
+
+namespace {
+    // Random walk of agents on a width x 20 grid with turns, waits and the odd teleport
+    std::vector<std::vector<int32_t>> MakeRun(int width, std::size_t agents, std::size_t timesteps,
+                                              std::vector<std::vector<Direction>> &headings) {
+        std::mt19937 rng(9);
+        std::vector<std::vector<int32_t>> vertices(timesteps, std::vector<int32_t>(agents));
+        headings.assign(timesteps, std::vector<Direction>(agents, Direction::Up));
+        for (std::size_t a = 0; a < agents; ++a)
+            vertices[0][a] = (int32_t)(rng() % (width * 20));
+        for (std::size_t t = 1; t < timesteps; ++t) {
+            for (std::size_t a = 0; a < agents; ++a) {
+                const int32_t deltas[] = {0, 0, 0, 1, -1, width, -width, 777};
+                vertices[t][a] = vertices[t - 1][a] + deltas[rng() % 8];
+                headings[t][a] = rng() % 4 == 0 ? (Direction)(rng() % 4) : headings[t - 1][a];
+            }
+        }
+        return vertices;
+    }
+}
+
+// Test case 1: Verify a written trajectory reads back unchanged, with and without compression
+TEST(TrajectoryTest, RoundTrip) {
+    const std::string path = "test_roundtrip.traj";
+    std::vector<std::vector<Direction>> headings;
+    auto vertices = MakeRun(30, 50, 1000, headings);
+
+    for (bool compress : {false, true}) {
+        {
+            TrajectoryWriter writer(path, 30, 20, 50, compress, 64);
+            for (std::size_t t = 0; t < vertices.size(); ++t) {
+                writer.Append(Span<const int32_t>(vertices[t].data(), 50),
+                              Span<const Direction>(headings[t].data(), 50));
+            }
+            EXPECT_EQ(writer.NumTimesteps(), 1000);
+            // Far below the 5 bytes per agent-step of a dense history
+            EXPECT_LT(writer.BytesWritten(), 1000 * 50 * 5 / 2);
+        }
+
+        TrajectoryReader reader(path);
+        EXPECT_EQ(reader.Width(), 30);
+        EXPECT_EQ(reader.Height(), 20);
+        EXPECT_EQ(reader.NumAgents(), 50);
+        EXPECT_EQ(reader.NumTimesteps(), 1000);
+        std::size_t t = 0;
+        while (reader.Next()) {
+            ASSERT_EQ(reader.Timestep(), t);
+            for (std::size_t a = 0; a < 50; ++a) {
+                ASSERT_EQ(reader.Vertices()[a], vertices[t][a]) << "t=" << t << " agent " << a;
+                ASSERT_EQ(reader.Headings()[a], headings[t][a]) << "t=" << t << " agent " << a;
+            }
+            ++t;
+        }
+        EXPECT_EQ(t, 1000);
+
+        // Random access decodes a single block
+        ASSERT_TRUE(reader.Seek(700));
+        EXPECT_EQ(reader.Timestep(), 700);
+        EXPECT_EQ(reader.Vertices()[7], vertices[700][7]);
+        ASSERT_TRUE(reader.Seek(64));
+        EXPECT_EQ(reader.Vertices()[3], vertices[64][3]);
+        ASSERT_TRUE(reader.Next());
+        EXPECT_EQ(reader.Vertices()[3], vertices[65][3]);
+        EXPECT_FALSE(reader.Seek(1000));
+    }
+    std::remove(path.c_str());
+}
+
+// Test case 2: Verify agents that neither move nor turn cost nothing but their count
+TEST(TrajectoryTest, StillAgents) {
+    const std::string path = "test_still.traj";
+    std::vector<int32_t> vertices(1000, 5);
+    std::vector<Direction> headings(1000, Direction::Left);
+    {
+        TrajectoryWriter writer(path, 10, 10, 1000, false, 100);
+        for (int t = 0; t < 100; ++t)
+            writer.Append(Span<const int32_t>(vertices.data(), 1000), Span<const Direction>(headings.data(), 1000));
+        // Header, one block header, a 1000-agent keyframe and a 1-byte count per later timestep
+        EXPECT_EQ(writer.BytesWritten(), sizeof(TrajectoryHeader) + 12 + 1000 + 99);
+    }
+    TrajectoryReader reader(path);
+    ASSERT_TRUE(reader.Seek(99));
+    EXPECT_EQ(reader.Vertices()[999], 5);
+    EXPECT_EQ(reader.Headings()[999], Direction::Left);
+    EXPECT_FALSE(reader.Next());
+    std::remove(path.c_str());
+}
+
+// Test case 3: Verify bad input is rejected
+TEST(TrajectoryTest, Errors) {
+    const std::string path = "test_bad.traj";
+    {
+        std::ofstream out(path);
+        out << "not a trajectory file at all, just some text";
+    }
+    EXPECT_THROW(TrajectoryReader reader(path), std::runtime_error);
+    EXPECT_THROW(TrajectoryReader reader("missing.traj"), std::runtime_error);
+
+    TrajectoryWriter writer(path, 4, 4, 3);
+    std::vector<int32_t> vertices(2);
+    std::vector<Direction> headings(2);
+    EXPECT_THROW(writer.Append(Span<const int32_t>(vertices.data(), 2), Span<const Direction>(headings.data(), 2)),
+                 std::invalid_argument);
+    writer.Close();
+    std::remove(path.c_str());
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <graph.h>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "motion_model.h"
+#include "path_store.h"
+#include "thread_pool.h"
+
+enum class ViolationType : uint8_t
+{
+    InvalidVertex,  // off the grid or on an obstacle
+    VertexConflict, // two agents on one vertex
+    SwapConflict,   // two agents traversing one edge in opposite directions
+    IllegalMove,    // next vertex is neither the current one nor a neighbour
+    IllegalHeading  // heading that breaks the motion model's rules, see ValidatorOptions::motion_model
+};
+
+const char *ViolationTypeToString(ViolationType type);
+
+struct Violation
+{
+    ViolationType type;
+    std::size_t timestep; // the later timestep of a transition
+    int agent;
+    int other;  // second agent of a conflict, -1 otherwise
+    int vertex; // where it happened: the agent's vertex at `timestep`
+};
+
+struct ValidatorOptions
+{
+    // Enforce the heading rules of motion_model
+    bool check_headings = true;
+    // RotateThenMove: an agent moves only along its heading's axis and keeps its heading while doing
+    // so, and turns in place by 90 degrees at a time. Holonomic: the heading is the direction of the
+    // last move and does not change in place.
+    MotionModel motion_model = MotionModel::RotateThenMove;
+    // Violations kept for reporting; every violation is still counted
+    std::size_t max_violations = 100;
+    // Checking threads, 0 for one per hardware thread
+    std::size_t num_threads = 0;
+};
+
+// Checks agent paths for collisions and illegal motion, timesteps in parallel. Rows can be fed in
+// windows, e.g. while streaming a trajectory: each Check continues from the last row seen.
+class Validator
+{
+public:
+    Validator(const Graph &_graph, std::size_t _num_agents, const ValidatorOptions &_options = ValidatorOptions());
+
+    // Checks rows [first, last) of paths, and the transition from the last row of the previous
+    // Check into row `first`. Violations are numbered by timesteps checked so far, not by row.
+    void Check(const PathStore &paths, std::size_t first, std::size_t last);
+    void Check(const PathStore &paths) { Check(paths, paths.FirstTimestep(), paths.NumTimesteps()); }
+
+    bool Valid() const { return num_violations == 0; }
+    std::size_t NumViolations() const { return num_violations; }
+    std::size_t NumViolations(ViolationType type) const { return counts[(std::size_t)type]; }
+    std::size_t NumTimesteps() const { return timesteps_checked; }
+    // The earliest violations, ordered by timestep and agent
+    const std::vector<Violation> &Violations() const { return violations; }
+
+private:
+    // Per-thread scratch: occupancy bitset of the current row and owners of the previous row's vertices
+    struct Workspace
+    {
+        std::vector<uint64_t> occupied;
+        std::vector<int32_t> owner;
+        std::vector<Violation> found;
+        std::size_t counts[5] = {};
+    };
+
+    void CheckRow(Workspace &ws, std::size_t timestep, const int32_t *previous, const Direction *previous_headings,
+                  const int32_t *vertices, const Direction *headings);
+    void Report(Workspace &ws, ViolationType type, std::size_t timestep, int agent, int other, int vertex);
+
+    const Graph &graph;
+    std::size_t num_agents;
+    ValidatorOptions options;
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<Workspace> workspaces;
+
+    std::vector<int32_t> last_vertices; // last row of the previous Check
+    std::vector<Direction> last_headings;
+    std::size_t timesteps_checked = 0;
+
+    std::vector<Violation> violations;
+    std::size_t counts[5] = {};
+    std::size_t num_violations = 0;
+};
@@ -0,0 +1,238 @@
+#include "validator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    bool Earlier(const Violation &a, const Violation &b)
+    {
+        if (a.timestep != b.timestep)
+            return a.timestep < b.timestep;
+        if (a.agent != b.agent)
+            return a.agent < b.agent;
+        return a.type < b.type;
+    }
+
+    // 0 for Up/Down, 1 for Left/Right
+    int Axis(Direction d)
+    {
+        return d >> 1;
+    }
+}
+
+const char *ViolationTypeToString(ViolationType type)
+{
+    switch (type)
+    {
+    case ViolationType::InvalidVertex:
+        return "invalid vertex";
+    case ViolationType::VertexConflict:
+        return "vertex conflict";
+    case ViolationType::SwapConflict:
+        return "swap conflict";
+    case ViolationType::IllegalMove:
+        return "illegal move";
+    case ViolationType::IllegalHeading:
+        return "illegal heading";
+    }
+    return "unknown";
+}
+
+Validator::Validator(const Graph &_graph, std::size_t _num_agents, const ValidatorOptions &_options)
+    : graph(_graph),
+      num_agents(_num_agents),
+      options(_options),
+      pool(std::make_unique<ThreadPool>(_options.num_threads)),
+      workspaces(pool->Size())
+{
+    for (Workspace &ws : workspaces)
+    {
+        ws.occupied.assign((graph.Size() + 63) / 64, 0);
+        ws.owner.assign(graph.Size(), -1);
+    }
+}
+
+void Validator::Report(Workspace &ws, ViolationType type, std::size_t timestep, int agent, int other, int vertex)
+{
+    ++ws.counts[(std::size_t)type];
+    ws.found.push_back({type, timestep, agent, other, vertex});
+
+    // Keep the scratch list bounded when most of the plan is broken
+    if (ws.found.size() >= 2 * options.max_violations + 64)
+    {
+        std::sort(ws.found.begin(), ws.found.end(), Earlier);
+        ws.found.resize(options.max_violations);
+    }
+}
+
+void Validator::CheckRow(Workspace &ws, std::size_t timestep, const int32_t *previous, const Direction *previous_headings,
+                         const int32_t *vertices, const Direction *headings)
+{
+    const int32_t size = (int32_t)graph.Size();
+    const bool holonomic = options.motion_model == MotionModel::Holonomic;
+    auto valid = [&](int32_t v)
+    { return v >= 0 && v < size && !graph.IsBlocked(v); };
+
+    for (std::size_t a = 0; a < num_agents; ++a)
+    {
+        const int32_t v = vertices[a];
+        if (!valid(v))
+        {
+            Report(ws, ViolationType::InvalidVertex, timestep, (int)a, -1, v);
+            continue;
+        }
+        uint64_t &word = ws.occupied[v >> 6];
+        const uint64_t bit = uint64_t(1) << (v & 63);
+        if (word & bit)
+        {
+            // Rare, so find the first occupant by scanning
+            std::size_t other = 0;
+            while (vertices[other] != v)
+                ++other;
+            Report(ws, ViolationType::VertexConflict, timestep, (int)a, (int)other, v);
+        }
+        word |= bit;
+    }
+
+    if (previous)
+    {
+        for (std::size_t a = 0; a < num_agents; ++a)
+        {
+            if (valid(previous[a]))
+                ws.owner[previous[a]] = (int32_t)a;
+        }
+
+        for (std::size_t a = 0; a < num_agents; ++a)
+        {
+            const int32_t u = previous[a], v = vertices[a];
+            if (!valid(u) || !valid(v))
+                continue;
+            const Direction h0 = previous_headings[a], h1 = headings[a];
+            if (options.check_headings && (h0 > Direction::None || h1 > Direction::None))
+            {
+                Report(ws, ViolationType::IllegalHeading, timestep, (int)a, -1, v);
+                continue;
+            }
+
+            if (u == v)
+            {
+                // Turning in place: a quarter turn between two real headings, never for holonomic agents
+                if (options.check_headings && h0 != h1 &&
+                    (holonomic || h0 == Direction::None || h1 == Direction::None || Axis(h0) == Axis(h1)))
+                {
+                    Report(ws, ViolationType::IllegalHeading, timestep, (int)a, -1, v);
+                }
+                continue;
+            }
+
+            Direction move = Direction::None;
+            bool adjacent = false;
+            for (const Neighbor &n : graph.GetNeighbors(u))
+            {
+                if (n.id == v)
+                {
+                    move = n.direction;
+                    adjacent = true;
+                }
+            }
+            if (!adjacent)
+            {
+                Report(ws, ViolationType::IllegalMove, timestep, (int)a, -1, v);
+                continue;
+            }
+
+            const int32_t b = ws.owner[v];
+            if (b > (int32_t)a && vertices[b] == u)
+            {
+                Report(ws, ViolationType::SwapConflict, timestep, (int)a, b, v);
+            }
+
+            // Moving: forwards or backwards along the heading, which is kept. Without a heading, or for
+            // holonomic agents, the heading becomes the direction of the move. Roadmap edges without a
+            // direction keep any heading.
+            if (options.check_headings)
+            {
+                bool legal = move == Direction::None              ? h1 == h0
+                             : holonomic || h0 == Direction::None ? h1 == move
+                                                     : Axis(h0) == Axis(move) && h1 == h0;
+                if (!legal)
+                    Report(ws, ViolationType::IllegalHeading, timestep, (int)a, -1, v);
+            }
+        }
+
+        for (std::size_t a = 0; a < num_agents; ++a)
+        {
+            if (valid(previous[a]))
+                ws.owner[previous[a]] = -1;
+        }
+    }
+
+    for (std::size_t a = 0; a < num_agents; ++a)
+    {
+        if (valid(vertices[a]))
+            ws.occupied[vertices[a] >> 6] = 0;
+    }
+}
+
+void Validator::Check(const PathStore &paths, std::size_t first, std::size_t last)
+{
+    if (last <= first)
+        return;
+    if (paths.NumAgents() != num_agents)
+    {
+        throw std::invalid_argument("Paths do not match the validator's agent count.");
+    }
+
+    // Enough rows per task to amortise scheduling when there are few agents
+    const std::size_t rows = last - first;
+    const std::size_t rows_per_task = std::max<std::size_t>(1, 65536 / std::max<std::size_t>(num_agents, 1));
+    const std::size_t num_tasks = (rows + rows_per_task - 1) / rows_per_task;
+    const bool has_previous = timesteps_checked > 0;
+
+    pool->ParallelFor(num_tasks, [&](std::size_t task, std::size_t worker)
+                      {
+        Workspace &ws = workspaces[worker];
+        const std::size_t end = std::min(last, first + (task + 1) * rows_per_task);
+        for (std::size_t t = first + task * rows_per_task; t < end; ++t)
+        {
+            const int32_t *previous = nullptr;
+            const Direction *previous_headings = nullptr;
+            if (t > first)
+            {
+                previous = paths.Vertices(t - 1).data();
+                previous_headings = paths.Headings(t - 1).data();
+            }
+            else if (has_previous)
+            {
+                previous = last_vertices.data();
+                previous_headings = last_headings.data();
+            }
+            CheckRow(ws, timesteps_checked + (t - first), previous, previous_headings,
+                     paths.Vertices(t).data(), paths.Headings(t).data());
+        } });
+
+    // Windows arrive in order, so earlier Checks already hold the earliest violations
+    std::vector<Violation> found;
+    for (Workspace &ws : workspaces)
+    {
+        for (std::size_t type = 0; type < 5; ++type)
+        {
+            counts[type] += ws.counts[type];
+            num_violations += ws.counts[type];
+            ws.counts[type] = 0;
+        }
+        found.insert(found.end(), ws.found.begin(), ws.found.end());
+        ws.found.clear();
+    }
+    std::sort(found.begin(), found.end(), Earlier);
+    for (std::size_t i = 0; i < found.size() && violations.size() < options.max_violations; ++i)
+        violations.push_back(found[i]);
+
+    Span<const int32_t> vertices = paths.Vertices(last - 1);
+    Span<const Direction> headings = paths.Headings(last - 1);
+    last_vertices.assign(vertices.begin(), vertices.end());
+    last_headings.assign(headings.begin(), headings.end());
+    timesteps_checked += rows;
+}
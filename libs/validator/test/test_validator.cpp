@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "pibt.h"
+#include "validator.h"
+
+namespace {
+    // Writes one row of {vertex, heading} pairs, indexed by agent
+    void AddRow(PathStore &paths, const std::vector<std::pair<int, Direction>> &states) {
+        std::size_t t = paths.AppendRow();
+        for (std::size_t a = 0; a < states.size(); ++a) {
+            paths.Vertices(t)[a] = states[a].first;
+            paths.Headings(t)[a] = states[a].second;
+        }
+    }
+}
+
+// Test case 1: Verify plans produced by the planner pass under either motion model
+TEST(ValidatorTest, PlannerOutputIsValid) {
+    std::vector<uint8_t> obstacles(16 * 16, 0);
+    for (int i = 2; i < 14; ++i)
+        obstacles[8 * 16 + i] = 1;
+    Graph graph(16, 16, obstacles);
+
+    std::vector<std::vector<int>> starts, goals;
+    for (int i = 0; i < 40; ++i) {
+        starts.push_back({i % 16, i / 16, i % 4});
+        goals.push_back({15 - i % 16, 15 - i / 16, 0});
+    }
+    for (MotionModel model : {MotionModel::RotateThenMove, MotionModel::Holonomic}) {
+        PibtOptions options;
+        options.seed = 1;
+        options.max_timesteps = 2000;
+        options.motion_model = model;
+        PIBT pibt(graph, starts, goals, options);
+        pibt.RunPibt();
+
+        ValidatorOptions validator_options;
+        validator_options.num_threads = 3;
+        validator_options.motion_model = model;
+        Validator validator(pibt.graph, starts.size(), validator_options);
+        validator.Check(pibt.paths);
+        EXPECT_TRUE(validator.Valid()) << (validator.Violations().empty() ? "" : ViolationTypeToString(validator.Violations()[0].type));
+        EXPECT_EQ(validator.NumTimesteps(), pibt.paths.NumTimesteps());
+    }
+}
+
+// Test case 2: Verify each kind of violation is found where it happens
+TEST(ValidatorTest, DetectsViolations) {
+    std::vector<uint8_t> obstacles(5 * 5, 0);
+    obstacles[12] = 1; // (2, 2)
+    Graph graph(5, 5, obstacles);
+    const Direction U = Direction::Up, R = Direction::Right, L = Direction::Left, D = Direction::Down;
+
+    PathStore paths(3, 4);
+    AddRow(paths, {{0, R}, {1, L}, {20, U}});
+    AddRow(paths, {{1, R}, {0, L}, {15, U}});  // t1: agents 0 and 1 swap
+    AddRow(paths, {{1, R}, {0, L}, {15, R}});  // t2: quarter turn in place, fine
+    AddRow(paths, {{1, D}, {0, R}, {15, R}});  // t3: agent 0 quarter turn, agent 1 half turn
+    AddRow(paths, {{6, D}, {0, R}, {16, R}});  // t4: agent 0 moves down, agent 2 right, fine
+    AddRow(paths, {{6, D}, {1, R}, {16, R}});  // t5: agent 1 moves right while facing right, fine
+    AddRow(paths, {{7, D}, {2, R}, {17, D}});  // t6: agent 0 moves across its heading, agent 2 turns while moving
+    AddRow(paths, {{12, D}, {7, R}, {17, D}}); // t7: agent 0 onto an obstacle, agent 1 moves down facing right
+    AddRow(paths, {{7, D}, {7, R}, {19, D}});  // t8: agents 0 and 1 share vertex 7, agent 2 jumps
+
+    ValidatorOptions options;
+    options.num_threads = 2;
+    Validator validator(graph, 3, options);
+    validator.Check(paths);
+
+    std::vector<std::tuple<ViolationType, std::size_t, int>> expected = {
+        {ViolationType::SwapConflict, 1, 0},
+        {ViolationType::IllegalHeading, 3, 1},
+        {ViolationType::IllegalHeading, 6, 0},
+        {ViolationType::IllegalHeading, 6, 2},
+        {ViolationType::InvalidVertex, 7, 0},
+        {ViolationType::IllegalHeading, 7, 1},
+        {ViolationType::VertexConflict, 8, 1},
+        {ViolationType::IllegalMove, 8, 2},
+    };
+    ASSERT_EQ(validator.Violations().size(), expected.size());
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        const Violation &v = validator.Violations()[i];
+        EXPECT_EQ(v.type, std::get<0>(expected[i])) << i;
+        EXPECT_EQ(v.timestep, std::get<1>(expected[i])) << i;
+        EXPECT_EQ(v.agent, std::get<2>(expected[i])) << i;
+    }
+    EXPECT_EQ(validator.Violations()[0].other, 1);
+    EXPECT_EQ(validator.Violations()[6].other, 0);
+    EXPECT_EQ(validator.NumViolations(ViolationType::IllegalHeading), 4);
+
+    // Holonomic agents may move across their heading but must face their last move, and never
+    // turn in place: the turns at t2 and t3 and the kept headings at t6 and t7 are violations
+    options.motion_model = MotionModel::Holonomic;
+    Validator holonomic(graph, 3, options);
+    holonomic.Check(paths);
+    EXPECT_EQ(holonomic.NumViolations(ViolationType::IllegalHeading), 6);
+    EXPECT_EQ(holonomic.NumViolations(), 10);
+
+    // Without the heading rules only the collisions and illegal moves remain
+    options.check_headings = false;
+    Validator collisions(graph, 3, options);
+    collisions.Check(paths);
+    EXPECT_EQ(collisions.NumViolations(), 4);
+}
+
+// Test case 3: Verify windows checked one after another match a single check
+TEST(ValidatorTest, Windows) {
+    Graph graph(4, 1);
+    const Direction R = Direction::Right;
+    PathStore first(2), second(2);
+    AddRow(first, {{0, R}, {2, R}});
+    AddRow(first, {{1, R}, {3, R}});
+    AddRow(second, {{2, R}, {3, R}}); // 1 -> 2 continues from the first window; no conflict
+    AddRow(second, {{3, R}, {2, R}}); // swap; moving against the heading is allowed
+
+    ValidatorOptions options;
+    options.num_threads = 1;
+    Validator validator(graph, 2, options);
+    validator.Check(first);
+    validator.Check(second);
+    EXPECT_EQ(validator.NumTimesteps(), 4);
+    ASSERT_EQ(validator.NumViolations(), 1);
+    EXPECT_EQ(validator.Violations()[0].type, ViolationType::SwapConflict);
+    EXPECT_EQ(validator.Violations()[0].timestep, 3);
+}